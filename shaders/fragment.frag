@@ -1,12 +1,21 @@
 #version 430 core
 // fragment.frag - ScreenQuad fragment shader.
 // Copyright (C) 2022 Trevor Last
+//
+// Variants (see shader_from_file):
+//  VIEW_GRID - `tex` is a texture array, drawn as a `grid` of its layers,
+//              top left first.
 
 in vec2 fTexCoords;
 
 out vec4 FragColor;
 
+#ifdef VIEW_GRID
+uniform sampler2DArray tex;
+uniform ivec2 grid;
+#else
 uniform sampler2D tex;
+#endif
 uniform bool dithering;
 
 
@@ -35,7 +44,18 @@ float bayerDither(in float value, in ivec2 pos)
 void main()
 {
     const ivec2 pixelPos = ivec2(gl_FragCoord.xy);
+#ifdef VIEW_GRID
+    const vec2 cellPos = fTexCoords * vec2(grid);
+    const ivec2 cell = min(ivec2(cellPos), grid - 1);
+    const int layer = (grid.y - 1 - cell.y) * grid.x + cell.x;
+    vec4 color = vec4(0.0, 0.0, 0.0, 1.0);
+    if (layer < textureSize(tex, 0).z)
+    {
+        color = texture(tex, vec3(cellPos - vec2(cell), float(layer)));
+    }
+#else
     vec4 color = texture(tex, fTexCoords);
+#endif
     if (dithering)
     {
         // Dithering effect (for fun :]).
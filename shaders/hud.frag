@@ -0,0 +1,111 @@
+#version 430 core
+// hud.frag - Performance HUD overlay: frame-time graph and stats text.
+// Copyright (C) 2022 Trevor Last
+
+// NOTE: These must match the constants in PerformanceHud.
+#define HISTORY 128
+#define COLUMNS 28
+#define LINES 9
+// Glyph cell size, in unscaled pixels.
+#define CELL_W 6
+#define CELL_H 9
+#define GRAPH_H 48
+#define MARGIN 2
+
+in vec2 fTexCoords;
+
+out vec4 FragColor;
+
+uniform float history[HISTORY];
+uniform int historyHead;
+uniform float graphMax;
+uniform float graphTarget;
+uniform uint text[COLUMNS * LINES / 4];
+uniform ivec2 hudSize;
+uniform int scale;
+
+/**
+ * 5x7 bitmap font for ASCII 32-95. Each glyph is 5 bytes, one per column,
+ * with bit 0 being the top row. Bytes are packed little-endian into uints.
+ */
+const uint font[80] = uint[](
+    0x00000000u, 0x5F000000u, 0x07000000u, 0x14000700u, 0x147F147Fu,
+    0x2A7F2A24u, 0x08132312u, 0x49366264u, 0x00502056u, 0x00000305u,
+    0x41221C00u, 0x22410000u, 0x0814001Cu, 0x0814083Eu, 0x08083E08u,
+    0x00305000u, 0x08080800u, 0x60000808u, 0x20000060u, 0x02040810u,
+    0x4549513Eu, 0x7F42003Eu, 0x61420040u, 0x21464951u, 0x314B4541u,
+    0x7F121418u, 0x45452710u, 0x4A3C3945u, 0x01304949u, 0x03050971u,
+    0x49494936u, 0x49490636u, 0x36001E29u, 0x00000036u, 0x00003656u,
+    0x41221408u, 0x14141400u, 0x41001414u, 0x02081422u, 0x06095101u,
+    0x41794932u, 0x11117E3Eu, 0x497F7E11u, 0x3E364949u, 0x22414141u,
+    0x2241417Fu, 0x49497F1Cu, 0x097F4149u, 0x3E010909u, 0x7A494941u,
+    0x0808087Fu, 0x7F41007Fu, 0x40200041u, 0x7F013F41u, 0x41221408u,
+    0x4040407Fu, 0x0C027F40u, 0x047F7F02u, 0x3E7F1008u, 0x3E414141u,
+    0x0909097Fu, 0x51413E06u, 0x097F5E21u, 0x46462919u, 0x31494949u,
+    0x017F0101u, 0x40403F01u, 0x201F3F40u, 0x3F1F2040u, 0x3F403840u,
+    0x14081463u, 0x70080763u, 0x51610708u, 0x00434549u, 0x0041417Fu,
+    0x10080402u, 0x41410020u, 0x0204007Fu, 0x40040201u, 0x40404040u);
+
+
+/** Get byte `i` from a packed uint array. */
+#define BYTE(array, i) ((array[(i) / 4] >> (8 * ((i) % 4))) & 0xFFu)
+
+
+/** Check if pixel `p` of the 6x9 cell for character `c` is lit. */
+bool glyphPixel(in uint c, in ivec2 p)
+{
+    if (c < 32u || c > 95u || p.x >= 5 || p.y >= 7)
+    {
+        return false;
+    }
+    const uint column = BYTE(font, int(c - 32u) * 5 + p.x);
+    return ((column >> uint(p.y)) & 1u) != 0u;
+}
+
+
+void main()
+{
+    // Pixel position in unscaled HUD pixels, origin top-left.
+    const ivec2 p = ivec2(
+        int(fTexCoords.x * hudSize.x),
+        int((1.0 - fTexCoords.y) * hudSize.y)) / scale;
+    vec4 color = vec4(0.0, 0.0, 0.0, 0.6);
+
+    const int textH = LINES * CELL_H;
+    if (p.y >= MARGIN && p.y < MARGIN + textH && p.x >= MARGIN)
+    {
+        // Stats text.
+        const ivec2 t = p - ivec2(MARGIN);
+        const ivec2 cell = t / ivec2(CELL_W, CELL_H);
+        if (cell.x < COLUMNS
+            && glyphPixel(
+                BYTE(text, cell.y * COLUMNS + cell.x),
+                t - cell * ivec2(CELL_W, CELL_H)))
+        {
+            color = vec4(1.0);
+        }
+    }
+    else if (p.y >= 2 * MARGIN + textH)
+    {
+        // Frame-time graph, oldest sample on the left.
+        const int graphW = hudSize.x / scale;
+        const int sample = (p.x * HISTORY) / graphW;
+        const float ms = history[(historyHead + sample) % HISTORY];
+        const float height = GRAPH_H - (p.y - (2 * MARGIN + textH));
+        const float barH = min(ms / graphMax, 1.0) * GRAPH_H;
+        const float targetH = graphTarget / graphMax * GRAPH_H;
+        if (height <= barH)
+        {
+            color = (ms <= graphTarget)?
+                vec4(0.2, 0.9, 0.2, 0.9)
+                : (ms <= 2.0 * graphTarget)?
+                    vec4(0.9, 0.9, 0.2, 0.9)
+                    : vec4(0.9, 0.2, 0.2, 0.9);
+        }
+        if (abs(height - targetH) < 0.5)
+        {
+            color = vec4(1.0, 1.0, 1.0, 0.5);
+        }
+    }
+    FragColor = color;
+}
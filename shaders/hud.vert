@@ -0,0 +1,14 @@
+#version 430 core
+// hud.vert - Performance HUD quad, generated from gl_VertexID.
+// Copyright (C) 2022 Trevor Last
+
+out vec2 fTexCoords;
+
+
+void main()
+{
+    // Triangle strip: bl, br, tl, tr.
+    const vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    fTexCoords = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,186 @@
+/**
+ * App.cpp - SDL2 window and OpenGL context.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "App.hpp"
+#include "glUtil.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+
+void init_OpenGL()
+{
+    // Init GLEW and check/print version.
+    GLenum error = glewInit();
+    if (error != GLEW_OK)
+    {
+        throw std::runtime_error{
+            "glewInit - " + std::string{(char *)glewGetErrorString(error)}};
+    }
+    if (glewIsSupported("GL_VERSION_4_3") == GL_FALSE)
+    {
+        throw std::runtime_error{"GLEW: OpenGL Version 4.3 not supported"};
+    }
+    std::clog << "GLEW Version " << glewGetString(GLEW_VERSION) << "\n";
+
+    // Print the received OpenGL version.
+    int major = 0,
+        minor = 0,
+        profile = 0;
+    SDL_GL_GetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, &major);
+    SDL_GL_GetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, &minor);
+    SDL_GL_GetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, &profile);
+    std::clog << "OpenGl Version " << major << "." << minor << " ";
+    switch (profile)
+    {
+    case SDL_GL_CONTEXT_PROFILE_CORE:
+        std::clog << "core";
+        break;
+    case SDL_GL_CONTEXT_PROFILE_COMPATIBILITY:
+        std::clog << "compatibility";
+        break;
+    case SDL_GL_CONTEXT_PROFILE_ES:
+        std::clog << "ES";
+        break;
+    default:
+        std::clog << "Unrecognized Profile (" << profile << ")";
+        break;
+    }
+    std::clog << "\n";
+}
+
+
+void init_SDL()
+{
+    SDL_Init(SDL_INIT_VIDEO);
+    // Set OpenGL context version and profile (4.3 core).
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(
+        SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    // Enable VSync. First try adaptive, if that's not available, use regular.
+    if (SDL_GL_SetSwapInterval(-1)  == -1)
+    {
+        SDL_GL_SetSwapInterval(1);
+    }
+}
+
+
+/* ===[ App ]=== */
+
+App::App(std::string title, int width, int height, bool visible)
+:   _event_callbacks{}
+,   _window{SDL_CreateWindow(
+        title.c_str(),
+        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        width, height,
+        SDL_WINDOW_OPENGL
+        | (visible? SDL_WINDOW_RESIZABLE : SDL_WINDOW_HIDDEN))}
+,   _context{SDL_GL_CreateContext(_window)}
+,   window_width{width}
+,   window_height{height}
+,   running{true}
+,   recorder{nullptr}
+{
+    if (!_window || !_context)
+    {
+        throw std::runtime_error{
+            "App - failed to create window: " + std::string{SDL_GetError()}};
+    }
+    init_OpenGL();
+}
+
+App::~App()
+{
+    SDL_GL_DeleteContext(_context);
+    SDL_DestroyWindow(_window);
+}
+
+void App::add_callback(
+    SDL_EventType event, std::function<void(SDL_Event)> callback)
+{
+    _event_callbacks.insert(
+        {event, std::vector<std::function<void(SDL_Event)>>{}});
+    _event_callbacks[event].push_back(callback);
+}
+
+void App::input()
+{
+    SDL_Event event{};
+    while (SDL_PollEvent(&event))
+    {
+        if (recorder)
+        {
+            recorder->input(event.type);
+        }
+
+        // Built-in actions.
+        switch (event.type)
+        {
+        case SDL_QUIT:
+            running = false;
+            break;
+        case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_RESIZED)
+            {
+                // Viewport size and compute shader output texture depend
+                // on window size, so if it changes they have to be updated.
+                window_width = event.window.data1;
+                window_height = event.window.data2;
+                glViewport(0, 0, window_width, window_height);
+            }
+            break;
+        }
+
+        // Run user-added callbacks.
+        bool valid = true;
+        try
+        {
+            auto _ = _event_callbacks.at(event.type);
+        }
+        catch (std::out_of_range const &)
+        {
+            valid = false;
+        }
+        if (valid)
+        {
+            for (auto callback : _event_callbacks[event.type])
+            {
+                callback(event);
+            }
+        }
+    }
+}
+
+void App::updateScreen() const
+{
+    SDL_GL_SwapWindow(_window);
+}
+
+void App::setVSync(bool vsync) const
+{
+    if (!vsync)
+    {
+        SDL_GL_SetSwapInterval(0);
+    }
+    // First try adaptive, if that's not available, use regular.
+    else if (SDL_GL_SetSwapInterval(-1) == -1)
+    {
+        SDL_GL_SetSwapInterval(1);
+    }
+}
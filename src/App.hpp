@@ -0,0 +1,87 @@
+/**
+ * App.hpp - SDL2 window and OpenGL context.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _APP_HPP
+#define _APP_HPP
+
+#include "FlightRecorder.hpp"
+
+#include <SDL.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/**
+ * OpenGL initialization.
+ * (Make sure to have an active OpenGL context before calling this!)
+ */
+void init_OpenGL();
+
+/** SDL initialization. */
+void init_SDL();
+
+
+/**
+ * The application.
+ */
+class App
+{
+private:
+    std::unordered_map<
+        Uint32,
+        std::vector<std::function<void(SDL_Event)>>
+    > _event_callbacks;
+    SDL_Window *const _window;
+    SDL_GLContext const _context;
+public:
+    int window_width,
+        window_height;
+    bool running;
+    /** If set, every processed event's type is recorded here. */
+    FlightRecorder *recorder;
+
+    /**
+     * NOTE: SDL must be initialized before an App can be created!
+     * A hidden App is just a holder for an OpenGL context, for rendering
+     * without anything on screen.
+     */
+    App(std::string title, int width, int height, bool visible=true);
+    ~App();
+
+    App(App const &) = delete;
+    App &operator=(App const &) = delete;
+
+    /** Set up an event callback. */
+    void add_callback(
+        SDL_EventType event, std::function<void(SDL_Event)> callback);
+
+    /** Handle input events. */
+    void input();
+
+    /** Update the screen. */
+    void updateScreen() const;
+
+    /** Turn VSync on or off. */
+    void setVSync(bool vsync) const;
+};
+
+
+#endif
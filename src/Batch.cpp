@@ -0,0 +1,293 @@
+/**
+ * Batch.cpp - Offline rendering along camera paths.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Batch.hpp"
+#include "App.hpp"
+#include "FrameReader.hpp"
+#include "ImageWriter.hpp"
+#include "VideoStream.hpp"
+#include "Scenes.hpp"
+#include "SharedFrameRing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+
+/* ===[ CameraPath ]=== */
+
+CameraPath::CameraPath(std::string const &path)
+:   _keys{}
+{
+    std::ifstream in{path.c_str()};
+    if (!in)
+    {
+        throw std::runtime_error{"failed to open camera path '" + path + "'"};
+    }
+    std::string line{};
+    for (size_t number = 1; std::getline(in, line); ++number)
+    {
+        size_t const first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields{line};
+        Keyframe key{};
+        double fov_degrees = 90.0;
+        fields >> key.time
+            >> key.position.x >> key.position.y >> key.position.z
+            >> key.target.x >> key.target.y >> key.target.z;
+        if (!fields)
+        {
+            throw std::runtime_error{
+                path + ":" + std::to_string(number)
+                + ": expected TIME PX PY PZ TX TY TZ [FOV]"};
+        }
+        fields >> fov_degrees;
+        key.fov = glm::radians((GLfloat)fov_degrees);
+        if (!_keys.empty() && key.time <= _keys.back().time)
+        {
+            throw std::runtime_error{
+                path + ":" + std::to_string(number)
+                + ": keyframe times must increase"};
+        }
+        _keys.push_back(key);
+    }
+    if (_keys.empty())
+    {
+        throw std::runtime_error{"camera path '" + path + "' is empty"};
+    }
+}
+
+size_t CameraPath::size() const
+{
+    return _keys.size();
+}
+
+double CameraPath::start() const
+{
+    return _keys.front().time;
+}
+
+double CameraPath::end() const
+{
+    return _keys.back().time;
+}
+
+double CameraPath::frameTime(unsigned frame, unsigned frames) const
+{
+    return frames <= 1?
+        start() : start() + (end() - start()) * frame / (frames - 1);
+}
+
+Camera CameraPath::at(double t) const
+{
+    // Find the segment containing t.
+    size_t i = 0;
+    while (i + 2 < _keys.size() && _keys[i + 1].time <= t)
+    {
+        ++i;
+    }
+    Keyframe const &k1 = _keys[i];
+    Keyframe const &k2 = _keys[std::min(i + 1, _keys.size() - 1)];
+    Keyframe const &k0 = _keys[i == 0? 0 : i - 1];
+    Keyframe const &k3 = _keys[std::min(i + 2, _keys.size() - 1)];
+    GLfloat const span = (GLfloat)(k2.time - k1.time);
+    GLfloat const u = span <= 0.0f?
+        0.0f
+        : glm::clamp((GLfloat)(t - k1.time) / span, 0.0f, 1.0f);
+
+    // Uniform Catmull-Rom.
+    auto const spline = [u](
+        glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3){
+        return 0.5f * (
+            2.0f * p1
+            + (p2 - p0) * u
+            + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u * u
+            + (3.0f * p1 - p0 - 3.0f * p2 + p3) * u * u * u);
+    };
+    glm::vec3 const position = spline(
+        k0.position, k1.position, k2.position, k3.position);
+    glm::vec3 const target = spline(
+        k0.target, k1.target, k2.target, k3.target);
+    return Camera{
+        position,
+        glm::normalize(target - position),
+        glm::vec3{0.0f, 1.0f, 0.0f},
+        glm::mix(k1.fov, k2.fov, u)};
+}
+
+
+/* ===[ Batch Rendering ]=== */
+
+std::string frame_path(std::string const &pattern, unsigned frame)
+{
+    char buf[4096];
+    std::snprintf(buf, sizeof(buf), pattern.c_str(), frame);
+    return buf;
+}
+
+
+int run_batch(Options const &options)
+{
+    // Check the output type before spending any time on setup. Image files
+    // are only written if frames aren't going to a stream or shared memory.
+    bool const streaming = !options.streamPath.empty();
+    bool const sharing = !options.shmName.empty();
+    bool const writing = !streaming && !sharing;
+    ImageFormat const format = writing?
+        image_format_from_path(options.outputPattern) : IMAGE_PPM;
+    PixelLayout const layout = (
+        streaming? PIXELS_YUV420
+        : writing? image_format_layout(format)
+        : PIXELS_RGB8);
+
+    init_SDL();
+    App app{
+        "compute batch", (int)options.width, (int)options.height, false};
+    // Frames are never presented, but a swap interval can still throttle
+    // some drivers.
+    app.setVSync(false);
+
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    ComputeRaytraceRenderer renderer{
+        setup.scene, options.width, options.height};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+    renderer.temporalHints = options.temporalHints;
+    renderer.sceneStorage = options.sceneStorage;
+    if (renderer.sceneStorage != renderer.resolvedSceneStorage())
+    {
+        std::clog << "Scene storage: "
+            << describe_scene_storage(renderer.tuneSceneStorage()) << "\n";
+    }
+
+    // Without a path, the scene's own camera is rendered `frames` times.
+    std::unique_ptr<CameraPath> path{};
+    unsigned frames = options.frames;
+    if (!options.cameraPath.empty())
+    {
+        path.reset(new CameraPath{options.cameraPath});
+        if (frames == 0)
+        {
+            frames = (unsigned)path->size();
+        }
+    }
+    frames = std::max(frames, 1u);
+
+    // Frame N is converted and read back while frame N+1 renders, then
+    // published to shared memory, streamed as video, or encoded and written
+    // on the writer threads.
+    FrameReader reader{};
+    std::unique_ptr<SharedFrameRing> ring{};
+    std::unique_ptr<ImageWriter> writer{};
+    std::unique_ptr<VideoStream> stream{};
+    if (sharing)
+    {
+        ring.reset(new SharedFrameRing{
+            options.shmName, options.shmSlots,
+            pixel_layout_bytes(layout, options.width, options.height)});
+    }
+    if (streaming)
+    {
+        stream.reset(new VideoStream{
+            options.streamPath, options.width, options.height, options.fps});
+    }
+    if (writing)
+    {
+        writer.reset(new ImageWriter{options.writerThreads});
+    }
+    FrameReader::Frame done{};
+    auto const hand_off = [&](){
+        unsigned const tag = done.tag;
+        if (ring)
+        {
+            ring->publish(done);
+        }
+        if (stream)
+        {
+            stream->write(std::move(done));
+        }
+        else if (writer)
+        {
+            writer->write(
+                frame_path(options.outputPattern, tag), format,
+                std::move(done));
+        }
+        if ((tag + 1) % 100 == 0 || tag + 1 == frames)
+        {
+            std::clog << "\rFrame " << tag + 1 << "/" << frames
+                << std::flush;
+        }
+    };
+
+    auto const start = std::chrono::steady_clock::now();
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        if (path)
+        {
+            renderer.setCamera(path->at(path->frameTime(frame, frames)));
+        }
+        renderer.render();
+        // The oldest readback has had a whole ring of frames to finish, so
+        // this rarely waits.
+        if (reader.full() && reader.collect(done, true))
+        {
+            hand_off();
+        }
+        reader.read(
+            renderer.getResult(), options.width, options.height, layout,
+            frame);
+        while (reader.collect(done))
+        {
+            hand_off();
+        }
+    }
+    while (reader.collect(done, true))
+    {
+        hand_off();
+    }
+    if (stream)
+    {
+        stream->finish();
+    }
+    if (writer)
+    {
+        writer->finish();
+    }
+    double const total_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::clog << "\n";
+
+    // Keep stdout clean when it's carrying video.
+    std::ostream &report = options.streamPath == "-"? std::clog : std::cout;
+    report << frames << " frames in " << total_seconds << " s: "
+        << frames / total_seconds << " fps\n";
+    if (options.temporalHints)
+    {
+        report << "Last frame's temporal hints hit "
+            << renderer.hintHitRate() * 100.0 << "% of the time\n";
+    }
+    return EXIT_SUCCESS;
+}
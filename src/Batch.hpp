@@ -0,0 +1,95 @@
+/**
+ * Batch.hpp - Offline rendering along camera paths.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BATCH_HPP
+#define _BATCH_HPP
+
+#include "ComputeRaytraceRenderer.hpp"
+#include "Options.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * A camera path, as keyframes which are interpolated between.
+ *
+ * Path files have one keyframe per line:
+ *   TIME  PX PY PZ  TX TY TZ  [FOV]
+ * where P is the eye position, T is the point looked at, and FOV is the
+ * horizontal field of view in degrees. Blank lines and lines starting with
+ * '#' are ignored.
+ */
+class CameraPath
+{
+public:
+    /**
+     * A single keyframe.
+     *  time - Seconds from the start of the path.
+     *  position - Eye position.
+     *  target - Point looked at.
+     *  fov - Horizontal field of view, in radians.
+     */
+    struct Keyframe
+    {
+        double time;
+        glm::vec3 position;
+        glm::vec3 target;
+        GLfloat fov;
+    };
+
+private:
+    std::vector<Keyframe> _keys;
+
+public:
+    /** Load a path file. Throws on I/O or syntax errors. */
+    CameraPath(std::string const &path);
+
+    /** Number of keyframes. */
+    size_t size() const;
+
+    /** Time of the first and last keyframes. */
+    double start() const;
+    double end() const;
+
+    /**
+     * Time of frame `frame` of `frames`, spread evenly from start() to
+     * end(). A single frame is at start().
+     */
+    double frameTime(unsigned frame, unsigned frames) const;
+
+    /**
+     * Camera at time `t`. Positions and targets follow a Catmull-Rom spline
+     * through the keyframes, so motion is smooth across them.
+     */
+    Camera at(double t) const;
+};
+
+
+/** Expand a printf-style frame number pattern, eg. "frame%05d.ppm". */
+std::string frame_path(std::string const &pattern, unsigned frame);
+
+/**
+ * Render every frame of a camera path offscreen with VSync off, writing
+ * numbered images and reporting throughput.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_batch(Options const &options);
+
+
+#endif
@@ -0,0 +1,404 @@
+/**
+ * Benchmark.cpp - Quality-versus-time benchmark.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmark.hpp"
+#include "App.hpp"
+#include "ComputeRaytraceRenderer.hpp"
+#include "Scenes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+
+/**
+ * One measured configuration.
+ *  scene - Scene name.
+ *  samples - Rays per pixel.
+ *  scale - Resolution scale.
+ *  width, height - Actual render size.
+ *  ms - GPU time per frame.
+ *  psnr, ssim - Quality against the reference.
+ *  pareto - No other configuration is both faster and better.
+ */
+struct BenchmarkResult
+{
+    std::string scene;
+    unsigned samples;
+    double scale;
+    unsigned width, height;
+    double ms;
+    double psnr;
+    double ssim;
+    bool pareto;
+};
+
+
+/* ===[ Image Comparison ]=== */
+
+double image_psnr(
+    std::vector<float> const &reference, std::vector<float> const &image)
+{
+    double error = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < reference.size(); ++i)
+    {
+        // Skip alpha.
+        if (i % 4 == 3)
+        {
+            continue;
+        }
+        double const a = std::min(std::max(reference[i], 0.0f), 1.0f);
+        double const b = std::min(std::max(image[i], 0.0f), 1.0f);
+        error += (a - b) * (a - b);
+        ++count;
+    }
+    double const mse = error / (double)std::max<size_t>(count, 1);
+    // Identical images would be infinite, which doesn't sit well in a CSV.
+    return mse <= 1.0e-10? 100.0 : 10.0 * std::log10(1.0 / mse);
+}
+
+double image_ssim(
+    std::vector<float> const &reference, std::vector<float> const &image,
+    unsigned width, unsigned height)
+{
+    // Algorithm from: https://en.wikipedia.org/wiki/Structural_similarity
+    // 8x8 windows with a stride of 4 instead of a Gaussian window.
+    auto const luma = [](std::vector<float> const &img, size_t i){
+        double const r = std::min(std::max(img[4 * i + 0], 0.0f), 1.0f);
+        double const g = std::min(std::max(img[4 * i + 1], 0.0f), 1.0f);
+        double const b = std::min(std::max(img[4 * i + 2], 0.0f), 1.0f);
+        return 0.2126 * r + 0.7152 * g + 0.0722 * b;
+    };
+    double const C1 = 0.01 * 0.01;
+    double const C2 = 0.03 * 0.03;
+    unsigned const N = 8;
+    double total = 0.0;
+    size_t windows = 0;
+    for (unsigned y = 0; y + N <= height; y += N / 2)
+    {
+        for (unsigned x = 0; x + N <= width; x += N / 2)
+        {
+            double sa = 0.0, sb = 0.0, saa = 0.0, sbb = 0.0, sab = 0.0;
+            for (unsigned v = 0; v < N; ++v)
+            {
+                for (unsigned u = 0; u < N; ++u)
+                {
+                    size_t const i = (size_t)(y + v) * width + (x + u);
+                    double const a = luma(reference, i);
+                    double const b = luma(image, i);
+                    sa += a;
+                    sb += b;
+                    saa += a * a;
+                    sbb += b * b;
+                    sab += a * b;
+                }
+            }
+            double const n = N * N;
+            double const ma = sa / n, mb = sb / n;
+            double const va = saa / n - ma * ma;
+            double const vb = sbb / n - mb * mb;
+            double const cov = sab / n - ma * mb;
+            total += (
+                ((2 * ma * mb + C1) * (2 * cov + C2))
+                / ((ma * ma + mb * mb + C1) * (va + vb + C2)));
+            ++windows;
+        }
+    }
+    return windows == 0? 1.0 : total / (double)windows;
+}
+
+/**
+ * Bilinearly resample an RGBA float image to a new size. Pixel centers are
+ * matched the same way the raytracer spreads them over the view, so the
+ * first and last pixels line up.
+ */
+static std::vector<float> resample(
+    std::vector<float> const &image, unsigned width, unsigned height,
+    unsigned newWidth, unsigned newHeight)
+{
+    std::vector<float> out((size_t)newWidth * newHeight * 4);
+    auto const map = [](unsigned i, unsigned from, unsigned to){
+        return to <= 1? 0.0 : (double)i * (from - 1) / (double)(to - 1);
+    };
+    for (unsigned y = 0; y < newHeight; ++y)
+    {
+        double const fy = map(y, height, newHeight);
+        unsigned const y0 = (unsigned)fy;
+        unsigned const y1 = std::min(y0 + 1, height - 1);
+        double const ty = fy - y0;
+        for (unsigned x = 0; x < newWidth; ++x)
+        {
+            double const fx = map(x, width, newWidth);
+            unsigned const x0 = (unsigned)fx;
+            unsigned const x1 = std::min(x0 + 1, width - 1);
+            double const tx = fx - x0;
+            for (unsigned c = 0; c < 4; ++c)
+            {
+                auto const at = [&](unsigned px, unsigned py){
+                    return image[((size_t)py * width + px) * 4 + c];
+                };
+                double const top = at(x0, y0) * (1 - tx) + at(x1, y0) * tx;
+                double const bot = at(x0, y1) * (1 - tx) + at(x1, y1) * tx;
+                out[((size_t)y * newWidth + x) * 4 + c] = (float)(
+                    top * (1 - ty) + bot * ty);
+            }
+        }
+    }
+    return out;
+}
+
+
+/* ===[ Benchmark ]=== */
+
+/**
+ * Render `samples` rays per pixel in passes small enough not to trip driver
+ * watchdogs, averaging the passes on the CPU.
+ */
+static std::vector<float> render_reference(
+    ComputeRaytraceRenderer &renderer, unsigned samples)
+{
+    unsigned const per_pass = 16;
+    std::vector<float> sum{};
+    unsigned done = 0;
+    while (done < samples)
+    {
+        renderer.samplesPerPixel = std::min(per_pass, samples - done);
+        renderer.firstSample = done;
+        renderer.render();
+        auto const pass = renderer.readResult();
+        sum.resize(pass.size(), 0.0f);
+        for (size_t i = 0; i < pass.size(); ++i)
+        {
+            sum[i] += pass[i] * renderer.samplesPerPixel;
+        }
+        done += renderer.samplesPerPixel;
+    }
+    for (auto &v : sum)
+    {
+        v /= (float)samples;
+    }
+    renderer.firstSample = 0;
+    return sum;
+}
+
+/** Average GPU time of `frames` renders, in milliseconds. */
+static double time_render(ComputeRaytraceRenderer &renderer, unsigned frames)
+{
+    // Warm up, so shader and driver caches don't count.
+    renderer.render();
+    glFinish();
+    Query elapsed{GL_TIME_ELAPSED, "BenchmarkQuery"};
+    elapsed.begin();
+    for (unsigned i = 0; i < frames; ++i)
+    {
+        renderer.render();
+    }
+    elapsed.end();
+    return (double)elapsed.result() / 1.0e6 / frames;
+}
+
+/** Mark the results of each scene which aren't dominated on time/PSNR. */
+static void mark_pareto(std::vector<BenchmarkResult> &results)
+{
+    for (auto &a : results)
+    {
+        a.pareto = true;
+        for (auto const &b : results)
+        {
+            bool const dominates = (
+                &a != &b
+                && a.scene == b.scene
+                && b.ms <= a.ms && b.psnr >= a.psnr
+                && (b.ms < a.ms || b.psnr > a.psnr));
+            if (dominates)
+            {
+                a.pareto = false;
+                break;
+            }
+        }
+    }
+}
+
+/** Key identifying a configuration across runs. */
+static std::string result_key(
+    std::string const &scene, unsigned samples, double scale)
+{
+    std::ostringstream key{};
+    key << scene << "|" << samples << "|" << scale;
+    return key.str();
+}
+
+/** Load the PSNR of each configuration from an earlier CSV. */
+static std::map<std::string, double> load_baseline(std::string const &path)
+{
+    std::ifstream in{path.c_str()};
+    if (!in)
+    {
+        throw std::runtime_error{"failed to open baseline '" + path + "'"};
+    }
+    std::map<std::string, double> baseline{};
+    std::string line{};
+    std::getline(in, line); // header
+    while (std::getline(in, line))
+    {
+        std::istringstream fields{line};
+        std::string scene, samples, scale, width, height, ms, psnr;
+        std::getline(fields, scene, ',');
+        std::getline(fields, samples, ',');
+        std::getline(fields, scale, ',');
+        std::getline(fields, width, ',');
+        std::getline(fields, height, ',');
+        std::getline(fields, ms, ',');
+        std::getline(fields, psnr, ',');
+        if (!psnr.empty())
+        {
+            baseline[result_key(
+                scene, (unsigned)std::stoul(samples), std::stod(scale))]
+                = std::stod(psnr);
+        }
+    }
+    return baseline;
+}
+
+
+int run_benchmark(Options const &options)
+{
+    static unsigned const sample_counts[] = {1, 2, 4, 8, 16};
+    static double const scales[] = {0.5, 0.75, 1.0};
+    std::vector<std::string> const scenes = options.scenes.empty()?
+        std::vector<std::string>{"demo", "grid", "random"}
+        : options.scenes;
+
+    init_SDL();
+    App app{
+        "compute benchmark", (int)options.width, (int)options.height, false};
+
+    std::vector<BenchmarkResult> results{};
+    for (auto const &name : scenes)
+    {
+        SceneSetup const setup = builtin_scene(name);
+        ComputeRaytraceRenderer renderer{
+            setup.scene, options.width, options.height};
+        configure_renderer(renderer, setup);
+
+        std::clog << name << ": rendering reference ("
+            << options.benchReferenceSamples << " samples)\n";
+        auto const reference = render_reference(
+            renderer, options.benchReferenceSamples);
+
+        for (double scale : scales)
+        {
+            unsigned const w = std::max(1u, (unsigned)(options.width * scale));
+            unsigned const h = std::max(
+                1u, (unsigned)(options.height * scale));
+            renderer.setRenderDimensions(w, h);
+            for (unsigned samples : sample_counts)
+            {
+                renderer.samplesPerPixel = samples;
+                double const ms = time_render(renderer, options.benchFrames);
+                auto image = renderer.readResult();
+                if (w != options.width || h != options.height)
+                {
+                    image = resample(
+                        image, w, h, options.width, options.height);
+                }
+                results.push_back({
+                    name, samples, scale, w, h, ms,
+                    image_psnr(reference, image),
+                    image_ssim(
+                        reference, image, options.width, options.height),
+                    false});
+                std::clog << "  " << samples << " spp @ " << scale
+                    << "x: " << ms << " ms, " << results.back().psnr
+                    << " dB\n";
+            }
+        }
+        glViewport(0, 0, options.width, options.height);
+    }
+    mark_pareto(results);
+
+    // Write results.
+    std::ofstream file{};
+    if (!options.benchOutput.empty())
+    {
+        file.open(options.benchOutput.c_str());
+        if (!file)
+        {
+            throw std::runtime_error{
+                "failed to open '" + options.benchOutput + "'"};
+        }
+    }
+    std::ostream &out = options.benchOutput.empty()? std::cout : file;
+    out << "scene,samples,scale,width,height,frame_ms,psnr_db,ssim,pareto\n";
+    for (auto const &r : results)
+    {
+        out << r.scene << "," << r.samples << "," << r.scale << ","
+            << r.width << "," << r.height << "," << r.ms << ","
+            << r.psnr << "," << r.ssim << "," << (r.pareto? 1 : 0) << "\n";
+    }
+
+    // Summarize the frontiers.
+    for (auto const &name : scenes)
+    {
+        std::clog << name << " Pareto frontier (fastest first):\n";
+        std::vector<BenchmarkResult> frontier{};
+        for (auto const &r : results)
+        {
+            if (r.scene == name && r.pareto)
+            {
+                frontier.push_back(r);
+            }
+        }
+        std::sort(
+            frontier.begin(), frontier.end(),
+            [](BenchmarkResult const &a, BenchmarkResult const &b){
+                return a.ms < b.ms;
+            });
+        for (auto const &r : frontier)
+        {
+            std::clog << "  " << r.samples << " spp @ " << r.scale << "x  "
+                << r.ms << " ms  " << r.psnr << " dB  SSIM " << r.ssim
+                << "\n";
+        }
+    }
+
+    // Check for regressions.
+    if (options.benchBaseline.empty())
+    {
+        return EXIT_SUCCESS;
+    }
+    auto const baseline = load_baseline(options.benchBaseline);
+    int regressions = 0;
+    for (auto const &r : results)
+    {
+        auto const it = baseline.find(
+            result_key(r.scene, r.samples, r.scale));
+        if (it != baseline.end() && r.psnr < it->second - options.benchTolerance)
+        {
+            std::cerr << "REGRESSION: " << r.scene << " " << r.samples
+                << " spp @ " << r.scale << "x: " << r.psnr << " dB, was "
+                << it->second << " dB\n";
+            ++regressions;
+        }
+    }
+    return regressions == 0? EXIT_SUCCESS : EXIT_FAILURE;
+}
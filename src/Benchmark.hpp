@@ -0,0 +1,48 @@
+/**
+ * Benchmark.hpp - Quality-versus-time benchmark.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BENCHMARK_HPP
+#define _BENCHMARK_HPP
+
+#include "Options.hpp"
+
+#include <vector>
+
+
+/**
+ * Compare a render against a reference.
+ * Both images are RGBA floats of the same size; values are clamped to [0,1].
+ */
+double image_psnr(
+    std::vector<float> const &reference, std::vector<float> const &image);
+/** Mean SSIM of the luminance of two RGBA float images. */
+double image_ssim(
+    std::vector<float> const &reference, std::vector<float> const &image,
+    unsigned width, unsigned height);
+
+/**
+ * Render converged references of each scene, then measure the frame time
+ * and PSNR/SSIM of every sample count and resolution scale combination.
+ * Writes a CSV with the Pareto-optimal configurations marked, and returns
+ * EXIT_FAILURE if quality regressed against `options.benchBaseline`.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_benchmark(Options const &options);
+
+
+#endif
@@ -32,6 +32,7 @@ Buffer::Buffer(GLenum target, std::string label)
 :   _id{new GLuint{0}, _buffer_delete}
 ,   target{target}
 {
+    gl_call_count += 2;
     glCreateBuffers(1, _id.get());
     if (!label.empty())
     {
@@ -46,10 +47,12 @@ GLuint Buffer::id() const
 
 void Buffer::bind() const
 {
+    ++gl_call_count;
     glBindBuffer(target, *_id);
 }
 void Buffer::bind(GLenum target_)
 {
+    ++gl_call_count;
     GLenum const bound = target_ == GL_NONE? target : target_;
     glBindBuffer(bound, *_id);
     target = bound;
@@ -57,5 +60,6 @@ void Buffer::bind(GLenum target_)
 
 void Buffer::unbind() const
 {
+    ++gl_call_count;
     glBindBuffer(target, 0);
 }
@@ -18,8 +18,12 @@
 
 #include "ComputeRaytraceRenderer.hpp"
 
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <utility>
 
 
 /* ===[ Utility ]=== */
@@ -30,44 +34,157 @@ void opengl_debug_message_callback(
     GLenum severity, GLsizei length, GLchar const *message,
     void const *userParam)
 {
-    std::cout << "OpenGL: ";
+    std::clog << "OpenGL: ";
     if (type == GL_DEBUG_TYPE_ERROR)
     {
-        std::cout << "** GL ERROR ** ";
+        std::clog << "** GL ERROR ** ";
     }
-    std::cout << message << "\n";
+    std::clog << message << "\n";
 }
 
+/**
+ * Shelf-pack rectangles of the given sizes, tallest first, into an atlas at
+ * most `limit` pixels on a side. Returns each rectangle's bottom left
+ * corner, and sets `atlas` to the size used. Throws if they don't fit.
+ */
+static std::vector<glm::ivec2> pack_atlas(
+    std::vector<glm::ivec2> const &sizes, GLint limit, glm::ivec2 &atlas)
+{
+    // Aim for a square atlas.
+    double area = 0.0;
+    GLint widest = 0;
+    for (auto const &size : sizes)
+    {
+        area += (double)size.x * size.y;
+        widest = std::max(widest, size.x);
+    }
+    GLint const width = std::min(
+        limit, std::max(widest, (GLint)std::ceil(std::sqrt(area))));
 
-/** Load a GLSL Shader from a file. */
-Shader shader_from_file(std::string path, GLenum type)
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(),
+        [&sizes](size_t a, size_t b){ return sizes[a].y > sizes[b].y; });
+    std::vector<glm::ivec2> corners(sizes.size());
+    glm::ivec2 corner{0, 0};
+    GLint shelf = 0;
+    atlas = glm::ivec2{0, 0};
+    for (size_t const i : order)
+    {
+        if (corner.x + sizes[i].x > width)
+        {
+            corner = glm::ivec2{0, corner.y + shelf};
+            shelf = 0;
+        }
+        corners[i] = corner;
+        corner.x += sizes[i].x;
+        shelf = std::max(shelf, sizes[i].y);
+        atlas.x = std::max(atlas.x, corner.x);
+    }
+    atlas.y = corner.y + shelf;
+    if (widest > limit || atlas.y > limit)
+    {
+        throw std::runtime_error{
+            "pack_atlas - jobs don't fit in a " + std::to_string(limit)
+            + "x" + std::to_string(limit) + " texture"};
+    }
+    return corners;
+}
+
+
+/** Get an implementation limit, capped at `cap`. */
+static size_t gl_limit(GLenum pname, size_t cap)
 {
-    std::ifstream shaderfile{path.c_str()};
-    std::stringstream srcstream{};
-    srcstream << shaderfile.rdbuf();
-    shaderfile.close();
-    return Shader{type, srcstream.str(), path};
+    GLint64 value = 0;
+    ++gl_call_count;
+    glGetInteger64v(pname, &value);
+    return std::min((size_t)std::max<GLint64>(value, 0), cap);
 }
 
 
 /* ===[ Renderer ]=== */
 
+/** First texture unit of STORAGE_TBO scene arrays, as in compute.comp. */
+static GLuint const TEXEL_UNIT = 2;
+
 ComputeRaytraceRenderer::ComputeRaytraceRenderer(Scene const &scene, GLuint width, GLuint height)
-:   _compute{
-        {shader_from_file("shaders/compute.comp", GL_COMPUTE_SHADER)},
-        "ComputeShader"}
+:   _compute{}
 ,   _renderResult{GL_TEXTURE_2D, "RenderResult"}
 ,   _spheres{GL_SHADER_STORAGE_BUFFER, "SphereSSBO"}
 ,   _materials{GL_SHADER_STORAGE_BUFFER, "MaterialSSBO"}
 ,   _lights{GL_SHADER_STORAGE_BUFFER, "LightSSBO"}
+,   _sphereCapacity{0}
+,   _materialCapacity{0}
+,   _lightCapacity{0}
+,   _sphereBytes{0}
+,   _materialBytes{0}
+,   _lightBytes{0}
+,   _storage{STORAGE_SSBO, STORAGE_SSBO, STORAGE_SSBO}
+,   _sceneDirty{true}
+    // Uniform blocks are guaranteed 16KB, and usually 64KB. Drivers allowing
+    // more would only make small scenes pad their buffers further.
+,   _uniformBlockBytes{gl_limit(GL_MAX_UNIFORM_BLOCK_SIZE, 65536)}
+,   _maxTexelWords{gl_limit(GL_MAX_TEXTURE_BUFFER_SIZE, SIZE_MAX)}
+,   _sphereTexels{}
+,   _materialTexels{}
+,   _lightTexels{}
+,   _resident{}
 ,   _width{width}
 ,   _height{height}
+,   _depthCompute{}
+,   _hintCompute{}
+,   _hints{}
+,   _primitives{}
+,   _hintOutcomes{}
+,   _hintPixels{0}
+,   _inspector{}
+,   _traceLog{}
+,   _traceClock{glewIsSupported("GL_ARB_shader_clock") == GL_TRUE}
+,   _multiView{}
+,   _viewResults{}
+,   _views{}
+,   _viewWidth{0}
+,   _viewHeight{0}
+,   _viewCount{0}
+,   _probeBake{}
+,   _probeResults{}
+,   _probeSize{0}
+,   _probeCount{0}
+,   _jobBatch{}
+,   _jobResults{}
+,   _jobs{}
+,   _atlasSize{0, 0}
+,   _jobCount{0}
+,   _dispatchTimer{"DispatchTimer"}
+,   _sceneBytes{0}
+,   _dispatches{MetricsRegistry::global().counter(
+        "render_dispatches_total", "Compute dispatches issued.")}
+,   _uploadBytes{MetricsRegistry::global().counter(
+        "render_upload_bytes_total", "Bytes uploaded to GPU buffers.")}
+,   _sceneChunks{MetricsRegistry::global().counter(
+        "render_scene_chunks_total",
+        "Scene chunks uploaded by updateScene().")}
+,   _dispatchTime{MetricsRegistry::global().histogram(
+        "render_dispatch_gpu_us", "GPU time of the raytrace dispatch.")}
+,   _gpuMemory{MetricsRegistry::global().gauge(
+        "render_gpu_memory_bytes", "GPU memory held by the renderer.")}
+,   _hintHitRate{MetricsRegistry::global().gauge(
+        "render_hint_hit_rate",
+        "Fraction of temporal hints that were the nearest hit.")}
 ,   ambientColor{0.0f}
 ,   blankColor{0.0f}
 ,   eyePosition{0.0f}
 ,   eyeForward{0.0f, 0.0f, -1.0f}
 ,   eyeUp{0.0f, 1.0f, 0.0f}
 ,   fov{90.0f}
+,   samplesPerPixel{1}
+,   firstSample{0}
+,   tileOffset{0, 0}
+,   fullSize{0, 0}
+,   depthInAlpha{false}
+,   temporalHints{false}
+,   sceneStorage{STORAGE_SSBO, STORAGE_SSBO, STORAGE_SSBO}
 {
     glViewport(0, 0, _width, _height);
     glEnable(GL_DEBUG_OUTPUT);
@@ -86,11 +203,226 @@ ComputeRaytraceRenderer::ComputeRaytraceRenderer(Scene const &scene, GLuint widt
     _renderResult.unbind();
     /* ===[ Create Scene Data Buffers ]=== */
     // Init Spheres SSBO.
-    _initComputeBuffer(_spheres, "Spheres", scene.spheres);
+    _initComputeBuffer(
+        _spheres, scene.spheres, _sphereCapacity, _sphereBytes);
     // Init Materials SSBO.
-    _initComputeBuffer(_materials, "Materials", scene.materials);
+    _initComputeBuffer(
+        _materials, scene.materials, _materialCapacity, _materialBytes);
     // Init Lights SSBO.
-    _initComputeBuffer(_lights, "Lights", scene.lights);
+    _initComputeBuffer(_lights, scene.lights, _lightCapacity, _lightBytes);
+    _applySceneStorage();
+    _updateMemoryGauge();
+}
+
+SceneStorage ComputeRaytraceRenderer::_resolveStorage(
+    SceneStorage storage, size_t bytes) const
+{
+    bool const fits_uniform = bytes <= _uniformBlockBytes;
+    switch (storage)
+    {
+    case STORAGE_UBO:
+    case STORAGE_AUTO:
+        // Small arrays are read by every invocation in step, which the
+        // constant cache broadcasts.
+        return fits_uniform? STORAGE_UBO : STORAGE_SSBO;
+    case STORAGE_TBO:
+        return bytes / 4 <= _maxTexelWords? STORAGE_TBO : STORAGE_SSBO;
+    default:
+        return STORAGE_SSBO;
+    }
+}
+
+void ComputeRaytraceRenderer::_applySceneStorage()
+{
+    SceneStorageConfig const storage = resolvedSceneStorage();
+    if (!_compute || storage != _storage)
+    {
+        _storage = storage;
+        _compute.reset();
+        _depthCompute.reset();
+        _hintCompute.reset();
+        _inspector.reset();
+        _multiView.reset();
+        _probeBake.reset();
+        _jobBatch.reset();
+        _variant(_compute, {}, "ComputeShader");
+        _sceneDirty = true;
+    }
+    if (_sceneDirty)
+    {
+        size_t const before = _sceneBytes;
+        _bindSceneArray(
+            _spheres, 0, _sphereCapacity, _sphereBytes, _storage.spheres,
+            _sphereTexels);
+        _bindSceneArray(
+            _materials, 1, _materialCapacity, _materialBytes,
+            _storage.materials, _materialTexels);
+        _bindSceneArray(
+            _lights, 2, _lightCapacity, _lightBytes, _storage.lights,
+            _lightTexels);
+        _sceneDirty = false;
+        if (_sceneBytes != before)
+        {
+            _updateMemoryGauge();
+        }
+    }
+}
+
+void ComputeRaytraceRenderer::_padToUniformBlock(
+    Buffer &buffer, size_t &capacity, size_t bytes)
+{
+    if (capacity >= _uniformBlockBytes)
+    {
+        return;
+    }
+    // Park the contents in a temporary buffer while reallocating.
+    Buffer const temporary{GL_COPY_WRITE_BUFFER, "SceneBufferCopy"};
+    gl_call_count += 4;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, temporary.id());
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_COPY);
+    glCopyBufferSubData(
+        GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+    gl_call_count += 2;
+    glBufferData(
+        GL_COPY_READ_BUFFER, _uniformBlockBytes, nullptr, GL_STATIC_DRAW);
+    glCopyBufferSubData(
+        GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, bytes);
+    gl_call_count += 2;
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _sceneBytes += _uniformBlockBytes - capacity;
+    capacity = _uniformBlockBytes;
+}
+
+void ComputeRaytraceRenderer::_bindSceneArray(
+    Buffer &buffer, GLuint index, size_t &capacity, size_t bytes,
+    SceneStorage storage, std::unique_ptr<Texture> &texels)
+{
+    if (storage == STORAGE_UBO)
+    {
+        // The whole block is bound, so the buffer must be at least that
+        // big. Growing only ever doubles the capacity, so this sticks.
+        _padToUniformBlock(buffer, capacity, bytes);
+        ++gl_call_count;
+        glBindBufferRange(
+            GL_UNIFORM_BUFFER, index, buffer.id(), 0, _uniformBlockBytes);
+    }
+    else if (storage == STORAGE_TBO)
+    {
+        glActiveTexture(GL_TEXTURE0 + TEXEL_UNIT + index);
+        if (!texels)
+        {
+            texels.reset(new Texture{GL_TEXTURE_BUFFER, "SceneTexels"});
+        }
+        texels->bind();
+        // Ranges can't be empty; the shader is given the element count.
+        ++gl_call_count;
+        glTexBufferRange(
+            GL_TEXTURE_BUFFER, GL_R32UI, buffer.id(), 0,
+            std::max<size_t>(bytes, 4));
+        glActiveTexture(GL_TEXTURE0);
+    }
+    else
+    {
+        // The shader sizes its arrays by the bound range, so bind only the
+        // elements in use.
+        ++gl_call_count;
+        if (bytes == 0)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, 0);
+        }
+        else
+        {
+            glBindBufferRange(
+                GL_SHADER_STORAGE_BUFFER, index, buffer.id(), 0, bytes);
+        }
+    }
+}
+
+Program const &ComputeRaytraceRenderer::_variant(
+    std::unique_ptr<Program> &program, std::vector<std::string> defines,
+    std::string const &label)
+{
+    if (!program)
+    {
+        defines.push_back(
+            "SPHERE_STORAGE " + std::to_string(_storage.spheres));
+        defines.push_back(
+            "MATERIAL_STORAGE " + std::to_string(_storage.materials));
+        defines.push_back("LIGHT_STORAGE " + std::to_string(_storage.lights));
+        defines.push_back(
+            "UNIFORM_VEC4S " + std::to_string(_uniformBlockBytes / 16));
+        program.reset(new Program{
+            {shader_from_file(
+                "shaders/compute.comp", GL_COMPUTE_SHADER, defines)},
+            label});
+    }
+    return *program;
+}
+
+void ComputeRaytraceRenderer::_updateMemoryGauge()
+{
+    size_t const image = (size_t)_width * _height * 4 * sizeof(GLfloat);
+    size_t const views =
+        (size_t)_viewWidth * _viewHeight * _viewCount * 4 * sizeof(GLfloat)
+        + _viewCount * sizeof(View);
+    size_t const probes =
+        (size_t)_probeSize * _probeSize * 6 * _probeCount * 4
+        * sizeof(GLfloat);
+    size_t const jobs =
+        (size_t)_atlasSize.x * _atlasSize.y * 4 * sizeof(GLfloat)
+        + _jobCount * sizeof(JobEntry);
+    size_t const hints = (size_t)_hintPixels * sizeof(GLuint);
+    _gpuMemory.set(
+        (double)(image + views + probes + jobs + hints + _sceneBytes));
+}
+
+void ComputeRaytraceRenderer::_setFrameUniforms(Program const &program) const
+{
+    // Set output texture uniform.
+    program.setUniformS("outputImg", 0);
+    // Set ambient color uniform.
+    program.setUniformS("ambientColor", ambientColor);
+    // Set blank color.
+    program.setUniformS("blankColor", blankColor);
+    // Set eye position.
+    program.setUniformS("eyePosition", eyePosition);
+    // Set camera up vector.
+    program.setUniformS("eyeUp", eyeUp);
+    // Set camera forward vector.
+    program.setUniformS("eyeForward", eyeForward);
+    // Set FOV.
+    program.setUniformS("fov", fov);
+    // Set antialiasing sample count.
+    program.setUniformS("samplesPerPixel", std::max(samplesPerPixel, 1u));
+    program.setUniformS("firstSample", firstSample);
+    // Set the tile window.
+    program.setUniformS("tileOffset", tileOffset);
+    program.setUniformS("fullSize", fullSize);
+    // Scene array sizes, for backends that can't tell.
+    program.setUniformS(
+        "sceneSphereCount", (GLint)(_sphereBytes / sizeof(Sphere)));
+    program.setUniformS(
+        "sceneLightCount", (GLint)(_lightBytes / sizeof(OmniLight)));
+}
+
+void ComputeRaytraceRenderer::_dispatch(GLuint x, GLuint y, GLuint z)
+{
+    // Run the compute shader.
+    _dispatchTimer.begin();
+    ++gl_call_count;
+    glDispatchCompute(x, y, z);
+    _dispatchTimer.end();
+    _dispatches.add();
+    // Wait for the shader to finish writing to the image.
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    // Collect timings from earlier frames.
+    double ms = 0.0;
+    if (_dispatchTimer.poll(ms))
+    {
+        _dispatchTime.record((uint64_t)(ms * 1000.0));
+    }
 }
 
 Texture const &ComputeRaytraceRenderer::getResult() const
@@ -98,6 +430,35 @@ Texture const &ComputeRaytraceRenderer::getResult() const
     return _renderResult;
 }
 
+SceneUpload ComputeRaytraceRenderer::updateScene(
+    std::shared_ptr<SceneSnapshot const> const &snapshot)
+{
+    SceneUpload upload{0, 0, false, false, false};
+    if (snapshot == _resident)
+    {
+        return upload;
+    }
+    SceneSnapshot const *resident = _resident.get();
+    upload.spheresGrown = _updateComputeBuffer(
+        _spheres, _sphereCapacity, _sphereBytes, snapshot->spheres,
+        resident? &resident->spheres : nullptr, upload);
+    upload.materialsGrown = _updateComputeBuffer(
+        _materials, _materialCapacity, _materialBytes, snapshot->materials,
+        resident? &resident->materials : nullptr, upload);
+    upload.lightsGrown = _updateComputeBuffer(
+        _lights, _lightCapacity, _lightBytes, snapshot->lights,
+        resident? &resident->lights : nullptr, upload);
+    _resident = snapshot;
+    _sceneChunks.add(upload.chunks);
+    _updateMemoryGauge();
+    return upload;
+}
+
+uint64_t ComputeRaytraceRenderer::sceneVersion() const
+{
+    return _resident? _resident->version : 0;
+}
+
 void ComputeRaytraceRenderer::setRenderDimensions(GLuint width, GLuint height)
 {
     _width = width;
@@ -107,32 +468,567 @@ void ComputeRaytraceRenderer::setRenderDimensions(GLuint width, GLuint height)
         _renderResult.type(), 0, GL_RGBA32F, _width, _height, 0, GL_RGBA,
         GL_FLOAT, nullptr);
     _renderResult.unbind();
+    _updateMemoryGauge();
 }
 
-void ComputeRaytraceRenderer::render() const
+GLuint ComputeRaytraceRenderer::width() const
 {
+    return _width;
+}
+
+GLuint ComputeRaytraceRenderer::height() const
+{
+    return _height;
+}
+
+Camera ComputeRaytraceRenderer::camera() const
+{
+    return Camera{eyePosition, eyeForward, eyeUp, fov};
+}
+
+void ComputeRaytraceRenderer::setCamera(Camera const &camera)
+{
+    eyePosition = camera.position;
+    eyeForward = camera.forward;
+    eyeUp = camera.up;
+    fov = camera.fov;
+}
+
+std::vector<GLfloat> ComputeRaytraceRenderer::readResult() const
+{
+    std::vector<GLfloat> pixels((size_t)_width * _height * 4);
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    _renderResult.bind();
+    glGetTexImage(
+        _renderResult.type(), 0, GL_RGBA, GL_FLOAT, pixels.data());
+    _renderResult.unbind();
+    return pixels;
+}
+
+void ComputeRaytraceRenderer::render()
+{
+    _applySceneStorage();
+    bool const hinting = temporalHints && !depthInAlpha;
+    if (hinting)
+    {
+        if (!_hints)
+        {
+            _hints.reset(new Buffer{GL_SHADER_STORAGE_BUFFER, "HintSSBO"});
+        }
+        // Start over without hints whenever the size changes.
+        if (_hintPixels != _width * _height)
+        {
+            _hintPixels = _width * _height;
+            _hints->bind();
+            ++gl_call_count;
+            glBufferData(
+                _hints->target, _hintPixels * sizeof(GLuint), nullptr,
+                GL_DYNAMIC_COPY);
+            ++gl_call_count;
+            glClearBufferData(
+                _hints->target, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                nullptr);
+            _hints->unbind();
+            _updateMemoryGauge();
+        }
+        // Binding point of Hints in compute.comp.
+        ++gl_call_count;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, _hints->id());
+    }
+    Program const &program = (
+        depthInAlpha?
+            _variant(_depthCompute, {"DEPTH_ALPHA"}, "DepthComputeShader")
+        : hinting?
+            _variant(_hintCompute, {"TEMPORAL_HINT"}, "HintComputeShader")
+        : *_compute);
     // Use the compute shader.
-    _compute.use();
-    // Set output texture uniform.
+    program.use();
     glActiveTexture(GL_TEXTURE0);
     _renderResult.bind();
-    _compute.setUniformS("outputImg", 0);
-    // Set ambient color uniform.
-    _compute.setUniformS("ambientColor", ambientColor);
-    // Set blank color.
-    _compute.setUniformS("blankColor", blankColor);
-    // Set eye position.
-    _compute.setUniformS("eyePosition", eyePosition);
-    // Set camera up vector.
-    _compute.setUniformS("eyeUp", eyeUp);
-    // Set camera forward vector.
-    _compute.setUniformS("eyeForward", eyeForward);
-    // Set FOV.
-    _compute.setUniformS("fov", fov);
-    // Run the compute shader.
-    glDispatchCompute(_width, _height, 1);
-    // Wait for the shader to finish writing to the image.
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    _setFrameUniforms(program);
+    _dispatch(_width, _height, 1);
+    if (hinting)
+    {
+        // The hints are read back as storage by the next frame and by
+        // hintHitRate()'s histogram.
+        ++gl_call_count;
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+void ComputeRaytraceRenderer::_dispatchViews(
+    Program const &program, std::vector<View> const &views,
+    GLuint width, GLuint height)
+{
+    if (!_views)
+    {
+        _views.reset(new Buffer{GL_SHADER_STORAGE_BUFFER, "ViewSSBO"});
+    }
+    // Upload the cameras. Scene buffers are shared with render().
+    _views->bind();
+    _views->buffer(GL_DYNAMIC_DRAW, views);
+    _uploadBytes.add(views.size() * sizeof(View));
+    // Binding point of Views in compute.comp.
+    ++gl_call_count;
+    glBindBufferBase(_views->target, 8, _views->id());
+    _views->unbind();
+
+    program.use();
+    _setFrameUniforms(program);
+    // Views are always whole images.
+    program.setUniformS("tileOffset", glm::ivec2{0, 0});
+    program.setUniformS("fullSize", glm::ivec2{0, 0});
+    _dispatch(width, height, (GLuint)views.size());
+    // Put the render result back on image unit 0 for render().
+    ++gl_call_count;
+    glBindImageTexture(
+        0, _renderResult.id(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+}
+
+void ComputeRaytraceRenderer::renderViews(std::vector<Camera> const &cameras)
+{
+    if (cameras.empty())
+    {
+        return;
+    }
+    _applySceneStorage();
+    if (!_viewResults)
+    {
+        _viewResults.reset(new Texture{GL_TEXTURE_2D_ARRAY, "ViewResults"});
+        _viewResults->setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        _viewResults->setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        _viewResults->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        _viewResults->setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        _viewResults->unbind();
+    }
+
+    // Resize the output layers.
+    GLuint const count = (GLuint)cameras.size();
+    if (_viewWidth != _width || _viewHeight != _height || _viewCount != count)
+    {
+        _viewWidth = _width;
+        _viewHeight = _height;
+        _viewCount = count;
+        _viewResults->bind();
+        ++gl_call_count;
+        glTexImage3D(
+            _viewResults->type(), 0, GL_RGBA32F, _viewWidth, _viewHeight,
+            _viewCount, 0, GL_RGBA, GL_FLOAT, nullptr);
+        _viewResults->unbind();
+        _updateMemoryGauge();
+    }
+
+    std::vector<View> views(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto const &camera = cameras[i];
+        views[i] = View{
+            {camera.position.x, camera.position.y, camera.position.z, 0.0f},
+            {camera.forward.x, camera.forward.y, camera.forward.z, 0.0f},
+            {camera.up.x, camera.up.y, camera.up.z, 0.0f},
+            {camera.fov, 1.0f, 0.0f, 0.0f}};
+    }
+    // Every layer is written, so the array is bound to image unit 0 in place
+    // of the render result for the duration of the dispatch.
+    ++gl_call_count;
+    glBindImageTexture(
+        0, _viewResults->id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    _dispatchViews(
+        _variant(_multiView, {"MULTI_VIEW"}, "MultiViewShader"), views,
+        _width, _height);
+}
+
+Texture const &ComputeRaytraceRenderer::getViewResults() const
+{
+    if (!_viewResults)
+    {
+        throw std::runtime_error{"getViewResults - nothing rendered yet"};
+    }
+    return *_viewResults;
+}
+
+GLuint ComputeRaytraceRenderer::maxProbes() const
+{
+    // Each face is a layer of the cube map array and a workgroup along z.
+    GLint layers = 0;
+    GLint groups = 0;
+    gl_call_count += 2;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &layers);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 2, &groups);
+    return (GLuint)std::min(layers, groups) / 6;
+}
+
+void ComputeRaytraceRenderer::bakeProbes(
+    std::vector<glm::vec3> const &positions, GLuint faceSize)
+{
+    if (positions.empty())
+    {
+        return;
+    }
+    if (positions.size() > maxProbes())
+    {
+        throw std::runtime_error{
+            "bakeProbes - " + std::to_string(positions.size())
+            + " probes, at most " + std::to_string(maxProbes())
+            + " fit in one dispatch"};
+    }
+    _applySceneStorage();
+    if (!_probeResults)
+    {
+        _probeResults.reset(
+            new Texture{GL_TEXTURE_CUBE_MAP_ARRAY, "ProbeResults"});
+        _probeResults->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        _probeResults->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        _probeResults->unbind();
+    }
+
+    GLuint const count = (GLuint)positions.size();
+    if (_probeSize != faceSize || _probeCount != count)
+    {
+        _probeSize = faceSize;
+        _probeCount = count;
+        _probeResults->bind();
+        ++gl_call_count;
+        glTexImage3D(
+            _probeResults->type(), 0, GL_RGBA32F, _probeSize, _probeSize,
+            6 * _probeCount, 0, GL_RGBA, GL_FLOAT, nullptr);
+        _probeResults->unbind();
+        _updateMemoryGauge();
+    }
+
+    // Faces in layer-face order: +X, -X, +Y, -Y, +Z, -Z. Each face's s and t
+    // axes (OpenGL 4.6 table 8.19) are the view's side and up vectors; the
+    // side vector is the mirror of the raytracer's usual one.
+    static GLfloat const faces[6][2][3] = {
+        // Forward        Up
+        {{ 1,  0,  0}, { 0, -1,  0}},
+        {{-1,  0,  0}, { 0, -1,  0}},
+        {{ 0,  1,  0}, { 0,  0,  1}},
+        {{ 0, -1,  0}, { 0,  0, -1}},
+        {{ 0,  0,  1}, { 0, -1,  0}},
+        {{ 0,  0, -1}, { 0, -1,  0}},
+    };
+    // The raytracer puts the edge pixels' centers on the edges of the view,
+    // so a field of view a little under 90 degrees puts texel centers where
+    // cube map sampling expects them, with no seams between faces.
+    GLfloat const fov = 2.0f * std::atan(
+        (GLfloat)(faceSize - 1) / std::max(faceSize, 1u));
+    std::vector<View> views(6 * count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto const &p = positions[i];
+        for (size_t f = 0; f < 6; ++f)
+        {
+            auto const &forward = faces[f][0];
+            auto const &up = faces[f][1];
+            views[6 * i + f] = View{
+                {p.x, p.y, p.z, 0.0f},
+                {forward[0], forward[1], forward[2], 0.0f},
+                {up[0], up[1], up[2], 0.0f},
+                {fov, -1.0f, 0.0f, 0.0f}};
+        }
+    }
+    ++gl_call_count;
+    glBindImageTexture(
+        0, _probeResults->id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    _dispatchViews(
+        _variant(_probeBake, {"MULTI_VIEW", "CUBE_ARRAY"}, "ProbeBakeShader"),
+        views, faceSize, faceSize);
+}
+
+Texture const &ComputeRaytraceRenderer::getProbeResults() const
+{
+    if (!_probeResults)
+    {
+        throw std::runtime_error{"getProbeResults - nothing baked yet"};
+    }
+    return *_probeResults;
+}
+
+GLuint ComputeRaytraceRenderer::maxJobs() const
+{
+    GLint groups = 0;
+    ++gl_call_count;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 2, &groups);
+    return (GLuint)groups;
+}
+
+std::vector<glm::ivec4> ComputeRaytraceRenderer::renderJobs(
+    std::vector<RenderJob> const &jobs)
+{
+    if (jobs.empty())
+    {
+        return {};
+    }
+    if (jobs.size() > maxJobs())
+    {
+        throw std::runtime_error{
+            "renderJobs - " + std::to_string(jobs.size())
+            + " jobs, at most " + std::to_string(maxJobs())
+            + " fit in one dispatch"};
+    }
+    _applySceneStorage();
+    if (!_jobResults)
+    {
+        _jobResults.reset(new Texture{GL_TEXTURE_2D, "JobResults"});
+        _jobResults->setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        _jobResults->setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        _jobResults->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        _jobResults->setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        _jobResults->unbind();
+        _jobs.reset(new Buffer{GL_SHADER_STORAGE_BUFFER, "JobSSBO"});
+    }
+
+    // Lay the jobs out in the atlas.
+    std::vector<glm::ivec2> sizes(jobs.size());
+    glm::ivec2 largest{0, 0};
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (jobs[i].width == 0 || jobs[i].height == 0)
+        {
+            throw std::runtime_error{
+                "renderJobs - job " + std::to_string(i) + " has no pixels"};
+        }
+        sizes[i] = glm::ivec2{(int)jobs[i].width, (int)jobs[i].height};
+        largest.x = std::max(largest.x, sizes[i].x);
+        largest.y = std::max(largest.y, sizes[i].y);
+    }
+    GLint limit = 0;
+    ++gl_call_count;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+    glm::ivec2 atlas{};
+    std::vector<glm::ivec2> const corners = pack_atlas(sizes, limit, atlas);
+    GLuint const count = (GLuint)jobs.size();
+    if (atlas != _atlasSize || count != _jobCount)
+    {
+        if (atlas != _atlasSize)
+        {
+            _jobResults->bind();
+            ++gl_call_count;
+            glTexImage2D(
+                _jobResults->type(), 0, GL_RGBA32F, atlas.x, atlas.y, 0,
+                GL_RGBA, GL_FLOAT, nullptr);
+            _jobResults->unbind();
+        }
+        _atlasSize = atlas;
+        _jobCount = count;
+        _updateMemoryGauge();
+    }
+
+    // Upload the job table.
+    std::vector<glm::ivec4> rects(count);
+    std::vector<JobEntry> entries(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto const &job = jobs[i];
+        auto const &camera = job.camera;
+        rects[i] = glm::ivec4{
+            corners[i].x, corners[i].y, sizes[i].x, sizes[i].y};
+        entries[i] = JobEntry{
+            {   {camera.position.x, camera.position.y, camera.position.z, 0},
+                {camera.forward.x, camera.forward.y, camera.forward.z, 0},
+                {camera.up.x, camera.up.y, camera.up.z, 0},
+                {camera.fov, 1.0f, 0.0f, 0.0f}},
+            {rects[i].x, rects[i].y, rects[i].z, rects[i].w},
+            {   (GLint)std::min<GLuint>(job.firstSphere, INT_MAX),
+                (GLint)std::min<GLuint>(job.sphereCount, INT_MAX),
+                (GLint)std::min<GLuint>(job.firstLight, INT_MAX),
+                (GLint)std::min<GLuint>(job.lightCount, INT_MAX)}};
+    }
+    _jobs->bind();
+    _jobs->buffer(GL_DYNAMIC_DRAW, entries);
+    _uploadBytes.add(entries.size() * sizeof(JobEntry));
+    // Binding point of Jobs in compute.comp.
+    ++gl_call_count;
+    glBindBufferBase(_jobs->target, 9, _jobs->id());
+    _jobs->unbind();
+
+    // Pixels outside every job's rectangle are left as they were.
+    ++gl_call_count;
+    glBindImageTexture(
+        0, _jobResults->id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    Program const &program = _variant(
+        _jobBatch, {"JOB_BATCH"}, "JobBatchShader");
+    program.use();
+    _setFrameUniforms(program);
+    program.setUniformS("tileOffset", glm::ivec2{0, 0});
+    program.setUniformS("fullSize", glm::ivec2{0, 0});
+    _dispatch(largest.x, largest.y, count);
+    ++gl_call_count;
+    glBindImageTexture(
+        0, _renderResult.id(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    return rects;
+}
+
+Texture const &ComputeRaytraceRenderer::getJobResults() const
+{
+    if (!_jobResults)
+    {
+        throw std::runtime_error{"getJobResults - nothing rendered yet"};
+    }
+    return *_jobResults;
+}
+
+glm::ivec2 ComputeRaytraceRenderer::jobAtlasSize() const
+{
+    return _atlasSize;
+}
+
+std::vector<TraceEvent> ComputeRaytraceRenderer::inspect(
+    GLuint x, GLuint y, GLuint &dropped)
+{
+    // Big enough for the primary ray of a few-thousand-sphere scene.
+    static size_t const capacity = 4096;
+    _applySceneStorage();
+    std::vector<std::string> defines{"TRACE_INSPECTOR"};
+    if (_traceClock)
+    {
+        defines.push_back("HAS_SHADER_CLOCK");
+    }
+    Program const &inspector = _variant(
+        _inspector, defines, "TraceInspectorShader");
+    if (!_traceLog)
+    {
+        _traceLog.reset(
+            new Buffer{GL_SHADER_STORAGE_BUFFER, "TraceLogSSBO"});
+        _traceLog->bind();
+        ++gl_call_count;
+        glBufferData(
+            _traceLog->target,
+            2 * sizeof(GLuint) + capacity * sizeof(TraceEvent), nullptr,
+            GL_DYNAMIC_READ);
+        _traceLog->unbind();
+    }
+    // Reset the log header.
+    GLuint const header[2] = {0, 0};
+    _traceLog->bind();
+    ++gl_call_count;
+    glBufferSubData(_traceLog->target, 0, sizeof(header), header);
+    // Binding point of TraceLog in compute.comp.
+    ++gl_call_count;
+    glBindBufferBase(_traceLog->target, 3, _traceLog->id());
+
+    // Trace the pixel, with the same uniforms as a normal render.
+    inspector.use();
+    ++gl_call_count;
+    glActiveTexture(GL_TEXTURE0);
+    _renderResult.bind();
+    _setFrameUniforms(inspector);
+    inspector.setUniformS("inspectPixel", glm::ivec2{(int)x, (int)y});
+    ++gl_call_count;
+    glDispatchCompute(1, 1, 1);
+    ++gl_call_count;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Read the log back.
+    GLuint count[2] = {0, 0};
+    ++gl_call_count;
+    glGetBufferSubData(_traceLog->target, 0, sizeof(count), count);
+    std::vector<TraceEvent> events(std::min<size_t>(count[0], capacity));
+    ++gl_call_count;
+    glGetBufferSubData(
+        _traceLog->target, sizeof(count), events.size() * sizeof(TraceEvent),
+        events.data());
+    _traceLog->unbind();
+    dropped = count[1];
+    return events;
+}
+
+bool ComputeRaytraceRenderer::inspectorHasClock() const
+{
+    return _traceClock;
+}
+
+double ComputeRaytraceRenderer::hintHitRate()
+{
+    if (_hintPixels == 0)
+    {
+        return 0.0;
+    }
+    if (!_primitives)
+    {
+        _primitives.reset(new GPUPrimitives{});
+        _hintOutcomes.reset(
+            new Buffer{GL_SHADER_STORAGE_BUFFER, "HintOutcomes"});
+        _hintOutcomes->bind();
+        ++gl_call_count;
+        glBufferData(
+            _hintOutcomes->target, 4 * sizeof(GLuint), nullptr,
+            GL_DYNAMIC_READ);
+        _hintOutcomes->unbind();
+    }
+    // Count the pixels with each outcome, from the top two bits of each
+    // hint (see HINT_* in compute.comp).
+    _primitives->histogram(*_hints, *_hintOutcomes, _hintPixels, 4, 30);
+    GLuint outcomes[4] = {0, 0, 0, 0};
+    _hintOutcomes->bind();
+    ++gl_call_count;
+    glGetBufferSubData(
+        _hintOutcomes->target, 0, sizeof(outcomes), outcomes);
+    _hintOutcomes->unbind();
+    GLuint const hinted = outcomes[1] + outcomes[2];
+    double const rate = hinted == 0? 0.0 : (double)outcomes[2] / hinted;
+    _hintHitRate.set(rate);
+    return rate;
+}
+
+SceneStorageConfig ComputeRaytraceRenderer::resolvedSceneStorage() const
+{
+    return SceneStorageConfig{
+        _resolveStorage(sceneStorage.spheres, _sphereBytes),
+        _resolveStorage(sceneStorage.materials, _materialBytes),
+        _resolveStorage(sceneStorage.lights, _lightBytes)};
+}
+
+SceneStorageConfig ComputeRaytraceRenderer::tuneSceneStorage(unsigned frames)
+{
+    std::pair<SceneStorage *, size_t> const arrays[] = {
+        {&sceneStorage.spheres, _sphereBytes},
+        {&sceneStorage.materials, _materialBytes},
+        {&sceneStorage.lights, _lightBytes},
+    };
+    Query const query{GL_TIME_ELAPSED, "StorageTuneQuery"};
+    for (auto const &array : arrays)
+    {
+        if (*array.first != STORAGE_AUTO)
+        {
+            continue;
+        }
+        SceneStorage best = STORAGE_SSBO;
+        GLuint64 best_ns = 0;
+        for (SceneStorage const candidate
+            : {STORAGE_SSBO, STORAGE_UBO, STORAGE_TBO})
+        {
+            // Skip backends the array doesn't fit in.
+            if (_resolveStorage(candidate, array.second) != candidate)
+            {
+                continue;
+            }
+            *array.first = candidate;
+            // Build the variant and warm up before timing.
+            render();
+            query.begin();
+            for (unsigned i = 0; i < std::max(frames, 1u); ++i)
+            {
+                render();
+            }
+            query.end();
+            GLuint64 const ns = query.result();
+            if (candidate == STORAGE_SSBO || ns < best_ns)
+            {
+                best = candidate;
+                best_ns = ns;
+            }
+        }
+        *array.first = best;
+    }
+    _applySceneStorage();
+    return resolvedSceneStorage();
+}
+
+double ComputeRaytraceRenderer::dispatchTime() const
+{
+    return _dispatchTimer.last();
 }
 
 
@@ -144,6 +1040,7 @@ RenderResultDisplay::RenderResultDisplay()
             shader_from_file("shaders/fragment.frag", GL_FRAGMENT_SHADER)},
         "RenderDisplayShader"}
 ,   _screenQuadVAO{"ScreenQuadVAO"}
+,   _gridDisplay{}
 ,   dithering{false}
 {
     /* ===[ Create ScreenQuad ]=== */
@@ -179,6 +1076,33 @@ void RenderResultDisplay::draw(Texture const &result) const
     _display.setUniformS("tex", 0);
     _display.setUniformS("dithering", dithering);
     // Render the screenquad.
+    ++gl_call_count;
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(_screenQuadVertices.size()/5));
+}
+
+void RenderResultDisplay::drawViews(
+    Texture const &views, GLuint columns, GLuint rows)
+{
+    if (!_gridDisplay)
+    {
+        _gridDisplay.reset(new Program{
+            {   shader_from_file("shaders/vertex.vert", GL_VERTEX_SHADER),
+                shader_from_file(
+                    "shaders/fragment.frag", GL_FRAGMENT_SHADER,
+                    {"VIEW_GRID"})},
+            "ViewGridDisplayShader"});
+    }
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    _gridDisplay->use();
+    _screenQuadVAO.bind();
+    glActiveTexture(GL_TEXTURE0);
+    views.bind();
+    _gridDisplay->setUniformS("tex", 0);
+    _gridDisplay->setUniformS("dithering", dithering);
+    _gridDisplay->setUniformS(
+        "grid", glm::ivec2{(int)columns, (int)rows});
+    ++gl_call_count;
     glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(_screenQuadVertices.size()/5));
 }
 
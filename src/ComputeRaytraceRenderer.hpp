@@ -20,8 +20,15 @@
 #define _COMPUTE_RAYTRACE_RENDERER_HPP
 
 #include "glUtil.hpp"
+#include "GPUPrimitives.hpp"
+#include "GPUTimer.hpp"
+#include "Metrics.hpp"
+#include "SceneSnapshot.hpp"
+#include "SceneStorage.hpp"
 #include "ShaderStructs.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 
@@ -36,39 +43,259 @@ struct Scene
 };
 
 
+/**
+ * Camera placement.
+ *  position - Eye position.
+ *  forward - View direction.
+ *  up - Up direction.
+ *  fov - Horizontal field of view, in radians.
+ */
+struct Camera
+{
+    glm::vec3 position;
+    glm::vec3 forward;
+    glm::vec3 up;
+    GLfloat fov;
+};
+
+
+/**
+ * A small render for ComputeRaytraceRenderer::renderJobs().
+ *  camera - Camera placement.
+ *  width, height - Size of the result.
+ *  firstSphere, sphereCount - Range of the scene's spheres rendered.
+ *  firstLight, lightCount - Range of the scene's lights used.
+ * Ranges are clipped to the scene, so a count of ~0u means "to the end".
+ */
+struct RenderJob
+{
+    Camera camera;
+    GLuint width, height;
+    GLuint firstSphere, sphereCount;
+    GLuint firstLight, lightCount;
+};
+
+
+/**
+ * What ComputeRaytraceRenderer::updateScene() uploaded.
+ *  chunks - Chunks uploaded.
+ *  bytes - Bytes uploaded.
+ *  spheresGrown, materialsGrown, lightsGrown - The array's buffer had to
+ *      grow, so all of it was uploaded.
+ */
+struct SceneUpload
+{
+    size_t chunks;
+    size_t bytes;
+    bool spheresGrown, materialsGrown, lightsGrown;
+};
+
+
 /**
  * Renders Scenes using OpenGL compute shaders.
  */
 class ComputeRaytraceRenderer
 {
 private:
-    Program _compute;
+    // Every variant of the compute shader is built for the scene storage
+    // backends in use, and rebuilt when they change.
+    std::unique_ptr<Program> _compute;
     Texture _renderResult;
 
     Buffer _spheres;
     Buffer _materials;
     Buffer _lights;
+    // Allocated sizes of the scene buffers, which may be more than is used.
+    size_t _sphereCapacity, _materialCapacity, _lightCapacity;
+    // Bytes of each scene buffer in use.
+    size_t _sphereBytes, _materialBytes, _lightBytes;
+    // Backends the shader variants were built for, with STORAGE_AUTO
+    // resolved, and whether the scene buffers need binding for them again.
+    SceneStorageConfig _storage;
+    bool _sceneDirty;
+    // Size of the uniform blocks of STORAGE_UBO arrays, and most 32-bit
+    // words a STORAGE_TBO array can have.
+    size_t _uniformBlockBytes;
+    size_t _maxTexelWords;
+    // Buffer textures viewing the scene buffers. Created on first use.
+    std::unique_ptr<Texture> _sphereTexels, _materialTexels, _lightTexels;
+    // Last version given to updateScene(), kept so later versions can be
+    // diffed against it chunk by chunk.
+    std::shared_ptr<SceneSnapshot const> _resident;
 
     GLuint _width, _height;
 
+    // DEPTH_ALPHA variant, used instead of _compute when depthInAlpha is
+    // set. Created on first use.
+    std::unique_ptr<Program> _depthCompute;
+
+    // TEMPORAL_HINT variant, used instead of _compute when temporalHints is
+    // set, with its per-pixel hints and the histogram counting their
+    // outcomes. Created on first use.
+    std::unique_ptr<Program> _hintCompute;
+    std::unique_ptr<Buffer> _hints;
+    std::unique_ptr<GPUPrimitives> _primitives;
+    std::unique_ptr<Buffer> _hintOutcomes;
+    GLuint _hintPixels;
+
+    // Single-pixel trace inspector. Created on first use, so it costs
+    // nothing unless inspect() is called.
+    std::unique_ptr<Program> _inspector;
+    std::unique_ptr<Buffer> _traceLog;
+    bool _traceClock;
+
+    // Multi-view rendering. Also created on first use.
+    std::unique_ptr<Program> _multiView;
+    std::unique_ptr<Texture> _viewResults;
+    std::unique_ptr<Buffer> _views;
+    GLuint _viewWidth, _viewHeight, _viewCount;
+
+    // Probe baking, the MULTI_VIEW kernel writing to a cube map array.
+    std::unique_ptr<Program> _probeBake;
+    std::unique_ptr<Texture> _probeResults;
+    GLuint _probeSize, _probeCount;
+
+    // Batched small renders, packed into an atlas. Created on first use.
+    std::unique_ptr<Program> _jobBatch;
+    std::unique_ptr<Texture> _jobResults;
+    std::unique_ptr<Buffer> _jobs;
+    glm::ivec2 _atlasSize;
+    GLuint _jobCount;
+
+    GPUTimer _dispatchTimer;
+    size_t _sceneBytes;
+    Counter &_dispatches;
+    Counter &_uploadBytes;
+    Counter &_sceneChunks;
+    Histogram &_dispatchTime;
+    Gauge &_gpuMemory;
+    Gauge &_hintHitRate;
+
+    /** Backend an array of `bytes` bytes gets when `storage` is asked for. */
+    SceneStorage _resolveStorage(SceneStorage storage, size_t bytes) const;
+
+    /**
+     * Rebuild the shader variants if the backends sceneStorage resolves to
+     * have changed, and bind the scene buffers for them if needed. Called
+     * before every dispatch that reads the scene.
+     */
+    void _applySceneStorage();
+
+    /**
+     * Bind scene buffer `index` (0 spheres, 1 materials, 2 lights) for a
+     * backend, creating its buffer texture if needed. STORAGE_UBO binds a
+     * whole uniform block, so the buffer is padded to one first.
+     */
+    void _bindSceneArray(
+        Buffer &buffer, GLuint index, size_t &capacity, size_t bytes,
+        SceneStorage storage, std::unique_ptr<Texture> &texels);
+
+    /**
+     * Reallocate a scene buffer smaller than a uniform block to a block's
+     * size, keeping its first `bytes`.
+     */
+    void _padToUniformBlock(Buffer &buffer, size_t &capacity, size_t bytes);
+
+    /**
+     * Get a variant of the compute shader with `defines`, building it for the
+     * scene storage in use if `program` is empty.
+     */
+    Program const &_variant(
+        std::unique_ptr<Program> &program, std::vector<std::string> defines,
+        std::string const &label);
+
+    /** Publish the GPU memory held by the renderer. */
+    void _updateMemoryGauge();
+
+    /**
+     * Set the uniforms shared by every variant of the compute shader.
+     * The eye* uniforms are ignored by the MULTI_VIEW variant.
+     */
+    void _setFrameUniforms(Program const &program) const;
+
+    /** Time a dispatch of the current program, then wait for its writes. */
+    void _dispatch(GLuint x, GLuint y, GLuint z);
+
+    /**
+     * Render `views` with a MULTI_VIEW program, one per layer of the image
+     * bound to unit 0, each `width` by `height`.
+     */
+    void _dispatchViews(
+        Program const &program, std::vector<View> const &views,
+        GLuint width, GLuint height);
+
+    /**
+     * Upload a scene buffer, allocating only what it uses. Arrays bound as
+     * STORAGE_UBO are padded later, by _bindSceneArray().
+     */
     template<typename T>
     void _initComputeBuffer(
-        Buffer &buffer, std::string const &buffer_name,
-        std::vector<T> const &data) const
+        Buffer &buffer, std::vector<T> const &data, size_t &capacity,
+        size_t &used)
     {
+        used = data.size() * sizeof(T);
+        capacity = used;
         buffer.bind();
-        buffer.buffer(GL_STATIC_DRAW, data);
-        // Set the SSBO's binding point.
-        auto binding = glGetProgramResourceIndex(
-            _compute.id(), GL_SHADER_STORAGE_BLOCK, buffer_name.c_str());
-        if (binding == GL_INVALID_INDEX)
+        ++gl_call_count;
+        glBufferData(buffer.target, capacity, nullptr, GL_STATIC_DRAW);
+        ++gl_call_count;
+        glBufferSubData(buffer.target, 0, used, data.data());
+        buffer.unbind();
+        _sceneBytes += capacity;
+        _uploadBytes.add(used);
+        _sceneDirty = true;
+    }
+
+    /**
+     * Bring a scene buffer up to date with `next`, uploading only the chunks
+     * that aren't shared with `resident` (all of them if it's null, or if
+     * the buffer has to grow), and adding them to `upload`. Returns true if
+     * the buffer grew.
+     */
+    template<typename T>
+    bool _updateComputeBuffer(
+        Buffer &buffer, size_t &capacity, size_t &used,
+        ChunkedArray<T> const &next, ChunkedArray<T> const *resident,
+        SceneUpload &upload)
+    {
+        size_t const bytes = next.size() * sizeof(T);
+        bool const grow = bytes > capacity;
+        buffer.bind();
+        if (grow)
         {
-            throw std::runtime_error{
-                "glGetProgramResourceIndex - no shader storage block named "
-                "'Spheres'"};
+            // Grow geometrically, so appending repeatedly stays cheap.
+            size_t const grown = std::max(bytes, capacity * 2);
+            ++gl_call_count;
+            glBufferData(buffer.target, grown, nullptr, GL_STATIC_DRAW);
+            _sceneBytes += grown - capacity;
+            capacity = grown;
+            resident = nullptr;
+            _sceneDirty = true;
+        }
+        for (size_t c = 0; c < next.chunkCount(); ++c)
+        {
+            if (resident && c < resident->chunkCount()
+                && resident->chunk(c) == next.chunk(c))
+            {
+                continue;
+            }
+            auto const &chunk = *next.chunk(c);
+            ++gl_call_count;
+            glBufferSubData(
+                buffer.target, c * ChunkedArray<T>::CHUNK * sizeof(T),
+                chunk.size() * sizeof(T), chunk.data());
+            _uploadBytes.add(chunk.size() * sizeof(T));
+            upload.bytes += chunk.size() * sizeof(T);
+            ++upload.chunks;
         }
-        glBindBufferBase(buffer.target, binding, buffer.id());
         buffer.unbind();
+        // The bound range (or element count) changes with the size.
+        if (bytes != used)
+        {
+            used = bytes;
+            _sceneDirty = true;
+        }
+        return grow;
     }
 
 public:
@@ -78,17 +305,150 @@ public:
     glm::vec3 eyeForward;
     glm::vec3 eyeUp;
     GLfloat fov;
+    /** Rays per pixel, averaged for antialiasing. */
+    GLuint samplesPerPixel;
+    /**
+     * Index of the first antialiasing sample. Averaging renders with
+     * firstSample = 0, N, 2N... gives the same result as one render with more
+     * samples.
+     */
+    GLuint firstSample;
+    /**
+     * Tiled rendering: when fullSize is non-zero, the render result is the
+     * window of a fullSize image starting at tileOffset (from the bottom
+     * left), so images larger than a texture can be rendered piecewise.
+     */
+    glm::ivec2 tileOffset;
+    glm::ivec2 fullSize;
+    /**
+     * Make render() store the distance from the eye to the nearest hit in
+     * the result's alpha channel (3e38 where nothing was hit), so renders of
+     * parts of a scene can be depth-composited. NOTE: With more than one
+     * sample per pixel this is the nearest sample's distance, while the
+     * colour averages them all, so compositing is only exact at one.
+     */
+    bool depthInAlpha;
+    /**
+     * Make render() remember the sphere each pixel hit, and test it first
+     * next frame, which bounds the search for the nearest hit. Pays off
+     * when the camera moves smoothly. Ignored with depthInAlpha.
+     */
+    bool temporalHints;
+    /**
+     * Where the compute shader reads each scene array from. Arrays too big
+     * for the backend asked for use STORAGE_SSBO, and changing backends
+     * rebuilds the shader, so updateScene() growing an array past a uniform
+     * block costs a recompile.
+     */
+    SceneStorageConfig sceneStorage;
 
     ComputeRaytraceRenderer(Scene const &scene, GLuint width, GLuint height);
 
     /** Get the render result. */
     Texture const &getResult() const;
 
+    /**
+     * Make `snapshot` the scene rendered from now on. Only the chunks of its
+     * arrays that differ from the last snapshot given are uploaded, so
+     * taking the latest version from a SceneStore each frame costs little
+     * when edits are small, and nothing when there are none. Returns what
+     * was uploaded.
+     */
+    SceneUpload updateScene(std::shared_ptr<SceneSnapshot const> const &snapshot);
+    /** Version of the last snapshot given to updateScene(), or 0. */
+    uint64_t sceneVersion() const;
+
     /** Set the render output dimensions. */
     void setRenderDimensions(GLuint width, GLuint height);
+    /** Get the render output width. */
+    GLuint width() const;
+    /** Get the render output height. */
+    GLuint height() const;
+
+    /** Get the eye placement. */
+    Camera camera() const;
+    /** Set the eye placement. */
+    void setCamera(Camera const &camera);
+
+    /**
+     * Read the render result back as RGBA floats, bottom row first.
+     * NOTE: This waits for rendering to finish!
+     */
+    std::vector<GLfloat> readResult() const;
 
     /** Render the scene. */
-    void render() const;
+    void render();
+
+    /**
+     * Render the scene from each camera, in a single dispatch, into the
+     * layers of getViewResults(). Each view is the render output size.
+     */
+    void renderViews(std::vector<Camera> const &cameras);
+    /**
+     * Get the results of renderViews(), a 2D texture array with a layer per
+     * camera. NOTE: Throws if renderViews() hasn't been called.
+     */
+    Texture const &getViewResults() const;
+
+    /** Most probes bakeProbes() can take at once. */
+    GLuint maxProbes() const;
+    /**
+     * Render a `faceSize` square cube map at each position, all in a single
+     * dispatch, into getProbeResults(). Throws if there are more than
+     * maxProbes() positions.
+     */
+    void bakeProbes(std::vector<glm::vec3> const &positions, GLuint faceSize);
+    /**
+     * Get the results of bakeProbes(), a cube map array with a cube per
+     * probe. NOTE: Throws if bakeProbes() hasn't been called.
+     */
+    Texture const &getProbeResults() const;
+
+    /** Most jobs renderJobs() can take at once. */
+    GLuint maxJobs() const;
+    /**
+     * Pack the jobs into an atlas and render all of them in a single
+     * dispatch into getJobResults(). Returns each job's rectangle in the
+     * atlas: its bottom left corner, then its size. Throws if there are more
+     * than maxJobs() jobs or they don't fit in a texture.
+     */
+    std::vector<glm::ivec4> renderJobs(std::vector<RenderJob> const &jobs);
+    /**
+     * Get the atlas written by renderJobs().
+     * NOTE: Throws if renderJobs() hasn't been called.
+     */
+    Texture const &getJobResults() const;
+    /** Size of the atlas written by the last renderJobs(). */
+    glm::ivec2 jobAtlasSize() const;
+
+    /**
+     * Re-trace a single pixel with logging on, returning every step it took.
+     * Also returns the number of events dropped because the log was full.
+     */
+    std::vector<TraceEvent> inspect(GLuint x, GLuint y, GLuint &dropped);
+    /** Check if inspect() costs are in GPU clocks rather than work units. */
+    bool inspectorHasClock() const;
+
+    /**
+     * Fraction of pixels in the last render() with a temporal hint whose
+     * first ray hit the hinted sphere, or 0 without temporalHints. Also
+     * published as a metric.
+     * NOTE: This waits for rendering to finish!
+     */
+    double hintHitRate();
+
+    /** Backends in use for sceneStorage, with STORAGE_AUTO resolved. */
+    SceneStorageConfig resolvedSceneStorage() const;
+    /**
+     * Pick the fastest backend of each array set to STORAGE_AUTO in
+     * sceneStorage, by timing `frames` calls to render() with each backend
+     * it fits in, one array at a time. Returns the backends picked.
+     * NOTE: This waits for rendering to finish!
+     */
+    SceneStorageConfig tuneSceneStorage(unsigned frames=8);
+
+    /** Most recent GPU time of the raytrace dispatch, in milliseconds. */
+    double dispatchTime() const;
 };
 
 
@@ -101,6 +461,8 @@ private:
     static std::vector<GLfloat> const _screenQuadVertices;
     Program const _display;
     VertexArray const _screenQuadVAO;
+    // VIEW_GRID variant of the display shader. Created on first use.
+    std::unique_ptr<Program> _gridDisplay;
 public:
     bool dithering;
 
@@ -108,6 +470,11 @@ public:
 
     /** Draw the result to the screen. */
     void draw(Texture const &result) const;
+    /**
+     * Draw the layers of a 2D texture array to the screen as a grid of
+     * `columns` by `rows` cells, top left first.
+     */
+    void drawViews(Texture const &views, GLuint columns, GLuint rows);
 };
 
 
@@ -0,0 +1,51 @@
+/**
+ * DeltaProtocol.hpp - Wire format of tile-delta frame streams.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DELTAPROTOCOL_HPP
+#define _DELTAPROTOCOL_HPP
+
+#include <cstdint>
+
+
+/** Tile width and height. NOTE: Must match TILE in tiledelta.comp. */
+static uint32_t const DELTA_TILE = 16;
+/** Bytes of 8-bit RGB per tile. */
+static uint32_t const DELTA_TILE_BYTES = DELTA_TILE * DELTA_TILE * 3;
+
+/**
+ * Sent before each frame's tiles. Everything is little-endian.
+ *  magic - "RTDF".
+ *  frame - Frame number.
+ *  width, height - Image size. A viewer should clear its image when this
+ *                  changes; every tile is resent then anyway.
+ *  tileCount - Number of tiles that follow.
+ *
+ * Each tile is a uint32_t tile index (row-major, counting tiles from the
+ * top left), then DELTA_TILE_BYTES of 8-bit RGB, top row first. Pixels past
+ * the image's right and bottom edges are padding.
+ */
+struct DeltaFrameHeader
+{
+    char magic[4];
+    uint32_t frame;
+    uint32_t width, height;
+    uint32_t tileCount;
+};
+
+
+#endif
@@ -0,0 +1,310 @@
+/**
+ * DeltaStream.cpp - Streams the tiles of each frame that changed.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "DeltaStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+
+/** Storage block bindings of tiledelta.comp. */
+static GLuint const HASHES_BINDING = 5;
+static GLuint const CHANGED_BINDING = 6;
+static GLuint const DATA_BINDING = 7;
+/** Image unit the source texture is bound to. */
+static GLint const SOURCE_UNIT = 1;
+
+
+DeltaStreamer::DeltaStreamer(
+    std::string const &path, size_t depth, size_t max_queued)
+:   _delta{
+        {shader_from_file("shaders/tiledelta.comp", GL_COMPUTE_SHADER)},
+        "TileDelta"}
+,   _hashes{GL_SHADER_STORAGE_BUFFER, "TileHashes"}
+,   _listener{Socket::listenUnix(path)}
+,   _slots{}
+,   _tail{0}
+,   _pending{0}
+,   _width{0}
+,   _height{0}
+,   _keyframe{true}
+,   _frame{0}
+,   _dropping{false}
+,   _sentBytes{MetricsRegistry::global().counter(
+        "delta_stream_bytes_total", "Bytes sent to tile-delta viewers.")}
+,   _sentTiles{MetricsRegistry::global().counter(
+        "delta_stream_tiles_total", "Changed tiles sent to viewers.")}
+,   _droppedFrames{MetricsRegistry::global().counter(
+        "delta_stream_dropped_frames_total",
+        "Frames dropped because viewers fell behind.")}
+,   _clients{}
+,   _maxQueued{std::max<size_t>(max_queued, 1)}
+,   _messages{}
+,   _joining{}
+,   _viewers{0}
+,   _stop{false}
+,   _mutex{}
+,   _wake{}
+,   _thread{}
+{
+    for (size_t i = 0; i < std::max<size_t>(depth, 1); ++i)
+    {
+        _slots.push_back(Slot{
+            Buffer{GL_SHADER_STORAGE_BUFFER, "ChangedTiles"},
+            Buffer{GL_SHADER_STORAGE_BUFFER, "TileData"},
+            0, nullptr, DeltaFrameHeader{}, false});
+    }
+    _thread = std::thread{&DeltaStreamer::_run, this};
+}
+
+DeltaStreamer::~DeltaStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stop = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+}
+
+size_t DeltaStreamer::viewers() const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    return _viewers + _joining.size();
+}
+
+void DeltaStreamer::_accept()
+{
+    while (_listener.waitReadable(0.0))
+    {
+        Socket client = _listener.accept();
+        std::lock_guard<std::mutex> lock{_mutex};
+        _joining.push_back(client);
+        // The newcomer needs the whole image.
+        _keyframe = true;
+    }
+}
+
+void DeltaStreamer::submit(Texture const &texture, GLuint width, GLuint height)
+{
+    _accept();
+    if (viewers() == 0)
+    {
+        return;
+    }
+    // Never block on the GPU unless the ring is full.
+    pump();
+    if (_pending == _slots.size())
+    {
+        _send(true);
+    }
+
+    GLuint const across = (width + DELTA_TILE - 1) / DELTA_TILE;
+    GLuint const down = (height + DELTA_TILE - 1) / DELTA_TILE;
+    size_t const tiles = (size_t)across * down;
+    if (width != _width || height != _height)
+    {
+        _width = width;
+        _height = height;
+        _keyframe = true;
+        _hashes.bind();
+        _hashes.buffer(
+            GL_DYNAMIC_COPY, std::vector<GLuint>(tiles * 2, 0));
+        _hashes.unbind();
+    }
+
+    Slot &slot = _slots[(_tail + _pending) % _slots.size()];
+    if (slot.tiles < tiles)
+    {
+        slot.tiles = tiles;
+        slot.changed.bind();
+        ++gl_call_count;
+        glBufferData(
+            slot.changed.target, (tiles + 1) * sizeof(GLuint), nullptr,
+            GL_STREAM_READ);
+        slot.data.bind();
+        ++gl_call_count;
+        glBufferData(
+            slot.data.target, tiles * DELTA_TILE_BYTES, nullptr,
+            GL_STREAM_READ);
+        slot.data.unbind();
+    }
+    // Reset the changed tile count.
+    slot.changed.bind();
+    slot.changed.update(std::vector<GLuint>{0});
+    slot.changed.unbind();
+
+    gl_call_count += 3;
+    glBindBufferBase(_hashes.target, HASHES_BINDING, _hashes.id());
+    glBindBufferBase(slot.changed.target, CHANGED_BINDING, slot.changed.id());
+    glBindBufferBase(slot.data.target, DATA_BINDING, slot.data.id());
+    _delta.use();
+    ++gl_call_count;
+    glBindImageTexture(
+        SOURCE_UNIT, texture.id(), 0, GL_FALSE, 0, GL_READ_ONLY,
+        GL_RGBA32F);
+    _delta.setUniformS("source", SOURCE_UNIT);
+    _delta.setUniformS("keyframe", _keyframe);
+    ++gl_call_count;
+    glDispatchCompute(across, down, 1);
+    // The hashes are read by the next dispatch; the tiles by glGetBuffer*
+    // and glMapBuffer*.
+    ++gl_call_count;
+    glMemoryBarrier(
+        GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    slot.fence.reset(new Fence{});
+    glFlush();
+
+    std::memcpy(slot.header.magic, "RTDF", 4);
+    slot.header.frame = _frame++;
+    slot.header.width = width;
+    slot.header.height = height;
+    slot.header.tileCount = 0;
+    slot.keyframe = _keyframe;
+    _keyframe = false;
+    ++_pending;
+}
+
+void DeltaStreamer::pump()
+{
+    while (_pending != 0 && _slots[_tail].fence->signaled())
+    {
+        _send(false);
+    }
+}
+
+void DeltaStreamer::_send(bool wait)
+{
+    Slot &slot = _slots[_tail];
+    if (wait)
+    {
+        slot.fence->wait();
+    }
+    _tail = (_tail + 1) % _slots.size();
+    --_pending;
+
+    // Only the writer thread takes messages off the queue, so if there's
+    // room now there still will be once this one is built. After a drop,
+    // every delta is useless until the next keyframe.
+    bool drop = _dropping && !slot.keyframe;
+    if (!drop)
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        drop = _messages.size() >= _maxQueued;
+    }
+    if (drop)
+    {
+        slot.fence.reset();
+        _droppedFrames.add();
+        _dropping = true;
+        _keyframe = true;
+        return;
+    }
+    _dropping = false;
+
+    // Read the count first, so only the changed tiles are copied.
+    GLuint count = 0;
+    slot.changed.bind();
+    gl_call_count += 2;
+    glGetBufferSubData(slot.changed.target, 0, sizeof(count), &count);
+    std::vector<GLuint> indices(count);
+    glGetBufferSubData(
+        slot.changed.target, sizeof(GLuint), count * sizeof(GLuint),
+        indices.data());
+    slot.changed.unbind();
+
+    Message message{std::string{}, slot.keyframe, count};
+    slot.header.tileCount = count;
+    message.bytes.append((char const *)&slot.header, sizeof(slot.header));
+    if (count != 0)
+    {
+        slot.data.bind();
+        ++gl_call_count;
+        auto const *const data = (char const *)glMapBufferRange(
+            slot.data.target, 0, (size_t)count * DELTA_TILE_BYTES,
+            GL_MAP_READ_BIT);
+        if (data == nullptr)
+        {
+            slot.data.unbind();
+            throw std::runtime_error{"DeltaStreamer - failed to map tiles"};
+        }
+        message.bytes.reserve(
+            message.bytes.size()
+            + count * (sizeof(GLuint) + DELTA_TILE_BYTES));
+        for (GLuint i = 0; i < count; ++i)
+        {
+            message.bytes.append((char const *)&indices[i], sizeof(GLuint));
+            message.bytes.append(
+                data + (size_t)i * DELTA_TILE_BYTES, DELTA_TILE_BYTES);
+        }
+        ++gl_call_count;
+        glUnmapBuffer(slot.data.target);
+        slot.data.unbind();
+    }
+    slot.fence.reset();
+
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _messages.push_back(std::move(message));
+    }
+    _wake.notify_one();
+}
+
+void DeltaStreamer::_run()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    for (;;)
+    {
+        _wake.wait(lock, [this](){ return _stop || !_messages.empty(); });
+        if (_stop)
+        {
+            return;
+        }
+        Message const message = std::move(_messages.front());
+        _messages.pop_front();
+        // Newcomers start from a whole image.
+        if (message.keyframe)
+        {
+            _clients.insert(_clients.end(), _joining.begin(), _joining.end());
+            _joining.clear();
+        }
+        lock.unlock();
+
+        // Drop viewers that went away.
+        for (auto it = _clients.begin(); it != _clients.end();)
+        {
+            try
+            {
+                it->sendAll(message.bytes);
+                _sentBytes.add(message.bytes.size());
+                ++it;
+            }
+            catch (std::runtime_error const &e)
+            {
+                std::clog << "Delta viewer disconnected: " << e.what()
+                    << "\n";
+                it = _clients.erase(it);
+            }
+        }
+        _sentTiles.add(message.tiles);
+
+        lock.lock();
+        _viewers = _clients.size();
+    }
+}
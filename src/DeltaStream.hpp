@@ -0,0 +1,127 @@
+/**
+ * DeltaStream.hpp - Streams the tiles of each frame that changed.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DELTASTREAM_HPP
+#define _DELTASTREAM_HPP
+
+#include "glUtil.hpp"
+#include "DeltaProtocol.hpp"
+#include "Metrics.hpp"
+#include "Socket.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Sends frames to viewers over a Unix domain socket, as only the 16x16 tiles
+ * that changed since the last frame (see DeltaProtocol.hpp). Tiles are
+ * hashed, compared and compacted on the GPU, and read back through a ring
+ * of fenced buffers, so the CPU only ever touches changed tiles.
+ * Frames are sent on a background thread through a bounded queue; when a
+ * slow viewer lets it fill up, frames are dropped and the next one is sent
+ * whole, so rendering never waits on the socket.
+ */
+class DeltaStreamer
+{
+private:
+    /** A frame being read back. */
+    struct Slot
+    {
+        Buffer changed;
+        Buffer data;
+        size_t tiles;
+        std::unique_ptr<Fence> fence;
+        DeltaFrameHeader header;
+        bool keyframe;
+    };
+    /** A frame waiting to be sent. */
+    struct Message
+    {
+        std::string bytes;
+        bool keyframe;
+        uint32_t tiles;
+    };
+
+    Program const _delta;
+    Buffer _hashes;
+    Socket const _listener;
+    std::vector<Slot> _slots;
+    size_t _tail;
+    size_t _pending;
+    GLuint _width, _height;
+    bool _keyframe;
+    unsigned _frame;
+    bool _dropping;
+    Counter &_sentBytes;
+    Counter &_sentTiles;
+    Counter &_droppedFrames;
+
+    /** Only touched by the writer thread. */
+    std::vector<Socket> _clients;
+    size_t const _maxQueued;
+    std::deque<Message> _messages;
+    /** Viewers waiting for a keyframe before joining _clients. */
+    std::vector<Socket> _joining;
+    size_t _viewers;
+    bool _stop;
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::thread _thread;
+
+    /** Accept any pending viewers. */
+    void _accept();
+    /** Queue the oldest frame in flight, or drop it if the queue is full. */
+    void _send(bool wait);
+    /** Writer thread: send queued frames to every viewer. */
+    void _run();
+public:
+    /**
+     * path - Unix domain socket to listen on.
+     * depth - Number of frames that can be in flight at once.
+     * max_queued - Frames that can wait to be sent before frames are
+     *              dropped.
+     */
+    DeltaStreamer(
+        std::string const &path, size_t depth=3, size_t max_queued=4);
+    /** Stops the writer thread, dropping frames it hasn't sent. */
+    ~DeltaStreamer();
+
+    DeltaStreamer(DeltaStreamer const &) = delete;
+    DeltaStreamer &operator=(DeltaStreamer const &) = delete;
+
+    /** Number of connected viewers. */
+    size_t viewers() const;
+
+    /**
+     * Find and read back the changed tiles of an RGBA32F texture. Does
+     * nothing if no viewers are connected.
+     */
+    void submit(Texture const &texture, GLuint width, GLuint height);
+
+    /** Send finished frames, without blocking on the GPU. */
+    void pump();
+};
+
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * DeltaViewer.cpp - Reference viewer for tile-delta frame streams.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "DeltaProtocol.hpp"
+#include "Socket.hpp"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+
+/**
+ * Connects to a renderer's --delta-socket, and shows the stream by pasting
+ * each received tile into a copy of the image.
+ */
+int run(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " SOCKET\n";
+        return EXIT_FAILURE;
+    }
+    Socket const stream = Socket::connectUnix(argv[1]);
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+    {
+        throw std::runtime_error{SDL_GetError()};
+    }
+    SDL_Window *window = nullptr;
+    SDL_Renderer *renderer = nullptr;
+    SDL_Texture *texture = nullptr;
+    uint32_t width = 0, height = 0;
+    std::vector<unsigned char> image{};
+    std::vector<unsigned char> tile(DELTA_TILE_BYTES);
+    uint64_t frames = 0, tiles = 0, bytes = 0;
+    uint32_t last_report = SDL_GetTicks();
+
+    for (bool running = true; running;)
+    {
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_QUIT)
+            {
+                running = false;
+            }
+        }
+        if (!stream.waitReadable(0.01))
+        {
+            continue;
+        }
+
+        DeltaFrameHeader header{};
+        if (!stream.recvAll(&header, sizeof(header)))
+        {
+            std::cerr << "Stream closed\n";
+            break;
+        }
+        if (std::memcmp(header.magic, "RTDF", 4) != 0)
+        {
+            throw std::runtime_error{"not a tile-delta stream"};
+        }
+        if (header.width != width || header.height != height)
+        {
+            width = header.width;
+            height = header.height;
+            image.assign((size_t)width * height * 3, 0);
+            if (window == nullptr)
+            {
+                window = SDL_CreateWindow(
+                    "compute viewer", SDL_WINDOWPOS_UNDEFINED,
+                    SDL_WINDOWPOS_UNDEFINED, width, height, 0);
+                renderer = SDL_CreateRenderer(window, -1, 0);
+                if (window == nullptr || renderer == nullptr)
+                {
+                    throw std::runtime_error{SDL_GetError()};
+                }
+            }
+            SDL_SetWindowSize(window, width, height);
+            if (texture != nullptr)
+            {
+                SDL_DestroyTexture(texture);
+            }
+            texture = SDL_CreateTexture(
+                renderer, SDL_PIXELFORMAT_RGB24,
+                SDL_TEXTUREACCESS_STREAMING, width, height);
+        }
+
+        // Paste the tiles, clipping the padding at the edges.
+        uint32_t const across = (width + DELTA_TILE - 1) / DELTA_TILE;
+        for (uint32_t i = 0; i < header.tileCount; ++i)
+        {
+            uint32_t index = 0;
+            if (!stream.recvAll(&index, sizeof(index))
+                || !stream.recvAll(tile.data(), tile.size()))
+            {
+                throw std::runtime_error{"stream ended mid-frame"};
+            }
+            uint32_t const x0 = (index % across) * DELTA_TILE;
+            uint32_t const y0 = (index / across) * DELTA_TILE;
+            uint32_t const w = std::min(DELTA_TILE, width - x0);
+            for (uint32_t y = 0; y < DELTA_TILE && y0 + y < height; ++y)
+            {
+                std::memcpy(
+                    &image[((size_t)(y0 + y) * width + x0) * 3],
+                    &tile[(size_t)y * DELTA_TILE * 3], (size_t)w * 3);
+            }
+        }
+        ++frames;
+        tiles += header.tileCount;
+        bytes += sizeof(header) + header.tileCount * (4 + DELTA_TILE_BYTES);
+
+        SDL_UpdateTexture(texture, nullptr, image.data(), (int)width * 3);
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+
+        uint32_t const now = SDL_GetTicks();
+        if (now - last_report >= 1000)
+        {
+            double const seconds = (now - last_report) / 1000.0;
+            std::cout << frames / seconds << " fps, "
+                << (double)tiles / std::max<uint64_t>(frames, 1)
+                << " tiles/frame, " << bytes / seconds / 1024.0
+                << " KiB/s\n";
+            frames = tiles = bytes = 0;
+            last_report = now;
+        }
+    }
+
+    if (texture != nullptr)
+    {
+        SDL_DestroyTexture(texture);
+    }
+    if (renderer != nullptr)
+    {
+        SDL_DestroyRenderer(renderer);
+    }
+    if (window != nullptr)
+    {
+        SDL_DestroyWindow(window);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/** Program entry point. */
+int main(int argc, char *argv[])
+{
+    int r = EXIT_FAILURE;
+    try
+    {
+        r = run(argc, argv);
+    }
+    catch (std::exception const &e)
+    {
+        std::cerr << e.what() << "\n";
+    }
+    SDL_Quit();
+    return r;
+}
@@ -0,0 +1,158 @@
+/**
+ * FarmProtocol.hpp - Messages between tile farm coordinators and workers.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FARMPROTOCOL_HPP
+#define _FARMPROTOCOL_HPP
+
+#include <cstdint>
+
+
+/**
+ * Sent by every worker (farm, sort-last and frame pool) as soon as it
+ * connects, so the coordinator can tell which process is on the socket.
+ *  magic - "RTFH".
+ *  pid - The worker's process id.
+ */
+struct FarmHello
+{
+    char magic[4];
+    uint32_t pid;
+};
+
+/**
+ * Sent by the coordinator for each tile. Everything is little-endian.
+ *  magic - "RTFT".
+ *  frame, tile - Frame and tile numbers, echoed back in the result.
+ *  x, y - Tile's bottom left corner in the full image, counting from its
+ *         bottom left.
+ *  fullWidth, fullHeight - Full image size.
+ *  camera - Eye position, forward and up vectors, then the horizontal field
+ *           of view in radians.
+ *
+ * Tiles are the size given by the worker's --tile-size.
+ */
+struct FarmTileRequest
+{
+    char magic[4];
+    uint32_t frame, tile;
+    int32_t x, y;
+    uint32_t fullWidth, fullHeight;
+    float camera[10];
+};
+
+/**
+ * Sent by a worker for each finished tile, followed by `bytes` of 8-bit
+ * RGB, top row first.
+ *  magic - "RTFR".
+ *  frame, tile - From the request.
+ *  milliseconds - Time the worker spent rendering and reading the tile.
+ *  bytes - Size of the pixel data.
+ */
+struct FarmTileResult
+{
+    char magic[4];
+    uint32_t frame, tile;
+    float milliseconds;
+    uint32_t bytes;
+};
+
+
+/* ===[ Sort-Last ]=== */
+
+/**
+ * Sent by the coordinator to each sort-last worker once, followed by
+ * `sphereCount` Spheres, `materialCount` Materials and `lightCount`
+ * OmniLights, as laid out in ShaderStructs.hpp.
+ *  magic - "RTFS".
+ *  rank - The worker's number. Its peers listen on the coordinator's
+ *         socket path followed by "." and their rank.
+ *  workers - Number of workers, a power of two.
+ *  width, height - Image size.
+ *  samples - Rays per pixel.
+ *  ambientColor, blankColor - Renderer colors.
+ */
+struct FarmSceneHeader
+{
+    char magic[4];
+    uint32_t rank, workers;
+    uint32_t width, height;
+    uint32_t samples;
+    uint32_t sphereCount, materialCount, lightCount;
+    float ambientColor[3];
+    float blankColor[3];
+};
+
+/**
+ * Sent by the coordinator to every sort-last worker for each frame.
+ *  magic - "RTFF".
+ *  frame - Frame number.
+ *  camera - As in FarmTileRequest.
+ */
+struct FarmFrameRequest
+{
+    char magic[4];
+    uint32_t frame;
+    float camera[10];
+};
+
+/**
+ * Sent by each sort-last worker for each frame once compositing is done,
+ * followed by `count` pixels of RGBA floats. Pixels are numbered row by
+ * row from the bottom left; alpha is the composited depth.
+ *  magic - "RTFC".
+ *  frame - Frame number.
+ *  begin, count - The pixels the worker composited.
+ */
+struct FarmRegion
+{
+    char magic[4];
+    uint32_t frame;
+    uint32_t begin, count;
+};
+
+
+/* ===[ Frame Pool ]=== */
+
+/**
+ * Sent by the coordinator to assign a range of frames to a frame pool
+ * worker, followed by `count` cameras, packed as in FarmTileRequest.
+ *  magic - "RTFP".
+ *  first, count - Frame numbers first to first + count - 1.
+ */
+struct FarmFrameRange
+{
+    char magic[4];
+    uint32_t first, count;
+};
+
+/**
+ * Sent by a frame pool worker once every frame of a range is rendered and
+ * queued to be written.
+ *  magic - "RTFD".
+ *  first, count - From the range.
+ *  milliseconds - Time the worker spent on the range.
+ */
+struct FarmRangeDone
+{
+    char magic[4];
+    uint32_t first, count;
+    float milliseconds;
+};
+
+
+#endif
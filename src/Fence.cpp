@@ -0,0 +1,63 @@
+/**
+ * Fence.cpp - OpenGL fence sync object.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "glUtil.hpp"
+
+#include <GL/glew.h>
+
+
+void _fence_delete(GLsync *fence)
+{
+    glDeleteSync(*fence);
+    delete fence;
+}
+
+
+Fence::Fence()
+:   _sync{new GLsync{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)},
+        _fence_delete}
+{
+    ++gl_call_count;
+}
+
+bool Fence::signaled() const
+{
+    ++gl_call_count;
+    GLenum const status = glClientWaitSync(*_sync, 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+void Fence::wait() const
+{
+    // Flush the first time, so the fence is guaranteed to reach the GPU.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;)
+    {
+        ++gl_call_count;
+        GLenum const status = glClientWaitSync(*_sync, flags, 1000000000);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+        {
+            return;
+        }
+        if (status == GL_WAIT_FAILED)
+        {
+            throw std::runtime_error{"glClientWaitSync failed"};
+        }
+        flags = 0;
+    }
+}
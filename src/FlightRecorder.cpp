@@ -0,0 +1,234 @@
+/**
+ * FlightRecorder.cpp - Always-on frame event recorder for catching hitches.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FlightRecorder.hpp"
+
+#include <SDL.h>
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+
+/** Get a readable name for an SDL event type. */
+static std::string sdl_event_name(uint32_t type)
+{
+    switch (type)
+    {
+    case SDL_QUIT: return "SDL_QUIT";
+    case SDL_WINDOWEVENT: return "SDL_WINDOWEVENT";
+    case SDL_KEYDOWN: return "SDL_KEYDOWN";
+    case SDL_KEYUP: return "SDL_KEYUP";
+    case SDL_MOUSEMOTION: return "SDL_MOUSEMOTION";
+    case SDL_MOUSEBUTTONDOWN: return "SDL_MOUSEBUTTONDOWN";
+    case SDL_MOUSEBUTTONUP: return "SDL_MOUSEBUTTONUP";
+    case SDL_MOUSEWHEEL: return "SDL_MOUSEWHEEL";
+    default:
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "SDL event 0x%x", type);
+        return buf;
+    }
+}
+
+
+/** Write the events to `path` in the Chrome trace event format. */
+static void write_chrome_trace(
+    std::string const &path, std::vector<FlightRecorder::Event> const &events)
+{
+    std::ofstream out{path.c_str()};
+    if (!out)
+    {
+        std::cerr << "FlightRecorder - failed to open '" << path << "'\n";
+        return;
+    }
+    // One track each for frames, CPU zones, GPU passes and input.
+    static int const tids[] = {1, 2, 3, 0, 4};
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+            "\"args\":{\"name\":\"Frames\"}},\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+            "\"args\":{\"name\":\"CPU\"}},\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,"
+            "\"args\":{\"name\":\"GPU (start approximate)\"}},\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":4,"
+            "\"args\":{\"name\":\"Input\"}}";
+    char buf[256];
+    for (auto const &e : events)
+    {
+        double const ts = e.start / 1000.0;
+        double const dur = e.duration / 1000.0;
+        switch (e.kind)
+        {
+        case FlightRecorder::FRAME:
+        case FlightRecorder::CPU_ZONE:
+        case FlightRecorder::GPU_PASS:
+            std::snprintf(
+                buf, sizeof(buf),
+                ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                e.name, tids[e.kind], ts, dur);
+            break;
+        case FlightRecorder::COUNTER:
+            std::snprintf(
+                buf, sizeof(buf),
+                ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,"
+                "\"args\":{\"value\":%lld}}",
+                e.name, ts, (long long)e.value);
+            break;
+        case FlightRecorder::INPUT:
+            std::snprintf(
+                buf, sizeof(buf),
+                ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+                "\"tid\":%d,\"ts\":%.3f}",
+                sdl_event_name((uint32_t)e.value).c_str(), tids[e.kind], ts);
+            break;
+        }
+        out << buf;
+    }
+    out << "\n]}\n";
+}
+
+
+/* ===[ FlightRecorder::Zone ]=== */
+
+FlightRecorder::Zone::Zone(FlightRecorder &recorder, char const *name)
+:   _recorder{recorder}
+,   _name{name}
+,   _start{recorder.now()}
+{
+}
+
+FlightRecorder::Zone::~Zone()
+{
+    _recorder.zone(_name, _start, _recorder.now());
+}
+
+
+/* ===[ FlightRecorder ]=== */
+
+FlightRecorder::FlightRecorder(size_t capacity)
+:   _epoch{std::chrono::steady_clock::now()}
+,   _events(capacity)
+,   _next{0}
+,   _size{0}
+,   _frameStart{0}
+,   _frames{0}
+,   _lastDump{0}
+,   _writer{}
+,   threshold{100.0}
+,   window{5.0}
+,   cooldown{10.0}
+,   warmupFrames{30}
+,   directory{"."}
+{
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    if (_writer.joinable())
+    {
+        _writer.join();
+    }
+}
+
+void FlightRecorder::_push(Event const &event)
+{
+    _events[_next] = event;
+    _next = (_next + 1) % _events.size();
+    if (_size < _events.size())
+    {
+        ++_size;
+    }
+}
+
+int64_t FlightRecorder::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - _epoch).count();
+}
+
+void FlightRecorder::zone(char const *name, int64_t start, int64_t end)
+{
+    _push({CPU_ZONE, name, start, end - start, 0});
+}
+
+void FlightRecorder::gpuPass(char const *name, double ms)
+{
+    _push({GPU_PASS, name, _frameStart, (int64_t)(ms * 1.0e6), 0});
+}
+
+void FlightRecorder::counter(char const *name, int64_t value)
+{
+    _push({COUNTER, name, now(), 0, value});
+}
+
+void FlightRecorder::input(uint32_t type)
+{
+    _push({INPUT, "input", now(), 0, (int64_t)type});
+}
+
+std::string FlightRecorder::endFrame()
+{
+    int64_t const end = now();
+    int64_t const duration = end - _frameStart;
+    _push({FRAME, "frame", _frameStart, duration, (int64_t)_frames});
+    _frameStart = end;
+    ++_frames;
+
+    bool const hitch = (
+        threshold > 0.0
+        && _frames > warmupFrames
+        && duration > (int64_t)(threshold * 1.0e6)
+        && (_lastDump == 0 || end - _lastDump > (int64_t)(cooldown * 1.0e9)));
+    if (!hitch)
+    {
+        return "";
+    }
+    _lastDump = end;
+    char name[64];
+    std::snprintf(
+        name, sizeof(name), "/hitch-%lld-frame%llu.json",
+        (long long)std::time(nullptr), (unsigned long long)_frames);
+    std::string const path = directory + name;
+    dump(path);
+    return path;
+}
+
+void FlightRecorder::dump(std::string const &path)
+{
+    // Copy the window out of the ring so recording can carry on while the
+    // file is written.
+    int64_t const since = now() - (int64_t)(window * 1.0e9);
+    std::vector<Event> events{};
+    events.reserve(_size);
+    size_t const first = (_next + _events.size() - _size) % _events.size();
+    for (size_t i = 0; i < _size; ++i)
+    {
+        Event const &e = _events[(first + i) % _events.size()];
+        if (e.start + e.duration >= since)
+        {
+            events.push_back(e);
+        }
+    }
+    if (_writer.joinable())
+    {
+        _writer.join();
+    }
+    _writer = std::thread{write_chrome_trace, path, std::move(events)};
+}
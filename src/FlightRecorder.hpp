@@ -0,0 +1,127 @@
+/**
+ * FlightRecorder.hpp - Always-on frame event recorder for catching hitches.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIGHT_RECORDER_HPP
+#define _FLIGHT_RECORDER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Keeps the most recent CPU zones, GPU pass timings, counters and input
+ * events in a fixed-size ring buffer. When a frame takes longer than
+ * `threshold`, the last `window` seconds are written to a Chrome trace file
+ * (viewable in chrome://tracing or Perfetto) on a background thread.
+ *
+ * Recording never allocates, so it's cheap enough to leave on. Names must be
+ * string literals, since only the pointer is stored.
+ */
+class FlightRecorder
+{
+public:
+    enum Kind
+    {
+        FRAME,      // A whole frame.
+        CPU_ZONE,   // A span of CPU work.
+        GPU_PASS,   // A GPU pass duration. (Start is approximate)
+        COUNTER,    // A sampled value, like GL calls per frame.
+        INPUT,      // An SDL event; `value` is its type.
+    };
+
+    /**
+     * A recorded event. Times are nanoseconds since the recorder was created.
+     */
+    struct Event
+    {
+        Kind kind;
+        char const *name;
+        int64_t start;
+        int64_t duration;
+        int64_t value;
+    };
+
+    /** Records the lifetime of a scope as a CPU zone. */
+    class Zone
+    {
+    private:
+        FlightRecorder &_recorder;
+        char const *const _name;
+        int64_t const _start;
+    public:
+        Zone(FlightRecorder &recorder, char const *name);
+        ~Zone();
+    };
+
+private:
+    std::chrono::steady_clock::time_point const _epoch;
+    std::vector<Event> _events;
+    size_t _next;
+    size_t _size;
+    int64_t _frameStart;
+    uint64_t _frames;
+    int64_t _lastDump;
+    std::thread _writer;
+
+    void _push(Event const &event);
+public:
+    /** Frame time (ms) that triggers a dump. (0 to disable dumping) */
+    double threshold;
+    /** Seconds of history to include in a dump. */
+    double window;
+    /** Minimum seconds between dumps, so a slow patch doesn't spam files. */
+    double cooldown;
+    /** Frames to ignore at startup, while shaders compile and caches warm. */
+    uint64_t warmupFrames;
+    /** Directory to write dumps to. */
+    std::string directory;
+
+    /** capacity - Number of events to keep. */
+    explicit FlightRecorder(size_t capacity=1 << 16);
+    ~FlightRecorder();
+
+    FlightRecorder(FlightRecorder const &) = delete;
+    FlightRecorder &operator=(FlightRecorder const &) = delete;
+
+    /** Current time, in the recorder's timebase. */
+    int64_t now() const;
+
+    /** Record a span of CPU work. */
+    void zone(char const *name, int64_t start, int64_t end);
+    /** Record a GPU pass duration, placed at the start of the frame. */
+    void gpuPass(char const *name, double ms);
+    /** Record a counter sample. */
+    void counter(char const *name, int64_t value);
+    /** Record an input event. */
+    void input(uint32_t type);
+
+    /**
+     * Mark the end of a frame. If the frame exceeded the threshold, dump the
+     * recent history and return the path written to, otherwise return "".
+     */
+    std::string endFrame();
+
+    /** Write the last `window` seconds to a Chrome trace file. */
+    void dump(std::string const &path);
+};
+
+
+#endif
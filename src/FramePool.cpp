@@ -0,0 +1,273 @@
+/**
+ * FramePool.cpp - Frame-parallel rendering over worker processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FramePool.hpp"
+#include "App.hpp"
+#include "Batch.hpp"
+#include "FarmProtocol.hpp"
+#include "FrameReader.hpp"
+#include "ImageWriter.hpp"
+#include "Scenes.hpp"
+#include "TileFarm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+/** Frame ranges kept queued at each worker, hiding the round trip. */
+static unsigned const POOL_DEPTH = 2;
+
+
+int run_frame_pool(Options const &options)
+{
+    if (!options.streamPath.empty() || !options.shmName.empty())
+    {
+        throw std::runtime_error{
+            "--frame-pool writes image files, not --stream or --shm"};
+    }
+    // Fail on a bad extension here rather than in every worker.
+    image_format_from_path(options.outputPattern);
+    std::string const scene = options.scenes.empty()?
+        "demo" : options.scenes.front();
+    SceneSetup const setup = builtin_scene(scene);
+    std::unique_ptr<CameraPath> path{};
+    unsigned frames = options.frames;
+    if (!options.cameraPath.empty())
+    {
+        path.reset(new CameraPath{options.cameraPath});
+        if (frames == 0)
+        {
+            frames = (unsigned)path->size();
+        }
+    }
+    frames = std::max(frames, 1u);
+    std::vector<Camera> cameras(frames, setup.camera);
+    if (path)
+    {
+        for (unsigned frame = 0; frame < frames; ++frame)
+        {
+            cameras[frame] = path->at(path->frameTime(frame, frames));
+        }
+    }
+
+    // Workers encode their own images, so share the cores between them.
+    unsigned const count = options.framePoolWorkers;
+    unsigned const writer_threads = options.writerThreads != 0?
+        options.writerThreads
+        : std::max(1u, std::thread::hardware_concurrency() / count);
+    std::string socket_path{};
+    std::vector<FarmWorker> workers = start_farm_workers(
+        options.program,
+        {   "--scene", scene,
+            "--samples", std::to_string(options.samples),
+            "--size",
+                std::to_string(options.width) + "x"
+                + std::to_string(options.height),
+            "--output", options.outputPattern,
+            "--writer-threads", std::to_string(writer_threads)},
+        "--frame-pool-worker", count, socket_path);
+
+    // One thread per worker pulls ranges from a shared counter, so a worker
+    // stuck on slow frames just takes fewer of them.
+    unsigned const chunk = options.framePoolChunk;
+    unsigned const ranges = (frames + chunk - 1) / chunk;
+    std::atomic<unsigned> next{0};
+    std::atomic<unsigned> finished{0};
+    std::mutex progress_lock{};
+    std::vector<std::exception_ptr> errors(workers.size());
+    std::vector<std::thread> threads{};
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t w = 0; w < workers.size(); ++w)
+    {
+        threads.emplace_back([&, w](){
+            FarmWorker &worker = workers[w];
+            try
+            {
+                auto const send_next = [&](){
+                    unsigned const range = next++;
+                    if (range >= ranges)
+                    {
+                        return false;
+                    }
+                    FarmFrameRange request{};
+                    std::memcpy(request.magic, "RTFP", 4);
+                    request.first = range * chunk;
+                    request.count = std::min(chunk, frames - request.first);
+                    std::vector<float> packed(request.count * 10);
+                    for (uint32_t i = 0; i < request.count; ++i)
+                    {
+                        pack_camera(
+                            cameras[request.first + i], &packed[i * 10]);
+                    }
+                    worker.socket.sendAll(&request, sizeof(request));
+                    worker.socket.sendAll(
+                        packed.data(), packed.size() * sizeof(float));
+                    return true;
+                };
+                unsigned pending = 0;
+                while (pending < POOL_DEPTH && send_next())
+                {
+                    ++pending;
+                }
+                for (; pending > 0; --pending)
+                {
+                    FarmRangeDone done{};
+                    if (!worker.socket.recvAll(&done, sizeof(done))
+                        || std::memcmp(done.magic, "RTFD", 4) != 0)
+                    {
+                        throw std::runtime_error{
+                            "frame pool worker " + std::to_string(w)
+                            + " failed"};
+                    }
+                    worker.frames += done.count;
+                    worker.busy += done.milliseconds;
+                    unsigned const total = finished += done.count;
+                    {
+                        std::lock_guard<std::mutex> lock{progress_lock};
+                        std::clog << "\rFrame " << total << "/" << frames
+                            << std::flush;
+                    }
+                    if (send_next())
+                    {
+                        ++pending;
+                    }
+                }
+            }
+            catch (...)
+            {
+                errors[w] = std::current_exception();
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    for (auto const &error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Closing the connections tells the workers to finish writing and exit.
+    for (size_t w = 0; w < workers.size(); ++w)
+    {
+        workers[w].socket = Socket{};
+        if (workers[w].process.wait() != 0)
+        {
+            throw std::runtime_error{
+                "frame pool worker " + std::to_string(w)
+                + " failed writing its frames"};
+        }
+    }
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::clog << "\n";
+
+    std::cout << frames << " frames on " << workers.size() << " workers in "
+        << seconds << " s: " << frames / seconds << " fps\n";
+    for (size_t w = 0; w < workers.size(); ++w)
+    {
+        std::cout << "  worker " << w << ": " << workers[w].frames
+            << " frames, busy " << workers[w].busy / 1000.0 << " s\n";
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int run_frame_pool_worker(Options const &options)
+{
+    Socket const socket = connect_farm_worker(
+        options.framePoolWorkerSocket);
+    ImageFormat const format = image_format_from_path(options.outputPattern);
+    PixelLayout const layout = image_format_layout(format);
+
+    init_SDL();
+    App app{
+        "compute frame pool worker", (int)options.width, (int)options.height,
+        false};
+    app.setVSync(false);
+
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    ComputeRaytraceRenderer renderer{
+        setup.scene, options.width, options.height};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+
+    // As in run_batch(), each frame is read back while the next renders.
+    FrameReader reader{};
+    ImageWriter writer{options.writerThreads};
+    FrameReader::Frame done{};
+    auto const hand_off = [&](){
+        unsigned const tag = done.tag;
+        writer.write(
+            frame_path(options.outputPattern, tag), format, std::move(done));
+    };
+    FarmFrameRange request{};
+    std::vector<float> packed{};
+    while (socket.recvAll(&request, sizeof(request)))
+    {
+        packed.resize(request.count * 10);
+        if (std::memcmp(request.magic, "RTFP", 4) != 0
+            || !socket.recvAll(packed.data(), packed.size() * sizeof(float)))
+        {
+            throw std::runtime_error{"frame pool worker - bad frame range"};
+        }
+        auto const start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < request.count; ++i)
+        {
+            renderer.setCamera(unpack_camera(&packed[i * 10]));
+            renderer.render();
+            if (reader.full() && reader.collect(done, true))
+            {
+                hand_off();
+            }
+            reader.read(
+                renderer.getResult(), options.width, options.height, layout,
+                request.first + i);
+            while (reader.collect(done))
+            {
+                hand_off();
+            }
+        }
+        while (reader.collect(done, true))
+        {
+            hand_off();
+        }
+
+        FarmRangeDone result{};
+        std::memcpy(result.magic, "RTFD", 4);
+        result.first = request.first;
+        result.count = request.count;
+        result.milliseconds = std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        socket.sendAll(&result, sizeof(result));
+    }
+    writer.finish();
+    return EXIT_SUCCESS;
+}
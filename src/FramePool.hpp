@@ -0,0 +1,42 @@
+/**
+ * FramePool.hpp - Frame-parallel rendering over worker processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FRAMEPOOL_HPP
+#define _FRAMEPOOL_HPP
+
+#include "Options.hpp"
+
+
+/**
+ * Render `options.frames` frames along `options.cameraPath` like
+ * run_batch(), but across `options.framePoolWorkers` worker processes.
+ * Each worker loads the scene once, then is handed ranges of
+ * `options.framePoolChunk` frames as it finishes earlier ones, and writes
+ * them as images named by `options.outputPattern` itself.
+ */
+int run_frame_pool(Options const &options);
+
+/**
+ * Worker side of run_frame_pool(): render and write frame ranges requested
+ * over the Unix socket `options.framePoolWorkerSocket` until it's closed.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_frame_pool_worker(Options const &options);
+
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * FrameReader.cpp - Asynchronous render result readback.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FrameReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+/** Storage block binding of convert.comp's output. */
+static GLuint const OUTPUT_BINDING = 4;
+/** Image unit the converted texture is bound to. */
+static GLint const SOURCE_UNIT = 1;
+/** Work groups along X per row of groups. */
+static GLuint const GROUPS_X = 1024;
+
+
+size_t pixel_layout_bytes(PixelLayout layout, unsigned width, unsigned height)
+{
+    size_t const channels = (size_t)width * height * 3;
+    switch (layout)
+    {
+    case PIXELS_RGB8:
+        return channels;
+    case PIXELS_HALF_BGR_PLANAR:
+        return channels * 2;
+    case PIXELS_YUV420:
+        return (
+            (size_t)width * height
+            + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2));
+    case PIXELS_BC7:
+    case PIXELS_BC6H:
+        // 16 bytes per 4x4 block, with partial blocks at the edges.
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+    }
+    throw std::runtime_error{"pixel_layout_bytes - bad layout"};
+}
+
+
+FrameReader::FrameReader(size_t depth)
+:   _convert{
+        {shader_from_file("shaders/convert.comp", GL_COMPUTE_SHADER)},
+        "FrameConvert"}
+,   _bc7{}
+,   _bc6h{}
+,   _slots{}
+,   _tail{0}
+,   _pending{0}
+{
+    for (size_t i = 0; i < std::max<size_t>(depth, 1); ++i)
+    {
+        _slots.push_back(Slot{
+            Buffer{GL_SHADER_STORAGE_BUFFER, "FrameReadback"}, 0, nullptr,
+            Frame{}});
+    }
+}
+
+size_t FrameReader::pending() const
+{
+    return _pending;
+}
+
+bool FrameReader::full() const
+{
+    return _pending == _slots.size();
+}
+
+void FrameReader::read(
+    Texture const &texture, unsigned width, unsigned height,
+    PixelLayout layout, unsigned tag)
+{
+    if (full())
+    {
+        throw std::runtime_error{"FrameReader::read - ring is full"};
+    }
+    Slot &slot = _slots[(_tail + _pending) % _slots.size()];
+    size_t const bytes = pixel_layout_bytes(layout, width, height);
+    GLuint const words = (GLuint)((bytes + 3) / 4);
+
+    // Buffers only ever grow, so resizing doesn't reallocate every frame.
+    slot.buffer.bind();
+    if (slot.capacity < words * 4)
+    {
+        slot.capacity = words * 4;
+        ++gl_call_count;
+        glBufferData(
+            slot.buffer.target, slot.capacity, nullptr, GL_STREAM_READ);
+    }
+    ++gl_call_count;
+    glBindBufferBase(slot.buffer.target, OUTPUT_BINDING, slot.buffer.id());
+    slot.buffer.unbind();
+
+    // Uncompressed layouts take an invocation per output word, and block
+    // compressed ones an invocation per block.
+    GLuint invocations = words;
+    if (layout == PIXELS_BC7 || layout == PIXELS_BC6H)
+    {
+        std::unique_ptr<Program> &compress = (
+            layout == PIXELS_BC7? _bc7 : _bc6h);
+        if (!compress)
+        {
+            compress.reset(new Program{
+                {shader_from_file(
+                    "shaders/blockcompress.comp", GL_COMPUTE_SHADER,
+                    {layout == PIXELS_BC7? "BC7" : "BC6H"})},
+                layout == PIXELS_BC7? "FrameCompressBC7"
+                    : "FrameCompressBC6H"});
+        }
+        GLuint const blocks_x = (width + 3) / 4;
+        invocations = words / 4;
+        compress->use();
+        compress->setUniformS("source", SOURCE_UNIT);
+        compress->setUniformS("blocksX", blocks_x);
+        compress->setUniformS("blockCount", invocations);
+    }
+    else
+    {
+        _convert.use();
+        _convert.setUniformS("source", SOURCE_UNIT);
+        _convert.setUniformS("pixelLayout", (GLuint)layout);
+        _convert.setUniformS("wordCount", words);
+    }
+    ++gl_call_count;
+    glBindImageTexture(
+        SOURCE_UNIT, texture.id(), 0, GL_FALSE, 0, GL_READ_ONLY,
+        GL_RGBA32F);
+    GLuint const groups = (invocations + 63) / 64;
+    GLuint const groups_x = std::min(groups, GROUPS_X);
+    ++gl_call_count;
+    glDispatchCompute(groups_x, (groups + groups_x - 1) / groups_x, 1);
+    // Make the shader's writes visible to glMapBufferRange.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    slot.fence.reset(new Fence{});
+    // Make sure the work is submitted, so the fence can signal while the
+    // caller gets on with the next frame.
+    glFlush();
+    slot.frame.tag = tag;
+    slot.frame.width = width;
+    slot.frame.height = height;
+    slot.frame.layout = layout;
+    ++_pending;
+}
+
+bool FrameReader::collect(Frame &frame, bool wait)
+{
+    if (_pending == 0)
+    {
+        return false;
+    }
+    Slot &slot = _slots[_tail];
+    if (wait)
+    {
+        slot.fence->wait();
+    }
+    else if (!slot.fence->signaled())
+    {
+        return false;
+    }
+
+    size_t const bytes = pixel_layout_bytes(
+        slot.frame.layout, slot.frame.width, slot.frame.height);
+    frame.tag = slot.frame.tag;
+    frame.width = slot.frame.width;
+    frame.height = slot.frame.height;
+    frame.layout = slot.frame.layout;
+    frame.data.resize(bytes);
+    slot.buffer.bind();
+    gl_call_count += 2;
+    void const *const mapped = glMapBufferRange(
+        slot.buffer.target, 0, bytes, GL_MAP_READ_BIT);
+    if (mapped == nullptr)
+    {
+        slot.buffer.unbind();
+        throw std::runtime_error{"FrameReader::collect - failed to map"};
+    }
+    std::memcpy(frame.data.data(), mapped, bytes);
+    glUnmapBuffer(slot.buffer.target);
+    slot.buffer.unbind();
+
+    slot.fence.reset();
+    _tail = (_tail + 1) % _slots.size();
+    --_pending;
+    return true;
+}
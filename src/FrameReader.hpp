@@ -0,0 +1,117 @@
+/**
+ * FrameReader.hpp - Asynchronous render result readback.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FRAMEREADER_HPP
+#define _FRAMEREADER_HPP
+
+#include "glUtil.hpp"
+
+#include <memory>
+#include <vector>
+
+
+/**
+ * Pixel layouts the render result can be converted to before readback.
+ * NOTE: The uncompressed layouts must match the LAYOUT_ defines in
+ * convert.comp. Block compressed ones are made by blockcompress.comp.
+ */
+enum PixelLayout
+{
+    /** 8-bit RGB, interleaved, top row first. (PPM/PNG) */
+    PIXELS_RGB8 = 0,
+    /** Half-float B, G and R planes per row, top row first. (EXR) */
+    PIXELS_HALF_BGR_PLANAR = 1,
+    /** 8-bit Y, then half-resolution U and V planes, top row first. (Y4M) */
+    PIXELS_YUV420 = 2,
+    /** BC7 blocks of 4x4 pixels, opaque, top row first. (DDS) */
+    PIXELS_BC7 = 3,
+    /** Unsigned BC6H blocks of 4x4 pixels, top row first. (DDS) */
+    PIXELS_BC6H = 4,
+};
+
+/** Size in bytes of an image in a given layout. */
+size_t pixel_layout_bytes(PixelLayout layout, unsigned width, unsigned height);
+
+
+/**
+ * Reads rendered frames back without stalling. Each frame is converted to
+ * its file's pixel layout on the GPU into one of a ring of buffers, and a
+ * fence marks when it's safe to map. Meanwhile the next frame can render.
+ */
+class FrameReader
+{
+public:
+    /**
+     * A frame that has been read back.
+     *  tag - Caller-supplied identifier, eg. the frame number.
+     *  width, height - Image size.
+     *  layout - Pixel layout of `data`.
+     *  data - Pixel data.
+     */
+    struct Frame
+    {
+        unsigned tag;
+        unsigned width, height;
+        PixelLayout layout;
+        std::vector<unsigned char> data;
+    };
+
+private:
+    /** A buffer in the ring, and the frame being read into it. */
+    struct Slot
+    {
+        Buffer buffer;
+        size_t capacity;
+        std::unique_ptr<Fence> fence;
+        Frame frame;
+    };
+
+    Program const _convert;
+    /** Block compressors, built the first time they're needed. */
+    std::unique_ptr<Program> _bc7;
+    std::unique_ptr<Program> _bc6h;
+    std::vector<Slot> _slots;
+    size_t _tail;
+    size_t _pending;
+
+public:
+    /** depth - Number of frames that can be in flight at once. */
+    FrameReader(size_t depth=3);
+
+    /** Number of frames in flight. */
+    size_t pending() const;
+    /** Check if no more frames can be started until one is collected. */
+    bool full() const;
+
+    /**
+     * Start reading back an RGBA32F texture in the given layout.
+     * Throws if the ring is full.
+     */
+    void read(
+        Texture const &texture, unsigned width, unsigned height,
+        PixelLayout layout, unsigned tag);
+
+    /**
+     * Collect the oldest frame in flight into `frame`. Returns false if
+     * there is none, or if it's not finished and `wait` is false.
+     */
+    bool collect(Frame &frame, bool wait=false);
+};
+
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * GPUPrimitives.cpp - Parallel scan, reduction, compaction and histograms.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "GPUPrimitives.hpp"
+
+#include <algorithm>
+
+
+/** Storage block bindings of primitives.comp. */
+static GLuint const INPUT_BINDING = 10;
+static GLuint const OUTPUT_BINDING = 11;
+static GLuint const PARTITIONS_BINDING = 12;
+static GLuint const FLAGS_BINDING = 12;
+static GLuint const OFFSETS_BINDING = 13;
+static GLuint const KEPT_BINDING = 14;
+
+/** Most work groups a dispatch can have in one dimension. */
+static GLuint const MAX_GROUPS_X = 65535;
+
+
+GPUPrimitives::GPUPrimitives()
+:   _scan{
+        {shader_from_file(
+            "shaders/primitives.comp", GL_COMPUTE_SHADER, {"SCAN"})},
+        "PrimitivesScan"}
+,   _reduce{}
+,   _scatter{
+        {shader_from_file(
+            "shaders/primitives.comp", GL_COMPUTE_SHADER, {"SCATTER"})},
+        "PrimitivesScatter"}
+,   _histogram{
+        {shader_from_file(
+            "shaders/primitives.comp", GL_COMPUTE_SHADER, {"HISTOGRAM"})},
+        "PrimitivesHistogram"}
+,   _partitions{GL_SHADER_STORAGE_BUFFER, "PrimitivesPartitions"}
+,   _scratch{
+        {GL_SHADER_STORAGE_BUFFER, "PrimitivesScratch0"},
+        {GL_SHADER_STORAGE_BUFFER, "PrimitivesScratch1"}}
+,   _partitionsCapacity{0}
+,   _scratchCapacity{0, 0}
+{
+    // One variant per ReduceOp, in order.
+    for (int op : {REDUCE_ADD, REDUCE_MIN, REDUCE_MAX})
+    {
+        _reduce.push_back(Program{
+            {shader_from_file(
+                "shaders/primitives.comp", GL_COMPUTE_SHADER,
+                {"REDUCE", "REDUCE_OP " + std::to_string(op)})},
+            "PrimitivesReduce" + std::to_string(op)});
+    }
+}
+
+void GPUPrimitives::_bind(GLuint binding, Buffer const &buffer)
+{
+    ++gl_call_count;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.id());
+}
+
+void GPUPrimitives::dispatch(GLuint groups)
+{
+    GLuint const x = std::min(groups, MAX_GROUPS_X);
+    GLuint const y = (groups + x - 1) / x;
+    gl_call_count += 2;
+    glDispatchCompute(x, y, 1);
+    glMemoryBarrier(
+        GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void GPUPrimitives::_reserve(Buffer &buffer, size_t &capacity, size_t bytes)
+{
+    if (bytes <= capacity)
+    {
+        return;
+    }
+    capacity = bytes;
+    buffer.bind();
+    ++gl_call_count;
+    glBufferData(buffer.target, capacity, nullptr, GL_DYNAMIC_COPY);
+    buffer.unbind();
+}
+
+
+/* ===[ Scan ]=== */
+
+void GPUPrimitives::_scanInto(
+    Buffer const &input, Buffer const &output, GLuint count,
+    bool inclusive, bool non_zero)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    // Reset the partition counter and every partition's state.
+    GLuint const partitions = (count + PARTITION - 1) / PARTITION;
+    size_t const bytes = (1 + 3 * (size_t)partitions) * sizeof(GLuint);
+    _reserve(_partitions, _partitionsCapacity, bytes);
+    _partitions.bind();
+    ++gl_call_count;
+    glClearBufferSubData(
+        _partitions.target, GL_R32UI, 0, bytes, GL_RED_INTEGER,
+        GL_UNSIGNED_INT, nullptr);
+    _partitions.unbind();
+
+    _bind(INPUT_BINDING, input);
+    _bind(OUTPUT_BINDING, output);
+    _bind(PARTITIONS_BINDING, _partitions);
+    _scan.use();
+    _scan.setUniform("count", count);
+    _scan.setUniform("inclusive", inclusive);
+    _scan.setUniform("nonZero", non_zero);
+    dispatch(partitions);
+}
+
+void GPUPrimitives::scan(
+    Buffer const &input, Buffer const &output, GLuint count, bool inclusive)
+{
+    _scanInto(input, output, count, inclusive, false);
+}
+
+
+/* ===[ Reduce ]=== */
+
+void GPUPrimitives::reduce(
+    Buffer const &input, Buffer const &output, GLuint count, ReduceOp op)
+{
+    if (count == 0)
+    {
+        throw std::runtime_error{"GPUPrimitives::reduce - nothing to reduce"};
+    }
+    Program const &program = _reduce.at(op);
+    program.use();
+    // Each pass reduces every partition to one element, ping-ponging
+    // between the scratch buffers until one partition is left.
+    Buffer const *source = &input;
+    size_t next = 0;
+    for (;;)
+    {
+        GLuint const groups = (count + PARTITION - 1) / PARTITION;
+        Buffer const *target = &output;
+        if (groups > 1)
+        {
+            _reserve(
+                _scratch[next], _scratchCapacity[next],
+                groups * sizeof(GLuint));
+            target = &_scratch[next];
+        }
+        _bind(INPUT_BINDING, *source);
+        _bind(OUTPUT_BINDING, *target);
+        program.setUniform("count", count);
+        dispatch(groups);
+        if (groups == 1)
+        {
+            break;
+        }
+        source = target;
+        next = 1 - next;
+        count = groups;
+    }
+}
+
+
+/* ===[ Compact ]=== */
+
+void GPUPrimitives::compact(
+    Buffer const &input, Buffer const &flags, Buffer const &output,
+    Buffer const &kept, GLuint count)
+{
+    if (count == 0)
+    {
+        // The scatter pass writes the count, but won't run.
+        GLuint const zero = 0;
+        kept.bind();
+        ++gl_call_count;
+        glBufferSubData(kept.target, 0, sizeof(zero), &zero);
+        kept.unbind();
+        return;
+    }
+    // Each kept element's place is the number of kept elements before it.
+    _reserve(_scratch[0], _scratchCapacity[0], count * sizeof(GLuint));
+    _scanInto(flags, _scratch[0], count, false, true);
+
+    _bind(INPUT_BINDING, input);
+    _bind(OUTPUT_BINDING, output);
+    _bind(FLAGS_BINDING, flags);
+    _bind(OFFSETS_BINDING, _scratch[0]);
+    _bind(KEPT_BINDING, kept);
+    _scatter.use();
+    _scatter.setUniform("count", count);
+    dispatch((count + PARTITION - 1) / PARTITION);
+}
+
+
+/* ===[ Histogram ]=== */
+
+void GPUPrimitives::histogram(
+    Buffer const &input, Buffer const &output, GLuint count,
+    GLuint bins, GLuint shift)
+{
+    if (bins == 0 || bins > MAX_BINS || (bins & (bins - 1)) != 0)
+    {
+        throw std::runtime_error{
+            "GPUPrimitives::histogram - bins must be a power of two up to "
+            + std::to_string(MAX_BINS)};
+    }
+    output.bind();
+    ++gl_call_count;
+    glClearBufferSubData(
+        output.target, GL_R32UI, 0, bins * sizeof(GLuint), GL_RED_INTEGER,
+        GL_UNSIGNED_INT, nullptr);
+    output.unbind();
+    if (count == 0)
+    {
+        return;
+    }
+    _bind(INPUT_BINDING, input);
+    _bind(OUTPUT_BINDING, output);
+    _histogram.use();
+    _histogram.setUniform("count", count);
+    _histogram.setUniform("bins", bins);
+    _histogram.setUniform("shift", shift);
+    dispatch((count + PARTITION - 1) / PARTITION);
+}
@@ -0,0 +1,119 @@
+/**
+ * GPUPrimitives.hpp - Parallel scan, reduction, compaction and histograms.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GPUPRIMITIVES_HPP
+#define _GPUPRIMITIVES_HPP
+
+#include "glUtil.hpp"
+
+#include <vector>
+
+
+/**
+ * Data-parallel building blocks over shader storage buffers of GLuints,
+ * run as compute shaders (see shaders/primitives.comp). Every call only
+ * queues GPU work, followed by a barrier so later shaders and buffer reads
+ * see the results; nothing is read back unless asked for.
+ *
+ * Buffers are bound to storage block bindings 10-14, which nothing else
+ * uses, so the renderer's bindings are left alone.
+ */
+class GPUPrimitives
+{
+public:
+    /** Largest histogram, limited by shared memory. */
+    static GLuint const MAX_BINS = 4096;
+    /** Elements handled by one work group. */
+    static GLuint const PARTITION = 1024;
+
+    /** Operations reduce() can apply. */
+    enum ReduceOp
+    {
+        REDUCE_ADD,
+        REDUCE_MIN,
+        REDUCE_MAX,
+    };
+
+private:
+    Program const _scan;
+    std::vector<Program> _reduce;
+    Program const _scatter;
+    Program const _histogram;
+    /** Lookback state of scan(). */
+    Buffer _partitions;
+    /** Partial results of reduce(), and flag offsets of compact(). */
+    Buffer _scratch[2];
+    size_t _partitionsCapacity;
+    size_t _scratchCapacity[2];
+
+    /** Bind `buffer` to storage block `binding`. */
+    static void _bind(GLuint binding, Buffer const &buffer);
+    /** Make sure `buffer` holds at least `bytes`, discarding its contents. */
+    static void _reserve(Buffer &buffer, size_t &capacity, size_t bytes);
+
+    void _scanInto(
+        Buffer const &input, Buffer const &output, GLuint count,
+        bool inclusive, bool non_zero);
+public:
+    GPUPrimitives();
+
+    /**
+     * Run `groups` work groups of the current program, in two dimensions
+     * if there are more than one dimension allows, then wait for their
+     * writes. Shaders number the groups y * gl_NumWorkGroups.x + x.
+     */
+    static void dispatch(GLuint groups);
+
+    /**
+     * Prefix sum of `count` elements of `input` into `output`, with a
+     * single pass using decoupled lookback. Exclusive unless `inclusive`.
+     * Sums wrap around at 2^32.
+     */
+    void scan(
+        Buffer const &input, Buffer const &output, GLuint count,
+        bool inclusive=false);
+
+    /**
+     * Reduce `count` (at least 1) elements of `input` to one, written to
+     * the first element of `output`.
+     */
+    void reduce(
+        Buffer const &input, Buffer const &output, GLuint count,
+        ReduceOp op=REDUCE_ADD);
+
+    /**
+     * Copy the elements of `input` whose element in `flags` is non-zero to
+     * the start of `output`, keeping their order. The number copied is
+     * written to the first element of `kept`.
+     */
+    void compact(
+        Buffer const &input, Buffer const &flags, Buffer const &output,
+        Buffer const &kept, GLuint count);
+
+    /**
+     * Count `count` elements of `input` into `bins` bins (a power of two,
+     * at most MAX_BINS) of `output`, each in bin
+     * (element >> shift) & (bins - 1).
+     */
+    void histogram(
+        Buffer const &input, Buffer const &output, GLuint count,
+        GLuint bins, GLuint shift=0);
+};
+
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * GPURadixSort.cpp - Radix sort of keys and key-value pairs on the GPU.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "GPURadixSort.hpp"
+
+#include <algorithm>
+
+
+/** Storage block bindings of radixsort.comp. */
+static GLuint const KEYS_IN_BINDING = 10;
+static GLuint const KEYS_OUT_BINDING = 11;
+static GLuint const VALUES_IN_BINDING = 12;
+static GLuint const VALUES_OUT_BINDING = 13;
+static GLuint const BLOCK_DIGITS_BINDING = 14;
+
+/** Keys per invocation; must match ITEMS in radixsort.comp. */
+static GLuint const RADIX_ITEMS = 4;
+
+
+std::vector<GPURadixSort::Config> const GPURadixSort::CONFIGS{
+    {4, 128}, {4, 256}, {4, 512},
+    {6, 128}, {6, 256}, {6, 512},
+    {8, 128}, {8, 256}, {8, 512},
+};
+
+
+/** Compile a radixsort.comp variant for a configuration. */
+static Program radix_program(
+    std::string const &pass, GPURadixSort::Config const &config)
+{
+    return Program{
+        {shader_from_file(
+            "shaders/radixsort.comp", GL_COMPUTE_SHADER,
+            {   pass,
+                "DIGIT_BITS " + std::to_string(config.digitBits),
+                "GROUP_SIZE " + std::to_string(config.groupSize)})},
+        "RadixSort" + pass};
+}
+
+/** Make sure `buffer` holds at least `bytes`, discarding its contents. */
+static void reserve(Buffer &buffer, size_t &capacity, size_t bytes)
+{
+    if (bytes <= capacity)
+    {
+        return;
+    }
+    capacity = bytes;
+    buffer.bind();
+    ++gl_call_count;
+    glBufferData(buffer.target, capacity, nullptr, GL_DYNAMIC_COPY);
+    buffer.unbind();
+}
+
+/** Copy `bytes` from the start of one buffer to another. */
+static void copy_buffer(Buffer const &from, Buffer const &to, size_t bytes)
+{
+    gl_call_count += 3;
+    glBindBuffer(GL_COPY_READ_BUFFER, from.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, to.id());
+    glCopyBufferSubData(
+        GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+}
+
+
+GPURadixSort::GPURadixSort(Config config)
+:   _config{config}
+,   _count{radix_program("COUNT", config)}
+,   _scatter{radix_program("SCATTER", config)}
+,   _primitives{}
+,   _blockCounts{GL_SHADER_STORAGE_BUFFER, "RadixBlockCounts"}
+,   _blockOffsets{GL_SHADER_STORAGE_BUFFER, "RadixBlockOffsets"}
+,   _keys{GL_SHADER_STORAGE_BUFFER, "RadixKeys"}
+,   _values{GL_SHADER_STORAGE_BUFFER, "RadixValues"}
+,   _countsCapacity{0}
+,   _offsetsCapacity{0}
+,   _keysCapacity{0}
+,   _valuesCapacity{0}
+{
+    if (config.digitBits < 1 || config.digitBits > 8
+        || config.groupSize < 32 || config.groupSize > 1024
+        || (config.groupSize & (config.groupSize - 1)) != 0)
+    {
+        throw std::runtime_error{
+            "GPURadixSort - digits must be 1-8 bits, and groups a power of"
+            " two from 32 to 1024"};
+    }
+}
+
+GPURadixSort::Config GPURadixSort::config() const
+{
+    return _config;
+}
+
+void GPURadixSort::sort(
+    Buffer const &keys, GLuint count, Buffer const *values, GLuint key_bits)
+{
+    _sort(keys, values, count, false, std::min(key_bits, 32u));
+}
+
+void GPURadixSort::sort64(
+    Buffer const &keys, GLuint count, Buffer const *values, GLuint key_bits)
+{
+    _sort(keys, values, count, true, std::min(key_bits, 64u));
+}
+
+void GPURadixSort::_sort(
+    Buffer const &keys, Buffer const *values, GLuint count, bool wide,
+    GLuint key_bits)
+{
+    if (count < 2 || key_bits == 0)
+    {
+        return;
+    }
+    GLuint const radix = 1u << _config.digitBits;
+    GLuint const blocks =
+        (count + _config.groupSize * RADIX_ITEMS - 1)
+        / (_config.groupSize * RADIX_ITEMS);
+    size_t const key_bytes = (size_t)count * (wide? 8 : 4);
+    size_t const value_bytes = (size_t)count * sizeof(GLuint);
+    size_t const block_bytes = (size_t)blocks * radix * sizeof(GLuint);
+    reserve(_blockCounts, _countsCapacity, block_bytes);
+    reserve(_blockOffsets, _offsetsCapacity, block_bytes);
+    reserve(_keys, _keysCapacity, key_bytes);
+    if (values)
+    {
+        reserve(_values, _valuesCapacity, value_bytes);
+    }
+
+    // Each pass reads from one side and writes to the other.
+    Buffer const *keys_in = &keys;
+    Buffer const *keys_out = &_keys;
+    Buffer const *values_in = values? values : &keys;
+    Buffer const *values_out = values? &_values : &_keys;
+    GLuint const passes =
+        (key_bits + _config.digitBits - 1) / _config.digitBits;
+    for (GLuint pass = 0; pass < passes; ++pass)
+    {
+        GLuint const shift = pass * _config.digitBits;
+        gl_call_count += 2;
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, KEYS_IN_BINDING, keys_in->id());
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, BLOCK_DIGITS_BINDING,
+            _blockCounts.id());
+        _count.use();
+        _count.setUniform("count", count);
+        _count.setUniform("blocks", blocks);
+        _count.setUniform("shift", shift);
+        _count.setUniform("wide", wide);
+        GPUPrimitives::dispatch(blocks);
+
+        _primitives.scan(_blockCounts, _blockOffsets, blocks * radix);
+
+        gl_call_count += 5;
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, KEYS_IN_BINDING, keys_in->id());
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, KEYS_OUT_BINDING, keys_out->id());
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, VALUES_IN_BINDING, values_in->id());
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, VALUES_OUT_BINDING, values_out->id());
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, BLOCK_DIGITS_BINDING,
+            _blockOffsets.id());
+        _scatter.use();
+        _scatter.setUniform("count", count);
+        _scatter.setUniform("blocks", blocks);
+        _scatter.setUniform("shift", shift);
+        _scatter.setUniform("wide", wide);
+        _scatter.setUniform("hasValues", values != nullptr);
+        GPUPrimitives::dispatch(blocks);
+
+        std::swap(keys_in, keys_out);
+        if (values)
+        {
+            std::swap(values_in, values_out);
+        }
+    }
+
+    // After an odd number of passes the results are in the scratch buffers.
+    if (keys_in != &keys)
+    {
+        copy_buffer(_keys, keys, key_bytes);
+        if (values)
+        {
+            copy_buffer(_values, *values, value_bytes);
+        }
+        ++gl_call_count;
+        glMemoryBarrier(
+            GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+}
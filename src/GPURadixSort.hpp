@@ -0,0 +1,100 @@
+/**
+ * GPURadixSort.hpp - Radix sort of keys and key-value pairs on the GPU.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GPURADIXSORT_HPP
+#define _GPURADIXSORT_HPP
+
+#include "glUtil.hpp"
+#include "GPUPrimitives.hpp"
+
+#include <vector>
+
+
+/**
+ * Stable least significant digit first radix sort of 32- or 64-bit
+ * unsigned keys in shader storage buffers, optionally moving a 32-bit
+ * value with each key (see shaders/radixsort.comp). Each pass counts the
+ * digits of every block of keys, scans the counts with GPUPrimitives, then
+ * scatters every block's keys to their places. Everything stays on the GPU.
+ */
+class GPURadixSort
+{
+public:
+    /**
+     * Shape of the passes. --bench-primitives times the sort under each of
+     * CONFIGS, to pick one for a GPU and array size.
+     *  digitBits - Bits sorted per pass, 1-8. Wider digits mean fewer passes
+     *              but more counters per block.
+     *  groupSize - Invocations per work group, a power of two up to 1024.
+     *              Each work group sorts 4 times as many keys.
+     */
+    struct Config
+    {
+        GLuint digitBits;
+        GLuint groupSize;
+    };
+
+    /** Configurations worth trying. */
+    static std::vector<Config> const CONFIGS;
+
+private:
+    Config const _config;
+    Program const _count;
+    Program const _scatter;
+    GPUPrimitives _primitives;
+    /** Block digit counts, and their scan. */
+    Buffer _blockCounts;
+    Buffer _blockOffsets;
+    /** Where every other pass writes keys and values. */
+    Buffer _keys;
+    Buffer _values;
+    size_t _countsCapacity;
+    size_t _offsetsCapacity;
+    size_t _keysCapacity;
+    size_t _valuesCapacity;
+
+    void _sort(
+        Buffer const &keys, Buffer const *values, GLuint count, bool wide,
+        GLuint key_bits);
+public:
+    GPURadixSort(Config config=Config{8, 256});
+
+    /** The configuration in use. */
+    Config config() const;
+
+    /**
+     * Sort `count` 32-bit keys in place. If `values` is given, its first
+     * `count` elements are reordered along with the keys. Only the low
+     * `key_bits` bits of each key are sorted on, which saves passes when
+     * the rest are zero.
+     */
+    void sort(
+        Buffer const &keys, GLuint count, Buffer const *values=nullptr,
+        GLuint key_bits=32);
+
+    /**
+     * As sort(), but each key is 64 bits, stored as two GLuints with the
+     * low word first.
+     */
+    void sort64(
+        Buffer const &keys, GLuint count, Buffer const *values=nullptr,
+        GLuint key_bits=64);
+};
+
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * GPUTimer.cpp - Non-blocking GPU pass timing.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "GPUTimer.hpp"
+
+
+GPUTimer::GPUTimer(std::string const &label, size_t depth)
+:   _queries{}
+,   _tail{0}
+,   _pending{0}
+,   _lastMs{0.0}
+{
+    for (size_t i = 0; i < depth; ++i)
+    {
+        _queries.emplace_back(GL_TIMESTAMP, label + "Start");
+        _queries.emplace_back(GL_TIMESTAMP, label + "End");
+    }
+}
+
+void GPUTimer::_resolveOldest()
+{
+    GLuint64 const start = _queries[2 * _tail].result();
+    GLuint64 const end = _queries[2 * _tail + 1].result();
+    _lastMs = (double)(end - start) / 1.0e6;
+    _tail = (_tail + 1) % (_queries.size() / 2);
+    --_pending;
+}
+
+void GPUTimer::begin()
+{
+    // If every slot is in flight, wait for the oldest rather than dropping.
+    if (_pending == _queries.size() / 2)
+    {
+        _resolveOldest();
+    }
+    size_t const slot = (_tail + _pending) % (_queries.size() / 2);
+    _queries[2 * slot].timestamp();
+}
+
+void GPUTimer::end()
+{
+    size_t const slot = (_tail + _pending) % (_queries.size() / 2);
+    _queries[2 * slot + 1].timestamp();
+    ++_pending;
+}
+
+bool GPUTimer::poll(double &ms)
+{
+    bool updated = false;
+    while (_pending > 0 && _queries[2 * _tail + 1].available())
+    {
+        _resolveOldest();
+        updated = true;
+    }
+    ms = _lastMs;
+    return updated;
+}
+
+double GPUTimer::last() const
+{
+    return _lastMs;
+}
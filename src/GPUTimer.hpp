@@ -0,0 +1,59 @@
+/**
+ * GPUTimer.hpp - Non-blocking GPU pass timing.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GPUTIMER_HPP
+#define _GPUTIMER_HPP
+
+#include "glUtil.hpp"
+
+#include <vector>
+
+
+/**
+ * Times a span of GPU commands with a ring of timestamp queries, so results
+ * are read a few frames late instead of stalling the pipeline.
+ */
+class GPUTimer
+{
+private:
+    std::vector<Query> _queries;
+    size_t _tail;
+    size_t _pending;
+    double _lastMs;
+
+    void _resolveOldest();
+public:
+    /** depth - Number of spans that can be in flight at once. */
+    GPUTimer(std::string const &label, size_t depth=4);
+
+    /** Start timing. */
+    void begin();
+    /** Stop timing. */
+    void end();
+
+    /**
+     * Collect finished spans without blocking. Returns true if a new result
+     * became available, and stores the most recent one in `ms`.
+     */
+    bool poll(double &ms);
+    /** Most recently collected result, in milliseconds. */
+    double last() const;
+};
+
+
+#endif
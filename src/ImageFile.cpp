@@ -0,0 +1,358 @@
+/**
+ * ImageFile.cpp - Image file encoders.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ImageFile.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+
+/** Append little-endian integers to a byte string. */
+template<typename T>
+static void put_le(std::string &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out.push_back((char)((uint64_t)value >> (8 * i)));
+    }
+}
+
+/** Append big-endian 32-bit integers to a byte string. */
+static void put_be32(std::string &out, uint32_t value)
+{
+    for (int i = 3; i >= 0; --i)
+    {
+        out.push_back((char)(value >> (8 * i)));
+    }
+}
+
+/** Write a whole byte string to a file. */
+static void write_file(std::string const &path, std::string const &data)
+{
+    std::ofstream out{path.c_str(), std::ios::binary};
+    out.write(data.data(), data.size());
+    if (!out)
+    {
+        throw std::runtime_error{"failed to write '" + path + "'"};
+    }
+}
+
+
+/* ===[ PPM ]=== */
+
+static std::string encode_ppm(FrameReader::Frame const &frame)
+{
+    std::string out{
+        "P6\n" + std::to_string(frame.width) + " "
+        + std::to_string(frame.height) + "\n255\n"};
+    out.append((char const *)frame.data.data(), frame.data.size());
+    return out;
+}
+
+
+/* ===[ PNG ]=== */
+
+/** CRC-32 as used by PNG chunks. */
+static uint32_t crc32(uint32_t crc, char const *data, size_t size)
+{
+    static uint32_t table[256] = {0};
+    static bool const init = [](){
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1)? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)init;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = table[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/** Append a PNG chunk. */
+static void put_png_chunk(
+    std::string &out, char const *type, std::string const &data)
+{
+    put_be32(out, (uint32_t)data.size());
+    size_t const start = out.size();
+    out.append(type, 4);
+    out += data;
+    put_be32(out, crc32(0, out.data() + start, out.size() - start));
+}
+
+/**
+ * PNG with the image data in stored (uncompressed) deflate blocks. Frames
+ * are written as fast as they render, and compressing them would cost more
+ * than the disk bandwidth it saves; any PNG optimizer can shrink them later.
+ */
+static std::string encode_png(FrameReader::Frame const &frame)
+{
+    size_t const row = (size_t)frame.width * 3;
+
+    // Scanlines, each with filter type 0 (none).
+    std::string raw{};
+    raw.reserve((row + 1) * frame.height);
+    for (unsigned y = 0; y < frame.height; ++y)
+    {
+        raw.push_back(0);
+        raw.append((char const *)frame.data.data() + y * row, row);
+    }
+
+    // zlib stream of stored blocks.
+    std::string zlib{"\x78\x01", 2};
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw)
+    {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    size_t offset = 0;
+    do
+    {
+        size_t const len = std::min<size_t>(raw.size() - offset, 65535);
+        bool const last = offset + len == raw.size();
+        zlib.push_back(last? 1 : 0);
+        put_le(zlib, (uint16_t)len);
+        put_le(zlib, (uint16_t)~len);
+        zlib.append(raw, offset, len);
+        offset += len;
+    } while (offset < raw.size());
+    put_be32(zlib, (b << 16) | a);
+
+    std::string ihdr{};
+    put_be32(ihdr, frame.width);
+    put_be32(ihdr, frame.height);
+    // 8-bit depth, RGB, deflate, adaptive filtering, no interlace.
+    ihdr += std::string{"\x08\x02\x00\x00\x00", 5};
+
+    std::string out{"\x89PNG\r\n\x1a\n", 8};
+    put_png_chunk(out, "IHDR", ihdr);
+    put_png_chunk(out, "IDAT", zlib);
+    put_png_chunk(out, "IEND", "");
+    return out;
+}
+
+
+/* ===[ EXR ]=== */
+
+/** Append an EXR header attribute. */
+static void put_exr_attribute(
+    std::string &out, char const *name, char const *type,
+    std::string const &value)
+{
+    out += name;
+    out.push_back(0);
+    out += type;
+    out.push_back(0);
+    put_le(out, (int32_t)value.size());
+    out += value;
+}
+
+/** Single-part scanline OpenEXR, uncompressed, half-float B/G/R. */
+static std::string encode_exr(FrameReader::Frame const &frame)
+{
+    std::string out{};
+    put_le(out, (uint32_t)20000630); // magic
+    put_le(out, (uint32_t)2); // version 2, single-part scanline
+
+    // Channels, which must be in alphabetical order.
+    std::string channels{};
+    for (char const *name : {"B", "G", "R"})
+    {
+        channels += name;
+        channels.push_back(0);
+        put_le(channels, (int32_t)1); // HALF
+        put_le(channels, (uint32_t)0); // pLinear + reserved
+        put_le(channels, (int32_t)1); // xSampling
+        put_le(channels, (int32_t)1); // ySampling
+    }
+    channels.push_back(0);
+    put_exr_attribute(out, "channels", "chlist", channels);
+    put_exr_attribute(
+        out, "compression", "compression", std::string(1, '\0'));
+    std::string window{};
+    put_le(window, (int32_t)0);
+    put_le(window, (int32_t)0);
+    put_le(window, (int32_t)frame.width - 1);
+    put_le(window, (int32_t)frame.height - 1);
+    put_exr_attribute(out, "dataWindow", "box2i", window);
+    put_exr_attribute(out, "displayWindow", "box2i", window);
+    put_exr_attribute(
+        out, "lineOrder", "lineOrder", std::string(1, '\0'));
+    std::string one{};
+    float const one_f = 1.0f;
+    one.append((char const *)&one_f, sizeof(one_f));
+    put_exr_attribute(out, "pixelAspectRatio", "float", one);
+    put_exr_attribute(
+        out, "screenWindowCenter", "v2f", std::string(8, '\0'));
+    put_exr_attribute(out, "screenWindowWidth", "float", one);
+    out.push_back(0);
+
+    // Offset table, then one chunk per scanline.
+    size_t const row = (size_t)frame.width * 3 * 2;
+    size_t const chunk = 4 + 4 + row;
+    size_t const first = out.size() + 8 * (size_t)frame.height;
+    for (unsigned y = 0; y < frame.height; ++y)
+    {
+        put_le(out, (uint64_t)(first + y * chunk));
+    }
+    for (unsigned y = 0; y < frame.height; ++y)
+    {
+        put_le(out, (int32_t)y);
+        put_le(out, (int32_t)row);
+        out.append((char const *)frame.data.data() + y * row, row);
+    }
+    return out;
+}
+
+
+/* ===[ DDS ]=== */
+
+/**
+ * DDS with a DX10 header extension, which block compressed DXGI formats
+ * need. The blocks are stored as read back.
+ */
+static std::string encode_dds(
+    FrameReader::Frame const &frame, uint32_t dxgi_format)
+{
+    std::string out{"DDS "};
+    put_le(out, (uint32_t)124); // header size
+    // CAPS | HEIGHT | WIDTH | PIXELFORMAT | LINEARSIZE
+    put_le(out, (uint32_t)0x81007);
+    put_le(out, (uint32_t)frame.height);
+    put_le(out, (uint32_t)frame.width);
+    put_le(out, (uint32_t)frame.data.size()); // linear size
+    put_le(out, (uint32_t)0); // depth
+    put_le(out, (uint32_t)1); // mipmap count
+    out.append(11 * 4, '\0'); // reserved
+
+    // Pixel format: defined by the DX10 header.
+    put_le(out, (uint32_t)32); // size
+    put_le(out, (uint32_t)0x4); // FOURCC
+    out += "DX10";
+    out.append(5 * 4, '\0'); // bit count and masks
+
+    put_le(out, (uint32_t)0x1000); // caps: TEXTURE
+    out.append(4 * 4, '\0'); // caps2-4, reserved
+
+    put_le(out, dxgi_format);
+    put_le(out, (uint32_t)3); // resource dimension: TEXTURE2D
+    put_le(out, (uint32_t)0); // misc flags
+    put_le(out, (uint32_t)1); // array size
+    put_le(out, (uint32_t)0); // misc flags 2
+    out.append((char const *)frame.data.data(), frame.data.size());
+    return out;
+}
+
+
+/* ===[ Interface ]=== */
+
+ImageFormat image_format_from_path(std::string const &path)
+{
+    size_t const dot = path.rfind('.');
+    std::string extension = dot == std::string::npos? "" : path.substr(dot);
+    std::transform(
+        extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == ".ppm")
+    {
+        return IMAGE_PPM;
+    }
+    if (extension == ".png")
+    {
+        return IMAGE_PNG;
+    }
+    if (extension == ".exr")
+    {
+        return IMAGE_EXR;
+    }
+    if (extension == ".dds")
+    {
+        std::string lower = path;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        bool const hdr = (
+            lower.size() >= 8
+            && lower.compare(lower.size() - 8, 8, ".hdr.dds") == 0);
+        return hdr? IMAGE_DDS_BC6H : IMAGE_DDS_BC7;
+    }
+    throw std::runtime_error{
+        "unsupported image type '" + path + "'"
+        " (use .ppm, .png, .exr, .dds or .hdr.dds)"};
+}
+
+PixelLayout image_format_layout(ImageFormat format)
+{
+    switch (format)
+    {
+    case IMAGE_EXR:
+        return PIXELS_HALF_BGR_PLANAR;
+    case IMAGE_DDS_BC7:
+        return PIXELS_BC7;
+    case IMAGE_DDS_BC6H:
+        return PIXELS_BC6H;
+    default:
+        return PIXELS_RGB8;
+    }
+}
+
+std::string encode_image(
+    ImageFormat format, FrameReader::Frame const &frame)
+{
+    if (frame.layout != image_format_layout(format))
+    {
+        throw std::runtime_error{
+            "encode_image - frame is in the wrong layout for the format"};
+    }
+    switch (format)
+    {
+    case IMAGE_PPM:
+        return encode_ppm(frame);
+    case IMAGE_PNG:
+        return encode_png(frame);
+    case IMAGE_EXR:
+        return encode_exr(frame);
+    case IMAGE_DDS_BC7:
+        return encode_dds(frame, 98); // DXGI_FORMAT_BC7_UNORM
+    case IMAGE_DDS_BC6H:
+        return encode_dds(frame, 95); // DXGI_FORMAT_BC6H_UF16
+    }
+    throw std::runtime_error{"encode_image - unknown format"};
+}
+
+void write_image(
+    std::string const &path, ImageFormat format,
+    FrameReader::Frame const &frame)
+{
+    if (frame.layout != image_format_layout(format))
+    {
+        throw std::runtime_error{
+            "write_image - frame is in the wrong layout for '" + path + "'"};
+    }
+    write_file(path, encode_image(format, frame));
+}
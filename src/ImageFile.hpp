@@ -0,0 +1,66 @@
+/**
+ * ImageFile.hpp - Image file encoders.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IMAGEFILE_HPP
+#define _IMAGEFILE_HPP
+
+#include "FrameReader.hpp"
+
+#include <string>
+
+
+/** Supported image file formats. */
+enum ImageFormat
+{
+    /** Binary PPM, 8-bit RGB. */
+    IMAGE_PPM,
+    /** PNG, 8-bit RGB. */
+    IMAGE_PNG,
+    /** OpenEXR, half-float RGB. */
+    IMAGE_EXR,
+    /** DDS, BC7 compressed 8-bit RGB. */
+    IMAGE_DDS_BC7,
+    /** DDS, BC6H compressed half-float RGB. */
+    IMAGE_DDS_BC6H,
+};
+
+/**
+ * Pick a format from a path's extension, where `.hdr.dds` picks BC6H over
+ * BC7. Throws if it's not supported.
+ */
+ImageFormat image_format_from_path(std::string const &path);
+
+/** Pixel layout a format expects its frames in. */
+PixelLayout image_format_layout(ImageFormat format);
+
+/**
+ * Encode a frame as a whole file in memory. The frame must be in the
+ * format's pixel layout.
+ */
+std::string encode_image(ImageFormat format, FrameReader::Frame const &frame);
+
+/**
+ * Encode and write a frame. The frame must be in the format's pixel layout.
+ * Throws on I/O errors.
+ */
+void write_image(
+    std::string const &path, ImageFormat format,
+    FrameReader::Frame const &frame);
+
+
+#endif
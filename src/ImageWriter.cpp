@@ -0,0 +1,121 @@
+/**
+ * ImageWriter.cpp - Thread pool that encodes and writes image files.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ImageWriter.hpp"
+
+#include <algorithm>
+
+
+ImageWriter::ImageWriter(size_t threads, size_t max_queued)
+:   _maxQueued{std::max<size_t>(max_queued, 1)}
+,   _jobs{}
+,   _active{0}
+,   _stop{false}
+,   _error{}
+,   _mutex{}
+,   _wake{}
+,   _done{}
+,   _threads{}
+{
+    if (threads == 0)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (size_t i = 0; i < threads; ++i)
+    {
+        _threads.emplace_back(&ImageWriter::_run, this);
+    }
+}
+
+ImageWriter::~ImageWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto &thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void ImageWriter::_run()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    for (;;)
+    {
+        _wake.wait(lock, [this](){ return _stop || !_jobs.empty(); });
+        if (_jobs.empty())
+        {
+            // Stopping, and nothing left to write.
+            return;
+        }
+        Job job = std::move(_jobs.front());
+        _jobs.pop_front();
+        ++_active;
+        // Room in the queue for another frame.
+        _done.notify_all();
+        lock.unlock();
+        try
+        {
+            write_image(job.path, job.format, job.frame);
+        }
+        catch (...)
+        {
+            lock.lock();
+            if (!_error)
+            {
+                _error = std::current_exception();
+            }
+            lock.unlock();
+        }
+        lock.lock();
+        --_active;
+        _done.notify_all();
+    }
+}
+
+void ImageWriter::_rethrow()
+{
+    if (_error)
+    {
+        std::exception_ptr const error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ImageWriter::write(
+    std::string const &path, ImageFormat format, FrameReader::Frame frame)
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    _done.wait(lock, [this](){
+        return _jobs.size() < _maxQueued || _error;
+    });
+    _rethrow();
+    _jobs.push_back(Job{path, format, std::move(frame)});
+    _wake.notify_one();
+}
+
+void ImageWriter::finish()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    _done.wait(lock, [this](){ return _jobs.empty() && _active == 0; });
+    _rethrow();
+}
@@ -0,0 +1,85 @@
+/**
+ * ImageWriter.hpp - Thread pool that encodes and writes image files.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IMAGEWRITER_HPP
+#define _IMAGEWRITER_HPP
+
+#include "ImageFile.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Encodes and writes frames on a pool of threads, so file output runs
+ * alongside rendering. The queue is bounded: once it's full, write() blocks
+ * until a thread frees up, instead of buffering frames without limit.
+ */
+class ImageWriter
+{
+private:
+    /** A queued file. */
+    struct Job
+    {
+        std::string path;
+        ImageFormat format;
+        FrameReader::Frame frame;
+    };
+
+    size_t const _maxQueued;
+    std::deque<Job> _jobs;
+    size_t _active;
+    bool _stop;
+    std::exception_ptr _error;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::vector<std::thread> _threads;
+
+    void _run();
+    /** Rethrow the first error from a thread. NOTE: Hold _mutex! */
+    void _rethrow();
+public:
+    /**
+     * threads - Number of threads. (0 = one per hardware thread)
+     * max_queued - Frames that can wait before write() blocks.
+     */
+    ImageWriter(size_t threads=0, size_t max_queued=8);
+    /** Finishes writing queued frames. */
+    ~ImageWriter();
+
+    ImageWriter(ImageWriter const &) = delete;
+    ImageWriter &operator=(ImageWriter const &) = delete;
+
+    /**
+     * Queue a frame to be written. Throws if an earlier write failed.
+     */
+    void write(
+        std::string const &path, ImageFormat format,
+        FrameReader::Frame frame);
+
+    /** Wait for every queued frame to be written. Throws on errors. */
+    void finish();
+};
+
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * JobBatch.cpp - Rendering many small jobs per dispatch.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "JobBatch.hpp"
+#include "App.hpp"
+#include "Batch.hpp"
+#include "FrameReader.hpp"
+#include "ImageFile.hpp"
+#include "ImageWriter.hpp"
+#include "Scenes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+/** Most pixels rendered into one atlas, to keep it within a texture. */
+static uint64_t const JOB_BATCH_PIXELS = 4096 * 4096;
+
+
+std::vector<RenderJob> load_render_jobs(std::string const &path)
+{
+    std::ifstream in{path.c_str()};
+    if (!in)
+    {
+        throw std::runtime_error{"failed to open job file '" + path + "'"};
+    }
+    std::vector<RenderJob> jobs{};
+    std::string line{};
+    for (size_t number = 1; std::getline(in, line); ++number)
+    {
+        size_t const first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields{line};
+        RenderJob job{};
+        glm::vec3 target{};
+        fields >> job.width >> job.height
+            >> job.camera.position.x >> job.camera.position.y
+            >> job.camera.position.z
+            >> target.x >> target.y >> target.z;
+        if (!fields || job.width == 0 || job.height == 0)
+        {
+            throw std::runtime_error{
+                path + ":" + std::to_string(number)
+                + ": expected W H PX PY PZ TX TY TZ"
+                " [FOV [SPHERE COUNT [LIGHT COUNT]]]"};
+        }
+        double fov_degrees = 90.0;
+        job.firstSphere = 0;
+        job.sphereCount = ~0u;
+        job.firstLight = 0;
+        job.lightCount = ~0u;
+        if (fields >> fov_degrees
+            && fields >> job.firstSphere >> job.sphereCount)
+        {
+            fields >> job.firstLight >> job.lightCount;
+        }
+        job.camera.forward = glm::normalize(target - job.camera.position);
+        job.camera.up = glm::vec3{0.0f, 1.0f, 0.0f};
+        job.camera.fov = glm::radians((GLfloat)fov_degrees);
+        jobs.push_back(job);
+    }
+    if (jobs.empty())
+    {
+        throw std::runtime_error{"job file '" + path + "' is empty"};
+    }
+    return jobs;
+}
+
+
+int run_job_batch(Options const &options)
+{
+    ImageFormat const format = image_format_from_path(options.jobsOutput);
+    std::vector<RenderJob> const jobs = load_render_jobs(options.jobsPath);
+
+    init_SDL();
+    App app{"compute jobs", 64, 64, false};
+    app.setVSync(false);
+
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    ComputeRaytraceRenderer renderer{setup.scene, 64, 64};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+    GLuint const batch = renderer.maxJobs();
+
+    // Atlas N is read back while atlas N+1 renders.
+    FrameReader reader{};
+    ImageWriter writer{options.writerThreads};
+    FrameReader::Frame done{};
+    auto const hand_off = [&](){
+        unsigned const tag = done.tag;
+        writer.write(
+            frame_path(options.jobsOutput, tag), format, std::move(done));
+    };
+
+    // Job rectangles are listed from the atlas image's top left.
+    std::cout << "job,atlas,left,top,width,height\n";
+    auto const start = std::chrono::steady_clock::now();
+    unsigned atlas = 0;
+    size_t last = 0;
+    for (size_t first = 0; first < jobs.size(); first = last, ++atlas)
+    {
+        // Fill the atlas up to the dispatch's job limit or pixel budget,
+        // whichever comes first, but always take at least one job.
+        uint64_t pixels = 0;
+        for (last = first; last < jobs.size() && last - first < batch; ++last)
+        {
+            uint64_t const job_pixels
+                = (uint64_t)jobs[last].width * jobs[last].height;
+            if (last > first && pixels + job_pixels > JOB_BATCH_PIXELS)
+            {
+                break;
+            }
+            pixels += job_pixels;
+        }
+        std::vector<glm::ivec4> const rects = renderer.renderJobs(
+            {jobs.begin() + first, jobs.begin() + last});
+        glm::ivec2 const size = renderer.jobAtlasSize();
+        for (size_t i = 0; i < rects.size(); ++i)
+        {
+            glm::ivec4 const &r = rects[i];
+            std::cout << first + i << "," << atlas << "," << r.x << ","
+                << size.y - r.y - r.w << "," << r.z << "," << r.w << "\n";
+        }
+        if (reader.full() && reader.collect(done, true))
+        {
+            hand_off();
+        }
+        reader.read(
+            renderer.getJobResults(), size.x, size.y,
+            image_format_layout(format), atlas);
+        while (reader.collect(done))
+        {
+            hand_off();
+        }
+    }
+    while (reader.collect(done, true))
+    {
+        hand_off();
+    }
+    writer.finish();
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::clog << jobs.size() << " jobs in " << atlas << " dispatches, "
+        << seconds << " s: " << jobs.size() / seconds << " jobs/s\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+/**
+ * JobBatch.hpp - Rendering many small jobs per dispatch.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JOBBATCH_HPP
+#define _JOBBATCH_HPP
+
+#include "ComputeRaytraceRenderer.hpp"
+#include "Options.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Load a job file. Job files have one job per line:
+ *   W H  PX PY PZ  TX TY TZ  [FOV [SPHERE COUNT [LIGHT COUNT]]]
+ * where W and H are the job's size, P is the eye position, T is the point
+ * looked at, FOV is the horizontal field of view in degrees, and SPHERE,
+ * LIGHT and their COUNTs are the ranges of the scene rendered (default
+ * all). Blank lines and lines starting with '#' are ignored. Throws on I/O
+ * or syntax errors.
+ */
+std::vector<RenderJob> load_render_jobs(std::string const &path);
+
+/**
+ * Render every job in a job file, as many per dispatch as the GPU allows,
+ * writing one atlas image per dispatch and listing where each job landed.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_job_batch(Options const &options);
+
+
+#endif
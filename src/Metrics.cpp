@@ -0,0 +1,471 @@
+/**
+ * Metrics.cpp - Performance metrics registry and exporters.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Metrics.hpp"
+#include "Socket.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+
+/** Seconds since the Unix epoch. */
+static double unix_time()
+{
+    return std::chrono::duration<double>{
+        std::chrono::system_clock::now().time_since_epoch()}.count();
+}
+
+
+uint64_t process_resident_bytes()
+{
+#ifdef __linux__
+    // Second field of statm is the resident set size in pages.
+    std::ifstream statm{"/proc/self/statm"};
+    uint64_t size = 0, resident = 0;
+    if (statm >> size >> resident)
+    {
+        return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+
+/* ===[ Counter ]=== */
+
+Counter::Counter()
+:   _value{0}
+{
+}
+
+void Counter::add(uint64_t n)
+{
+    _value.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const
+{
+    return _value.load(std::memory_order_relaxed);
+}
+
+
+/* ===[ Gauge ]=== */
+
+Gauge::Gauge()
+:   _value{0.0}
+{
+}
+
+void Gauge::set(double value)
+{
+    _value.store(value, std::memory_order_relaxed);
+}
+
+double Gauge::value() const
+{
+    return _value.load(std::memory_order_relaxed);
+}
+
+
+/* ===[ Histogram ]=== */
+
+size_t const Histogram::_bucketCount{
+    ((size_t)1 << _subBucketBits)
+    * (_highestBit - _subBucketBits + 2)};
+
+Histogram::Histogram()
+:   _buckets{new std::atomic<uint64_t>[_bucketCount]}
+,   _count{0}
+,   _sum{0}
+,   _min{std::numeric_limits<uint64_t>::max()}
+,   _max{0}
+{
+    for (size_t i = 0; i < _bucketCount; ++i)
+    {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t Histogram::_bucketIndex(uint64_t value)
+{
+    uint64_t const M = (uint64_t)1 << _subBucketBits;
+    if (value < M)
+    {
+        return (size_t)value;
+    }
+    unsigned msb = 0;
+    for (uint64_t v = value; v > 1; v >>= 1)
+    {
+        ++msb;
+    }
+    unsigned const shift = msb - _subBucketBits;
+    uint64_t const sub = (value >> shift) - M;
+    return (size_t)(M + shift * M + sub);
+}
+
+uint64_t Histogram::_bucketLowest(size_t index)
+{
+    uint64_t const M = (uint64_t)1 << _subBucketBits;
+    if (index < M)
+    {
+        return index;
+    }
+    uint64_t const shift = (index - M) / M;
+    uint64_t const sub = (index - M) % M;
+    return (M + sub) << shift;
+}
+
+uint64_t Histogram::_bucketWidth(size_t index)
+{
+    uint64_t const M = (uint64_t)1 << _subBucketBits;
+    if (index < M)
+    {
+        return 1;
+    }
+    return (uint64_t)1 << ((index - M) / M);
+}
+
+void Histogram::record(uint64_t value)
+{
+    uint64_t const highest = ((uint64_t)1 << (_highestBit + 1)) - 1;
+    if (value > highest)
+    {
+        value = highest;
+    }
+    _buckets[_bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t seen = _min.load(std::memory_order_relaxed);
+    while (value < seen && !_min.compare_exchange_weak(seen, value))
+    {
+    }
+    seen = _max.load(std::memory_order_relaxed);
+    while (value > seen && !_max.compare_exchange_weak(seen, value))
+    {
+    }
+}
+
+uint64_t Histogram::count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::sum() const
+{
+    return _sum.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::min() const
+{
+    return count() == 0? 0 : _min.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::max() const
+{
+    return _max.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+    uint64_t const n = count();
+    return n == 0? 0.0 : (double)sum() / (double)n;
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+    uint64_t const n = count();
+    if (n == 0)
+    {
+        return 0;
+    }
+    // Rank of the wanted sample, 1-based.
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)n + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < _bucketCount; ++i)
+    {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // Report the middle of the bucket, clamped to the observed range.
+            uint64_t const v = _bucketLowest(i) + _bucketWidth(i) / 2;
+            return v < min()? min() : v > max()? max() : v;
+        }
+    }
+    return max();
+}
+
+
+/* ===[ MetricsRegistry ]=== */
+
+/** Percentiles reported for every histogram. */
+static double const reported_percentiles[] = {50.0, 90.0, 99.0, 99.9};
+
+MetricsRegistry &MetricsRegistry::global()
+{
+    static MetricsRegistry registry{};
+    return registry;
+}
+
+Counter &MetricsRegistry::counter(
+    std::string const &name, std::string const &help)
+{
+    return _get(_counters, name, help);
+}
+
+Gauge &MetricsRegistry::gauge(std::string const &name, std::string const &help)
+{
+    return _get(_gauges, name, help);
+}
+
+Histogram &MetricsRegistry::histogram(
+    std::string const &name, std::string const &help)
+{
+    return _get(_histograms, name, help);
+}
+
+std::string MetricsRegistry::toJSON(double timestamp) const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::ostringstream out{};
+    out.precision(15);
+    out << "{\"timestamp\":" << timestamp;
+
+    out << ",\"counters\":{";
+    char const *sep = "";
+    for (auto const &kv : _counters)
+    {
+        out << sep << "\"" << kv.first << "\":" << kv.second.metric->value();
+        sep = ",";
+    }
+
+    out << "},\"gauges\":{";
+    sep = "";
+    for (auto const &kv : _gauges)
+    {
+        out << sep << "\"" << kv.first << "\":" << kv.second.metric->value();
+        sep = ",";
+    }
+
+    out << "},\"histograms\":{";
+    sep = "";
+    for (auto const &kv : _histograms)
+    {
+        auto const &h = *kv.second.metric;
+        out << sep << "\"" << kv.first << "\":{"
+            << "\"count\":" << h.count()
+            << ",\"min\":" << h.min()
+            << ",\"max\":" << h.max()
+            << ",\"mean\":" << h.mean();
+        for (double p : reported_percentiles)
+        {
+            std::ostringstream key{};
+            key << p;
+            std::string name = key.str();
+            for (auto &c : name)
+            {
+                if (c == '.')
+                {
+                    c = '_';
+                }
+            }
+            out << ",\"p" << name << "\":" << h.percentile(p);
+        }
+        out << "}";
+        sep = ",";
+    }
+    out << "}}";
+    return out.str();
+}
+
+std::string MetricsRegistry::toPrometheus() const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::ostringstream out{};
+    out.precision(15);
+    for (auto const &kv : _counters)
+    {
+        out << "# HELP " << kv.first << " " << kv.second.help << "\n"
+            << "# TYPE " << kv.first << " counter\n"
+            << kv.first << " " << kv.second.metric->value() << "\n";
+    }
+    for (auto const &kv : _gauges)
+    {
+        out << "# HELP " << kv.first << " " << kv.second.help << "\n"
+            << "# TYPE " << kv.first << " gauge\n"
+            << kv.first << " " << kv.second.metric->value() << "\n";
+    }
+    // HDR buckets are far too fine-grained to expose directly, so histograms
+    // are exported as summaries.
+    for (auto const &kv : _histograms)
+    {
+        auto const &h = *kv.second.metric;
+        out << "# HELP " << kv.first << " " << kv.second.help << "\n"
+            << "# TYPE " << kv.first << " summary\n";
+        for (double p : reported_percentiles)
+        {
+            out << kv.first << "{quantile=\"" << p / 100.0 << "\"} "
+                << h.percentile(p) << "\n";
+        }
+        out << kv.first << "_sum " << h.sum() << "\n"
+            << kv.first << "_count " << h.count() << "\n";
+    }
+    return out.str();
+}
+
+
+/* ===[ MetricsExporter ]=== */
+
+MetricsExporter::MetricsExporter(
+    MetricsRegistry const &registry, std::string const &path,
+    double interval, unsigned short port)
+:   _registry{registry}
+,   _path{path}
+,   _interval{interval}
+,   _listener{port != 0? Socket::listenTCP(port) : Socket{}}
+,   _stop{false}
+,   _mutex{}
+,   _wake{}
+,   _thread{}
+{
+    if (_listener.valid())
+    {
+        std::cout << "Serving metrics on http://127.0.0.1:" << port
+            << "/metrics\n";
+    }
+    _thread = std::thread{&MetricsExporter::_run, this};
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stop = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+    // Flush a final snapshot so short runs still produce output.
+    _writeSnapshot();
+}
+
+void MetricsExporter::_run()
+{
+    using Clock = std::chrono::steady_clock;
+    auto next = Clock::now();
+    for (;;)
+    {
+        auto now = Clock::now();
+        if (now >= next)
+        {
+            _writeSnapshot();
+            next = now + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>{_interval});
+        }
+        if (_listener.valid())
+        {
+            // Poll in short slices so shutdown isn't held up by the socket.
+            double const wait = std::min(
+                0.1, std::chrono::duration<double>{next - now}.count());
+            try
+            {
+                if (_listener.waitReadable(std::max(0.0, wait)))
+                {
+                    _serveClient();
+                }
+            }
+            catch (std::runtime_error const &e)
+            {
+                std::cerr << "MetricsExporter - " << e.what() << "\n";
+            }
+        }
+        std::unique_lock<std::mutex> lock{_mutex};
+        if (!_listener.valid())
+        {
+            _wake.wait_until(lock, next, [this](){ return _stop; });
+        }
+        if (_stop)
+        {
+            return;
+        }
+    }
+}
+
+void MetricsExporter::_writeSnapshot()
+{
+    if (_path.empty())
+    {
+        return;
+    }
+    std::ofstream out{_path.c_str(), std::ios::app};
+    if (!out)
+    {
+        std::cerr << "MetricsExporter - failed to open '" << _path << "'\n";
+        return;
+    }
+    out << _registry.toJSON(unix_time()) << "\n";
+}
+
+void MetricsExporter::_serveClient()
+{
+    Socket const client = _listener.accept();
+    // Read the request line; anything other than GET /metrics is a 404.
+    std::string request{};
+    char buf[512];
+    while (request.find("\r\n\r\n") == std::string::npos
+        && request.size() < 8192
+        && client.waitReadable(1.0))
+    {
+        size_t const n = client.recvSome(buf, sizeof(buf));
+        if (n == 0)
+        {
+            break;
+        }
+        request.append(buf, n);
+    }
+    std::string status{"200 OK"};
+    std::string body{};
+    if (request.compare(0, 13, "GET /metrics ") == 0)
+    {
+        body = _registry.toPrometheus();
+    }
+    else
+    {
+        status = "404 Not Found";
+        body = "not found\n";
+    }
+    std::ostringstream response{};
+    response
+        << "HTTP/1.1 " << status << "\r\n"
+        << "Content-Type: text/plain; version=0.0.4\r\n"
+        << "Content-Length: " << body.size() << "\r\n"
+        << "Connection: close\r\n\r\n"
+        << body;
+    client.sendAll(response.str());
+}
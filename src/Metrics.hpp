@@ -0,0 +1,204 @@
+/**
+ * Metrics.hpp - Performance metrics registry and exporters.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _METRICS_HPP
+#define _METRICS_HPP
+
+#include "Socket.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+/**
+ * Monotonically increasing value (eg. frames rendered, bytes uploaded).
+ */
+class Counter
+{
+private:
+    std::atomic<uint64_t> _value;
+public:
+    Counter();
+
+    /** Increase the counter. */
+    void add(uint64_t n=1);
+    /** Get the current value. */
+    uint64_t value() const;
+};
+
+/**
+ * Value which can go up and down (eg. memory in use).
+ */
+class Gauge
+{
+private:
+    std::atomic<double> _value;
+public:
+    Gauge();
+
+    /** Set the gauge's value. */
+    void set(double value);
+    /** Get the current value. */
+    double value() const;
+};
+
+/**
+ * HDR-style histogram of unsigned integer samples.
+ *
+ * Values below 2^_subBucketBits are counted exactly, larger values are
+ * counted in log-linear buckets with a relative error of about
+ * 1/2^_subBucketBits. Values above the highest trackable value are clamped.
+ * Recording is lock-free, so a histogram can be updated from any thread.
+ */
+class Histogram
+{
+private:
+    static unsigned const _subBucketBits = 6;
+    static unsigned const _highestBit = 40;
+    static size_t const _bucketCount;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> _buckets;
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _min;
+    std::atomic<uint64_t> _max;
+
+    static size_t _bucketIndex(uint64_t value);
+    static uint64_t _bucketLowest(size_t index);
+    static uint64_t _bucketWidth(size_t index);
+public:
+    Histogram();
+
+    /** Record a sample. */
+    void record(uint64_t value);
+
+    /** Number of recorded samples. */
+    uint64_t count() const;
+    /** Sum of all recorded samples. */
+    uint64_t sum() const;
+    /** Smallest recorded sample, or 0 if empty. */
+    uint64_t min() const;
+    /** Largest recorded sample, or 0 if empty. */
+    uint64_t max() const;
+    /** Mean of the recorded samples, or 0 if empty. */
+    double mean() const;
+    /** Value at the given percentile (0-100), or 0 if empty. */
+    uint64_t percentile(double p) const;
+};
+
+
+/**
+ * Collection of named metrics.
+ *
+ * Metrics are created on first use and live as long as the registry, so
+ * references returned by counter(), gauge() and histogram() can be cached.
+ */
+class MetricsRegistry
+{
+private:
+    template<typename T>
+    struct Entry
+    {
+        std::string help;
+        std::unique_ptr<T> metric;
+    };
+
+    mutable std::mutex _mutex;
+    std::map<std::string, Entry<Counter>> _counters;
+    std::map<std::string, Entry<Gauge>> _gauges;
+    std::map<std::string, Entry<Histogram>> _histograms;
+
+    template<typename T>
+    T &_get(
+        std::map<std::string, Entry<T>> &map, std::string const &name,
+        std::string const &help)
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        auto &entry = map[name];
+        if (!entry.metric)
+        {
+            entry.help = help;
+            entry.metric.reset(new T{});
+        }
+        return *entry.metric;
+    }
+public:
+    /** The process-wide registry updated by the renderer and app. */
+    static MetricsRegistry &global();
+
+    /** Get (or create) a counter. */
+    Counter &counter(std::string const &name, std::string const &help="");
+    /** Get (or create) a gauge. */
+    Gauge &gauge(std::string const &name, std::string const &help="");
+    /** Get (or create) a histogram. */
+    Histogram &histogram(std::string const &name, std::string const &help="");
+
+    /** Serialize all metrics as a single line of JSON. */
+    std::string toJSON(double timestamp) const;
+    /** Serialize all metrics in the Prometheus text exposition format. */
+    std::string toPrometheus() const;
+};
+
+
+/** Resident memory of this process in bytes, or 0 if unknown. */
+uint64_t process_resident_bytes();
+
+
+/**
+ * Background thread that periodically appends a JSON snapshot of a registry
+ * to a file, and optionally serves the Prometheus exposition over HTTP on
+ * localhost.
+ */
+class MetricsExporter
+{
+private:
+    MetricsRegistry const &_registry;
+    std::string const _path;
+    double const _interval;
+    Socket const _listener;
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::thread _thread;
+
+    void _run();
+    void _writeSnapshot();
+    void _serveClient();
+public:
+    /**
+     * path - File to append JSON lines to. (Empty to disable)
+     * interval - Seconds between JSON lines.
+     * port - Localhost port to serve /metrics on. (0 to disable)
+     */
+    MetricsExporter(
+        MetricsRegistry const &registry, std::string const &path,
+        double interval, unsigned short port);
+    ~MetricsExporter();
+
+    MetricsExporter(MetricsExporter const &) = delete;
+    MetricsExporter &operator=(MetricsExporter const &) = delete;
+};
+
+
+#endif
@@ -0,0 +1,680 @@
+/**
+ * Options.cpp - Command-line options.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Options.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+Options::Options()
+:   program{"compute"}
+,   help{false}
+,   benchmark{false}
+,   benchPrimitives{false}
+,   benchSceneEdits{false}
+,   batch{false}
+,   scenes{}
+,   width{640}
+,   height{480}
+,   samples{1}
+,   metricsFile{}
+,   metricsInterval{1.0}
+,   metricsPort{0}
+,   hitchThreshold{100.0}
+,   hitchWindow{5.0}
+,   hitchDirectory{"."}
+,   deltaSocket{}
+,   views{1}
+,   viewSpacing{0.5}
+,   temporalHints{false}
+,   sceneStorage{STORAGE_SSBO, STORAGE_SSBO, STORAGE_SSBO}
+,   benchOutput{}
+,   benchBaseline{}
+,   benchReferenceSamples{256}
+,   benchFrames{10}
+,   benchTolerance{0.1}
+,   benchMaxElements{1u << 24}
+,   cameraPath{}
+,   frames{0}
+,   outputPattern{"frame%05d.ppm"}
+,   writerThreads{0}
+,   streamPath{}
+,   fps{30}
+,   shmName{}
+,   shmSlots{4}
+,   tiledWidth{0}
+,   tiledHeight{0}
+,   tileSize{512}
+,   tiledOutput{"render.tif"}
+,   progressiveSamples{0}
+,   progressiveOutput{"progressive.png"}
+,   checkpointPath{"render.ckpt"}
+,   checkpointInterval{60.0}
+,   resume{false}
+,   probesPath{}
+,   probeSize{64}
+,   probeOutput{}
+,   jobsPath{}
+,   jobsOutput{"atlas%03d.png"}
+,   farmWorkers{0}
+,   farmWorkerSocket{}
+,   sortLastWorkers{0}
+,   sortLastWorkerSocket{}
+,   framePoolWorkers{0}
+,   framePoolWorkerSocket{}
+,   framePoolChunk{1}
+,   servePath{}
+,   serveWindow{2.0}
+,   serveMaxSamples{64}
+,   clientPath{}
+{
+}
+
+
+/** Get the value following option `argv[i]`, advancing `i`. */
+static std::string option_value(int argc, char *argv[], int &i)
+{
+    if (i + 1 >= argc)
+    {
+        throw std::runtime_error{
+            "option '" + std::string{argv[i]} + "' requires a value"};
+    }
+    return argv[++i];
+}
+
+/** Parse a number, throwing a readable error on failure. */
+static double option_number(std::string const &option, std::string const &value)
+{
+    try
+    {
+        size_t end = 0;
+        double const number = std::stod(value, &end);
+        if (end == value.size())
+        {
+            return number;
+        }
+    }
+    catch (std::logic_error const &)
+    {
+    }
+    throw std::runtime_error{
+        "option '" + option + "' expects a number, got '" + value + "'"};
+}
+
+/** Parse a positive integer, throwing a readable error on failure. */
+static unsigned option_count(std::string const &option, std::string const &value)
+{
+    double const number = option_number(option, value);
+    if (number < 1 || number != (double)(unsigned)number)
+    {
+        throw std::runtime_error{
+            "option '" + option + "' expects a positive integer, got '"
+            + value + "'"};
+    }
+    return (unsigned)number;
+}
+
+/**
+ * Check a printf pattern given the frame number, as frame_path() expands
+ * them: it may only have integer conversions, with no length modifiers or
+ * `*` fields, and must have exactly one, or at most one if `optional`.
+ */
+static void check_frame_pattern(
+    std::string const &option, std::string const &value, bool optional)
+{
+    size_t conversions = 0;
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        if (value[i] != '%')
+        {
+            continue;
+        }
+        if (++i < value.size() && value[i] == '%')
+        {
+            continue;
+        }
+        i = std::min(value.find_first_not_of("-+ #0", i), value.size());
+        i = std::min(value.find_first_not_of("0123456789", i), value.size());
+        if (i < value.size() && value[i] == '.')
+        {
+            i = std::min(
+                value.find_first_not_of("0123456789", i + 1), value.size());
+        }
+        if (i == value.size()
+            || std::string{"diouxX"}.find(value[i]) == std::string::npos)
+        {
+            throw std::runtime_error{
+                "option '" + option + "' only takes integer conversions"
+                " (eg. %05d), got '" + value + "'"};
+        }
+        ++conversions;
+    }
+    if (conversions > 1 || (conversions == 0 && !optional))
+    {
+        throw std::runtime_error{
+            "option '" + option + "' needs "
+            + (optional? "at most one" : "exactly one")
+            + " frame number conversion (eg. %05d), got '" + value + "'"};
+    }
+}
+
+/** Parse a WIDTHxHEIGHT size. */
+static void option_size(
+    std::string const &option, std::string const &value, unsigned &width,
+    unsigned &height)
+{
+    size_t const x = value.find('x');
+    if (x == std::string::npos)
+    {
+        throw std::runtime_error{
+            "option '" + option + "' expects WIDTHxHEIGHT, got '"
+            + value + "'"};
+    }
+    width = option_count(option, value.substr(0, x));
+    height = option_count(option, value.substr(x + 1));
+}
+
+
+Options parse_options(int argc, char *argv[])
+{
+    Options options{};
+    if (argc > 0)
+    {
+        options.program = argv[0];
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string const arg{argv[i]};
+        if (arg == "-h" || arg == "--help")
+        {
+            options.help = true;
+        }
+        else if (arg == "--benchmark")
+        {
+            options.benchmark = true;
+        }
+        else if (arg == "--bench-primitives")
+        {
+            options.benchPrimitives = true;
+        }
+        else if (arg == "--bench-scene-edits")
+        {
+            options.benchSceneEdits = true;
+        }
+        else if (arg == "--batch")
+        {
+            options.batch = true;
+        }
+        else if (arg == "--scene")
+        {
+            options.scenes.push_back(option_value(argc, argv, i));
+        }
+        else if (arg == "--size")
+        {
+            option_size(
+                arg, option_value(argc, argv, i), options.width,
+                options.height);
+        }
+        else if (arg == "--samples")
+        {
+            options.samples = option_count(arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--metrics-file")
+        {
+            options.metricsFile = option_value(argc, argv, i);
+        }
+        else if (arg == "--metrics-interval")
+        {
+            options.metricsInterval = option_number(
+                arg, option_value(argc, argv, i));
+            if (options.metricsInterval <= 0.0)
+            {
+                throw std::runtime_error{"--metrics-interval must be > 0"};
+            }
+        }
+        else if (arg == "--metrics-port")
+        {
+            double const port = option_number(
+                arg, option_value(argc, argv, i));
+            if (port < 1 || port > 65535)
+            {
+                throw std::runtime_error{"--metrics-port must be 1-65535"};
+            }
+            options.metricsPort = (unsigned short)port;
+        }
+        else if (arg == "--hitch-threshold")
+        {
+            options.hitchThreshold = option_number(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--hitch-window")
+        {
+            options.hitchWindow = option_number(
+                arg, option_value(argc, argv, i));
+            if (options.hitchWindow <= 0.0)
+            {
+                throw std::runtime_error{"--hitch-window must be > 0"};
+            }
+        }
+        else if (arg == "--hitch-dir")
+        {
+            options.hitchDirectory = option_value(argc, argv, i);
+        }
+        else if (arg == "--delta-socket")
+        {
+            options.deltaSocket = option_value(argc, argv, i);
+        }
+        else if (arg == "--views")
+        {
+            options.views = option_count(arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--view-spacing")
+        {
+            options.viewSpacing = option_number(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--temporal-hints")
+        {
+            options.temporalHints = true;
+        }
+        else if (arg == "--scene-storage")
+        {
+            options.sceneStorage = parse_scene_storage(
+                option_value(argc, argv, i));
+        }
+        else if (arg == "--bench-output")
+        {
+            options.benchOutput = option_value(argc, argv, i);
+        }
+        else if (arg == "--bench-baseline")
+        {
+            options.benchBaseline = option_value(argc, argv, i);
+        }
+        else if (arg == "--bench-reference-samples")
+        {
+            options.benchReferenceSamples = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--bench-frames")
+        {
+            options.benchFrames = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--bench-tolerance")
+        {
+            options.benchTolerance = option_number(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--bench-max-elements")
+        {
+            options.benchMaxElements = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--camera-path")
+        {
+            options.cameraPath = option_value(argc, argv, i);
+        }
+        else if (arg == "--frames")
+        {
+            options.frames = option_count(arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--output")
+        {
+            options.outputPattern = option_value(argc, argv, i);
+        }
+        else if (arg == "--stream")
+        {
+            options.streamPath = option_value(argc, argv, i);
+        }
+        else if (arg == "--fps")
+        {
+            options.fps = option_count(arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--shm")
+        {
+            options.shmName = option_value(argc, argv, i);
+            if (options.shmName.empty() || options.shmName[0] != '/')
+            {
+                options.shmName = "/" + options.shmName;
+            }
+        }
+        else if (arg == "--shm-slots")
+        {
+            options.shmSlots = option_count(arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--tiled")
+        {
+            option_size(
+                arg, option_value(argc, argv, i), options.tiledWidth,
+                options.tiledHeight);
+        }
+        else if (arg == "--tile-size")
+        {
+            options.tileSize = option_count(arg, option_value(argc, argv, i));
+            if (options.tileSize % 16 != 0)
+            {
+                throw std::runtime_error{
+                    "--tile-size must be a multiple of 16"};
+            }
+        }
+        else if (arg == "--tiled-output")
+        {
+            options.tiledOutput = option_value(argc, argv, i);
+        }
+        else if (arg == "--progressive")
+        {
+            options.progressiveSamples = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--progressive-output")
+        {
+            options.progressiveOutput = option_value(argc, argv, i);
+        }
+        else if (arg == "--checkpoint")
+        {
+            options.checkpointPath = option_value(argc, argv, i);
+        }
+        else if (arg == "--checkpoint-interval")
+        {
+            options.checkpointInterval = option_number(
+                arg, option_value(argc, argv, i));
+            if (options.checkpointInterval <= 0.0)
+            {
+                throw std::runtime_error{"--checkpoint-interval must be > 0"};
+            }
+        }
+        else if (arg == "--resume")
+        {
+            options.resume = true;
+        }
+        else if (arg == "--bake-probes")
+        {
+            options.probesPath = option_value(argc, argv, i);
+        }
+        else if (arg == "--probe-size")
+        {
+            options.probeSize = option_count(
+                arg, option_value(argc, argv, i));
+            if (options.probeSize < 2)
+            {
+                throw std::runtime_error{"--probe-size must be at least 2"};
+            }
+        }
+        else if (arg == "--probe-output")
+        {
+            options.probeOutput = option_value(argc, argv, i);
+        }
+        else if (arg == "--jobs")
+        {
+            options.jobsPath = option_value(argc, argv, i);
+        }
+        else if (arg == "--jobs-output")
+        {
+            options.jobsOutput = option_value(argc, argv, i);
+        }
+        else if (arg == "--farm")
+        {
+            options.farmWorkers = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--farm-worker")
+        {
+            options.farmWorkerSocket = option_value(argc, argv, i);
+        }
+        else if (arg == "--sort-last")
+        {
+            options.sortLastWorkers = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--sort-last-worker")
+        {
+            options.sortLastWorkerSocket = option_value(argc, argv, i);
+        }
+        else if (arg == "--frame-pool")
+        {
+            options.framePoolWorkers = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--frame-pool-worker")
+        {
+            options.framePoolWorkerSocket = option_value(argc, argv, i);
+        }
+        else if (arg == "--frame-pool-chunk")
+        {
+            options.framePoolChunk = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--serve")
+        {
+            options.servePath = option_value(argc, argv, i);
+        }
+        else if (arg == "--serve-window")
+        {
+            options.serveWindow = option_number(
+                arg, option_value(argc, argv, i));
+            if (options.serveWindow < 0.0)
+            {
+                throw std::runtime_error{"--serve-window must be >= 0"};
+            }
+        }
+        else if (arg == "--serve-max-samples")
+        {
+            options.serveMaxSamples = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else if (arg == "--client")
+        {
+            options.clientPath = option_value(argc, argv, i);
+        }
+        else if (arg == "--writer-threads")
+        {
+            options.writerThreads = option_count(
+                arg, option_value(argc, argv, i));
+        }
+        else
+        {
+            throw std::runtime_error{"unknown option '" + arg + "'"};
+        }
+    }
+    if (options.views > 1 && !options.deltaSocket.empty())
+    {
+        throw std::runtime_error{
+            "--delta-socket streams a single view, it can't be used with"
+            " --views"};
+    }
+    // Patterns are expanded with snprintf, so anything but one frame
+    // number is undefined. The service client and a single tiled image
+    // write one file, which needn't be numbered.
+    check_frame_pattern(
+        "--output", options.outputPattern, !options.clientPath.empty());
+    check_frame_pattern("--tiled-output", options.tiledOutput, true);
+    check_frame_pattern("--jobs-output", options.jobsOutput, false);
+    if (!options.probeOutput.empty())
+    {
+        check_frame_pattern("--probe-output", options.probeOutput, false);
+    }
+    return options;
+}
+
+std::string usage(std::string const &program)
+{
+    return
+        "Usage: " + program + " [options]\n"
+        "\n"
+        "Options:\n"
+        "  -h, --help                 Show this message.\n"
+        "  --scene NAME               Built-in scene: demo, grid, random,"
+            " large.\n"
+        "                             (default demo; repeat to benchmark"
+            " several)\n"
+        "  --size WxH                 Render size. (default 640x480)\n"
+        "  --samples N                Rays per pixel. (default 1)\n"
+        "  --metrics-file PATH        Append JSON metrics lines to PATH.\n"
+        "  --metrics-interval SECS    Seconds between metrics lines."
+            " (default 1)\n"
+        "  --metrics-port PORT        Serve Prometheus metrics on"
+            " 127.0.0.1:PORT.\n"
+        "  --hitch-threshold MS       Dump a trace when a frame takes longer"
+            " than MS.\n"
+        "                             (default 100, 0 disables)\n"
+        "  --hitch-window SECS        Seconds of history in a hitch trace."
+            " (default 5)\n"
+        "  --hitch-dir DIR            Directory for hitch traces."
+            " (default .)\n"
+        "  --delta-socket PATH        Stream changed tiles to viewers on a"
+            " Unix\n"
+        "                             socket. (see compute-viewer)\n"
+        "  --views N                  Render N cameras side by side, spaced"
+            " along\n"
+        "                             the view's side vector. (default 1)\n"
+        "  --view-spacing D           Distance between cameras."
+            " (default 0.5)\n"
+        "  --temporal-hints           Test the sphere each pixel hit last"
+            " frame first.\n"
+        "  --scene-storage KIND       Where the shader reads the scene from:"
+            " ssbo, ubo,\n"
+        "                             tbo or auto (timed at startup), or"
+            " three of\n"
+        "                             them for spheres, materials and lights."
+            " (default ssbo)\n"
+        "\n"
+        "Render service:\n"
+        "  --serve PATH               Serve render requests on a Unix"
+            " socket.\n"
+        "  --serve-window MS          Time to gather requests into batches."
+            " (default 2)\n"
+        "  --serve-max-samples N      Reject requests for more rays per"
+            " pixel.\n"
+        "                             (default 64)\n"
+        "  --client PATH              Request --scene at --size from a"
+            " service and\n"
+        "                             write it to --output.\n"
+        "\n"
+        "Benchmark:\n"
+        "  --benchmark                Measure PSNR/SSIM and frame time of"
+            " each sample\n"
+        "                             count and resolution scale against"
+            " converged\n"
+        "                             references, and report Pareto"
+            " frontiers.\n"
+        "  --bench-output PATH        Write results as CSV to PATH."
+            " (default stdout)\n"
+        "  --bench-baseline PATH      Fail if PSNR regressed against an"
+            " earlier CSV.\n"
+        "  --bench-tolerance DB       Allowed PSNR drop. (default 0.1)\n"
+        "  --bench-reference-samples N\n"
+        "                             Rays per pixel of references."
+            " (default 256)\n"
+        "  --bench-frames N           Frames timed per configuration."
+            " (default 10)\n"
+        "  --bench-primitives         Check the GPU scan, reduce, compact,"
+            " histogram\n"
+        "                             and radix sort against the CPU and"
+            " measure\n"
+        "                             their speed against a buffer copy.\n"
+        "  --bench-max-elements N     Largest array size of"
+            " --bench-primitives.\n"
+        "                             (default 16777216)\n"
+        "  --bench-scene-edits        Render --frames versions of a scene"
+            " edited on\n"
+        "                             another thread, checking each uploads"
+            " only the\n"
+        "                             chunks that changed. (default 300,"
+            " scene large)\n"
+        "\n"
+        "Batch rendering:\n"
+        "  --batch                    Render frames offscreen to numbered"
+            " images.\n"
+        "  --camera-path PATH         Camera keyframes, one per line:\n"
+        "                             TIME PX PY PZ TX TY TZ [FOV]\n"
+        "  --frames N                 Frames spread evenly over the path.\n"
+        "                             (default one per keyframe)\n"
+        "  --output PATTERN           printf pattern for image paths;"
+            " .ppm, .png\n"
+        "                             or .exr. (default frame%05d.ppm)\n"
+        "  --writer-threads N         Threads encoding images."
+            " (default one per core)\n"
+        "  --stream PATH              Stream Y4M video to PATH (a file,"
+            " named pipe,\n"
+        "                             or - for stdout) instead of writing"
+            " images.\n"
+        "  --fps N                    Frame rate of streamed video."
+            " (default 30)\n"
+        "  --shm NAME                 Publish frames to shared memory"
+            " /dev/shm/NAME.\n"
+        "  --shm-slots N              Frames kept in shared memory."
+            " (default 4)\n"
+        "  --sort-last N              Split the scene between N worker"
+            " processes\n"
+        "                             (a power of two) and depth-composite"
+            " their\n"
+        "                             images. Writes .ppm or .png only,"
+            " at\n"
+        "                             --samples 1.\n"
+        "  --frame-pool N             Share the frames between N worker"
+            " processes,\n"
+        "                             each writing its own images.\n"
+        "  --frame-pool-chunk N       Frames handed to a worker at a time."
+            " (default 1)\n"
+        "\n"
+        "Tiled rendering:\n"
+        "  --tiled WxH                Render a WxH image in tiles, for sizes"
+            " beyond\n"
+        "                             the GPU's texture limits.\n"
+        "  --tile-size N              Tile width and height, a multiple of"
+            " 16.\n"
+        "                             (default 512)\n"
+        "  --tiled-output PATH        Tiled BigTIFF to write."
+            " (default render.tif)\n"
+        "  --farm N                   Share the tiles between N worker"
+            " processes.\n"
+        "                             Renders --frames frames along"
+            " --camera-path;\n"
+        "                             --tiled-output may be a printf"
+            " pattern.\n"
+        "\n"
+        "Progressive rendering:\n"
+        "  --progressive N            Accumulate N samples per pixel,"
+            " --samples per\n"
+        "                             pass.\n"
+        "  --progressive-output PATH  Final image: .ppm, .png or .exr."
+            " (default\n"
+        "                             progressive.png)\n"
+        "  --checkpoint PATH          Checkpoint file."
+            " (default render.ckpt)\n"
+        "  --checkpoint-interval SECS Seconds between checkpoints."
+            " (default 60)\n"
+        "  --resume                   Continue from the checkpoint if it"
+            " matches.\n"
+        "\n"
+        "Probe baking:\n"
+        "  --bake-probes PATH         Bake a cube map at each X Y Z line of"
+            " PATH.\n"
+        "  --probe-size N             Face width and height. (default 64)\n"
+        "  --probe-output PATTERN     printf pattern for images of each"
+            " probe's\n"
+        "                             faces, side by side. (default none)\n"
+        "\n"
+        "Job batches:\n"
+        "  --jobs PATH                Render each job in PATH, one per line:\n"
+        "                             W H PX PY PZ TX TY TZ\n"
+        "                             [FOV [SPHERE COUNT [LIGHT COUNT]]]\n"
+        "  --jobs-output PATTERN      printf pattern for atlas images.\n"
+        "                             (default atlas%03d.png)\n";
+}
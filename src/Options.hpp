@@ -0,0 +1,172 @@
+/**
+ * Options.hpp - Command-line options.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OPTIONS_HPP
+#define _OPTIONS_HPP
+
+#include "SceneStorage.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Options parsed from the command line.
+ *  program - Path the program was run as, for starting worker processes.
+ *  help - Print usage and exit.
+ *  benchmark - Run the quality-versus-time benchmark instead of the viewer.
+ *  benchPrimitives - Test and time the GPU primitives instead of the viewer.
+ *  benchSceneEdits - Check and time live scene edits instead of the viewer.
+ *  batch - Render frames offscreen to image files instead of the viewer.
+ *  scenes - Built-in scenes to use. (The viewer uses the first)
+ *  width, height - Render size.
+ *  samples - Rays per pixel.
+ *  metricsFile - File to append JSON metrics snapshots to. (Empty = off)
+ *  metricsInterval - Seconds between metrics snapshots.
+ *  metricsPort - Localhost port serving Prometheus metrics. (0 = off)
+ *  hitchThreshold - Frame time (ms) that dumps the flight recorder. (0 = off)
+ *  hitchWindow - Seconds of history in a flight recorder dump.
+ *  hitchDirectory - Where flight recorder dumps are written.
+ *  deltaSocket - Unix socket to stream changed tiles to viewers on.
+ *                (Empty = off)
+ *  views - Cameras the viewer renders side by side in one dispatch.
+ *  viewSpacing - Distance between neighbouring views' eyes.
+ *  temporalHints - Test the sphere each pixel hit last frame first.
+ *  sceneStorage - Storage backend of each scene array. (STORAGE_AUTO ones
+ *                 are timed at startup)
+ *  benchOutput - CSV file for benchmark results. (Empty = stdout)
+ *  benchBaseline - Earlier benchmark CSV to check for regressions against.
+ *  benchReferenceSamples - Rays per pixel of the benchmark references.
+ *  benchFrames - Frames timed per benchmark configuration.
+ *  benchTolerance - PSNR drop (dB) from the baseline counted as a regression.
+ *  benchMaxElements - Largest array size of the primitives benchmark.
+ *  cameraPath - Camera keyframe file for batch rendering. (Empty = static)
+ *  frames - Frames to batch render. (0 = one per keyframe)
+ *  outputPattern - printf pattern of batch image paths, given frame number.
+ *                  The extension picks the format: .ppm, .png or .exr.
+ *  writerThreads - Threads encoding batch images. (0 = one per core)
+ *  streamPath - Stream batch frames as Y4M video here instead of writing
+ *               images. ("-" = stdout, empty = off)
+ *  fps - Frame rate written to the Y4M header.
+ *  shmName - Publish batch frames to a shared memory ring with this name.
+ *            (Empty = off)
+ *  shmSlots - Frame slots in the shared memory ring.
+ *  tiledWidth, tiledHeight - Size of a tiled render. (0 = off)
+ *  tileSize - Width and height of tiles, a multiple of 16.
+ *  tiledOutput - Tiled TIFF written by a tiled render.
+ *  progressiveSamples - Samples per pixel of a progressive render. (0 = off)
+ *  progressiveOutput - Image written when a progressive render finishes.
+ *  checkpointPath - Progressive render checkpoint file.
+ *  checkpointInterval - Seconds between checkpoints.
+ *  resume - Continue from the checkpoint, if it matches the render.
+ *  probesPath - File of probe positions to bake cube maps at. (Empty = off)
+ *  probeSize - Width and height of each probe face.
+ *  probeOutput - printf pattern of probe image paths, given probe number.
+ *                (Empty = don't write)
+ *  jobsPath - File of small renders to batch into atlases. (Empty = off)
+ *  jobsOutput - printf pattern of atlas image paths, given atlas number.
+ *  farmWorkers - Worker processes sharing a tiled render. (0 = off)
+ *  farmWorkerSocket - Run as a tile farm worker for the coordinator on
+ *                     this socket. (Empty = off)
+ *  sortLastWorkers - Worker processes sharing the scene's spheres, a power
+ *                    of two. (0 = off)
+ *  sortLastWorkerSocket - Run as a sort-last worker for the coordinator on
+ *                         this socket. (Empty = off)
+ *  framePoolWorkers - Worker processes sharing a batch's frames. (0 = off)
+ *  framePoolWorkerSocket - Run as a frame pool worker for the coordinator
+ *                          on this socket. (Empty = off)
+ *  framePoolChunk - Frames handed to a frame pool worker at a time.
+ *  servePath - Unix socket to serve render requests on. (Empty = off)
+ *  serveWindow - Milliseconds to gather requests into a batch.
+ *  serveMaxSamples - Most rays per pixel a service request may ask for.
+ *  clientPath - Send one render request to the service on this socket.
+ *               (Empty = off)
+ */
+struct Options
+{
+    std::string program;
+    bool help;
+    bool benchmark;
+    bool benchPrimitives;
+    bool benchSceneEdits;
+    bool batch;
+    std::vector<std::string> scenes;
+    unsigned width, height;
+    unsigned samples;
+    std::string metricsFile;
+    double metricsInterval;
+    unsigned short metricsPort;
+    double hitchThreshold;
+    double hitchWindow;
+    std::string hitchDirectory;
+    std::string deltaSocket;
+    unsigned views;
+    double viewSpacing;
+    bool temporalHints;
+    SceneStorageConfig sceneStorage;
+    std::string benchOutput;
+    std::string benchBaseline;
+    unsigned benchReferenceSamples;
+    unsigned benchFrames;
+    double benchTolerance;
+    unsigned benchMaxElements;
+    std::string cameraPath;
+    unsigned frames;
+    std::string outputPattern;
+    unsigned writerThreads;
+    std::string streamPath;
+    unsigned fps;
+    std::string shmName;
+    unsigned shmSlots;
+    unsigned tiledWidth, tiledHeight;
+    unsigned tileSize;
+    std::string tiledOutput;
+    unsigned progressiveSamples;
+    std::string progressiveOutput;
+    std::string checkpointPath;
+    double checkpointInterval;
+    bool resume;
+    std::string probesPath;
+    unsigned probeSize;
+    std::string probeOutput;
+    std::string jobsPath;
+    std::string jobsOutput;
+    unsigned farmWorkers;
+    std::string farmWorkerSocket;
+    unsigned sortLastWorkers;
+    std::string sortLastWorkerSocket;
+    unsigned framePoolWorkers;
+    std::string framePoolWorkerSocket;
+    unsigned framePoolChunk;
+    std::string servePath;
+    double serveWindow;
+    unsigned serveMaxSamples;
+    std::string clientPath;
+
+    Options();
+};
+
+
+/** Parse the command line. Throws on invalid arguments. */
+Options parse_options(int argc, char *argv[]);
+
+/** Get the usage message. */
+std::string usage(std::string const &program);
+
+
+#endif
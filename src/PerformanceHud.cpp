@@ -0,0 +1,104 @@
+/**
+ * PerformanceHud.cpp - On-screen performance overlay.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PerformanceHud.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+
+PerformanceHud::PerformanceHud()
+:   _hud{
+        {   shader_from_file("shaders/hud.vert", GL_VERTEX_SHADER),
+            shader_from_file("shaders/hud.frag", GL_FRAGMENT_SHADER)},
+        "HudShader"}
+,   _emptyVAO{"HudVAO"}
+,   _timer{"HudTimer"}
+,   _history(_historySize, 0.0f)
+,   _historyHead{0}
+,   _text(_columns * _lines / 4, 0)
+,   enabled{false}
+,   scale{2}
+,   graphMax{50.0f}
+,   graphTarget{1000.0f / 60.0f}
+{
+}
+
+void PerformanceHud::addFrame(double ms)
+{
+    // _historyHead is the oldest sample, so it's the one to overwrite.
+    _history[_historyHead] = (GLfloat)ms;
+    _historyHead = (_historyHead + 1) % _historySize;
+}
+
+void PerformanceHud::setText(std::vector<std::string> const &lines)
+{
+    std::fill(_text.begin(), _text.end(), 0);
+    for (size_t y = 0; y < lines.size() && y < _lines; ++y)
+    {
+        for (size_t x = 0; x < lines[y].size() && x < _columns; ++x)
+        {
+            // The font only has ASCII 32-95, so fold lowercase to uppercase.
+            GLuint const c = (GLuint)std::toupper(
+                (unsigned char)lines[y][x]);
+            size_t const i = y * _columns + x;
+            _text[i / 4] |= (c & 0xFF) << (8 * (i % 4));
+        }
+    }
+}
+
+double PerformanceHud::gpuTime() const
+{
+    return _timer.last();
+}
+
+void PerformanceHud::draw(int windowWidth, int windowHeight)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    double ms = 0.0;
+    _timer.poll(ms);
+    _timer.begin();
+
+    int const width = ((int)_columns * _cellWidth + 2 * _margin) * scale;
+    int const height = (
+        ((int)_lines * _cellHeight + _graphHeight + 3 * _margin) * scale);
+    // Restrict drawing to the top-left corner of the window.
+    glViewport(0, windowHeight - height, width, height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    _hud.use();
+    _emptyVAO.bind();
+    _hud.setUniformS("history", _history);
+    _hud.setUniformS("historyHead", (GLint)_historyHead);
+    _hud.setUniformS("graphMax", graphMax);
+    _hud.setUniformS("graphTarget", graphTarget);
+    _hud.setUniformS("text", _text);
+    _hud.setUniformS("hudSize", glm::ivec2{width, height});
+    _hud.setUniformS("scale", (GLint)scale);
+    ++gl_call_count;
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    _emptyVAO.unbind();
+
+    glDisable(GL_BLEND);
+    glViewport(0, 0, windowWidth, windowHeight);
+    _timer.end();
+}
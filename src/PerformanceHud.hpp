@@ -0,0 +1,75 @@
+/**
+ * PerformanceHud.hpp - On-screen performance overlay.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PERFORMANCE_HUD_HPP
+#define _PERFORMANCE_HUD_HPP
+
+#include "glUtil.hpp"
+#include "GPUTimer.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Draws a frame-time graph and a block of stats text over the top-left
+ * corner of the screen. Everything is drawn by one small fragment pass, so
+ * this should be called after RenderResultDisplay::draw().
+ */
+class PerformanceHud
+{
+private:
+    // NOTE: These must match the defines in hud.frag.
+    static size_t const _historySize = 128;
+    static size_t const _columns = 28;
+    static size_t const _lines = 9;
+    static int const _cellWidth = 6;
+    static int const _cellHeight = 9;
+    static int const _graphHeight = 48;
+    static int const _margin = 2;
+
+    Program const _hud;
+    VertexArray const _emptyVAO;
+    GPUTimer _timer;
+    std::vector<GLfloat> _history;
+    size_t _historyHead;
+    std::vector<GLuint> _text;
+public:
+    bool enabled;
+    /** Integer pixel scale of the HUD. */
+    int scale;
+    /** Frame time at the top of the graph, in milliseconds. */
+    GLfloat graphMax;
+    /** Frame time budget, drawn as a line on the graph, in milliseconds. */
+    GLfloat graphTarget;
+
+    PerformanceHud();
+
+    /** Add a frame time (in milliseconds) to the graph. */
+    void addFrame(double ms);
+    /** Set the stats text. Lines are truncated to fit. */
+    void setText(std::vector<std::string> const &lines);
+    /** GPU time taken by the HUD itself, in milliseconds. */
+    double gpuTime() const;
+
+    /** Draw the HUD over the current framebuffer. */
+    void draw(int windowWidth, int windowHeight);
+};
+
+
+#endif
@@ -0,0 +1,379 @@
+/**
+ * PrimitivesBench.cpp - Correctness and bandwidth of the GPU primitives.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PrimitivesBench.hpp"
+#include "App.hpp"
+#include "GPUPrimitives.hpp"
+#include "GPURadixSort.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+
+
+/** Bytes moved by timed runs of each size, to keep timings stable. */
+static double const BENCH_BYTES = 1 << 28;
+
+
+/**
+ * A primitive being measured.
+ *  name - Name in the CSV.
+ *  run - Queue the operation.
+ *  check - Read back the results and compare them with the CPU's.
+ *  bytes - Least memory traffic the operation needs.
+ *  reset - Restore inputs the operation overwrites, untimed. (Optional)
+ */
+struct PrimitiveCase
+{
+    std::string name;
+    std::function<void()> run;
+    std::function<bool()> check;
+    double bytes;
+    std::function<void()> reset;
+};
+
+
+/** Make a storage buffer of `count` GLuints, optionally filled. */
+static Buffer make_buffer(
+    std::string const &label, size_t count,
+    std::vector<GLuint> const &data={})
+{
+    Buffer buffer{GL_SHADER_STORAGE_BUFFER, label};
+    buffer.bind();
+    ++gl_call_count;
+    glBufferData(
+        buffer.target, std::max<size_t>(count, 1) * sizeof(GLuint),
+        data.empty()? nullptr : data.data(), GL_DYNAMIC_COPY);
+    buffer.unbind();
+    return buffer;
+}
+
+/** Read back the first `count` GLuints of a buffer. */
+static std::vector<GLuint> read_buffer(Buffer const &buffer, size_t count)
+{
+    std::vector<GLuint> data(count);
+    buffer.bind();
+    ++gl_call_count;
+    glGetBufferSubData(
+        buffer.target, 0, count * sizeof(GLuint), data.data());
+    buffer.unbind();
+    return data;
+}
+
+/** Copy `bytes` from the start of one buffer to another. */
+static void copy_buffer(Buffer const &from, Buffer const &to, size_t bytes)
+{
+    gl_call_count += 3;
+    glBindBuffer(GL_COPY_READ_BUFFER, from.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, to.id());
+    glCopyBufferSubData(
+        GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+}
+
+/**
+ * Milliseconds per run of `run`, over `reps` runs. With `reset`, each run
+ * is timed on its own so resets aren't counted.
+ */
+static double time_gpu(
+    std::function<void()> const &run, unsigned reps,
+    std::function<void()> const &reset=nullptr)
+{
+    Query const query{GL_TIME_ELAPSED, "PrimitivesQuery"};
+    if (!reset)
+    {
+        query.begin();
+        for (unsigned i = 0; i < reps; ++i)
+        {
+            run();
+        }
+        query.end();
+        return query.result() / 1.0e6 / reps;
+    }
+    double ns = 0.0;
+    for (unsigned i = 0; i < reps; ++i)
+    {
+        reset();
+        query.begin();
+        run();
+        query.end();
+        ns += query.result();
+    }
+    return ns / 1.0e6 / reps;
+}
+
+
+int run_primitives_benchmark(Options const &options)
+{
+    init_SDL();
+    App app{"compute primitives", 64, 64, false};
+    GPUPrimitives primitives{};
+    std::vector<GPURadixSort> sorters{};
+    for (auto const &config : GPURadixSort::CONFIGS)
+    {
+        sorters.emplace_back(config);
+    }
+
+    GLint64 max_block = 0;
+    ++gl_call_count;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &max_block);
+    size_t const max_elements = std::min<size_t>(
+        options.benchMaxElements, max_block / sizeof(GLuint));
+    std::vector<size_t> sizes{};
+    for (size_t n = 1024; n < max_elements; n *= 4)
+    {
+        sizes.push_back(n);
+    }
+    sizes.push_back(max_elements);
+
+    std::ofstream file{};
+    if (!options.benchOutput.empty())
+    {
+        file.open(options.benchOutput.c_str());
+        if (!file)
+        {
+            throw std::runtime_error{
+                "failed to open '" + options.benchOutput + "'"};
+        }
+    }
+    std::ostream &out = options.benchOutput.empty()? std::cout : file;
+    out << "primitive,elements,ms,elements_per_s,gb_per_s,copy_gb_per_s,"
+        "fraction_of_copy,correct\n";
+
+    std::mt19937 random{1234};
+    int failures = 0;
+    for (size_t const n : sizes)
+    {
+        GLuint const count = (GLuint)n;
+        std::vector<GLuint> values(n);
+        std::vector<GLuint> flags(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            values[i] = random();
+            flags[i] = random() % 2 == 0? 0 : random();
+        }
+        Buffer const input = make_buffer("BenchInput", n, values);
+        Buffer const flag_input = make_buffer("BenchFlags", n, flags);
+        Buffer const output = make_buffer("BenchOutput", n);
+        Buffer const kept = make_buffer("BenchKept", 1);
+
+        // The baseline: copying the input, reading and writing every byte.
+        auto const copy = [&](){
+            copy_buffer(input, output, n * sizeof(GLuint));
+        };
+        unsigned const reps = (unsigned)std::max(
+            3.0, std::min(1000.0, BENCH_BYTES / (n * 8.0)));
+        copy();
+        double const copy_gbps =
+            n * 8.0 / (time_gpu(copy, reps) / 1000.0) / 1.0e9;
+
+        std::vector<PrimitiveCase> cases{};
+        cases.push_back(PrimitiveCase{
+            "scan",
+            [&](){ primitives.scan(input, output, count); },
+            [&](){
+                auto const gpu = read_buffer(output, n);
+                GLuint sum = 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (gpu[i] != sum)
+                    {
+                        return false;
+                    }
+                    sum += values[i];
+                }
+                return true;
+            },
+            n * 8.0, nullptr});
+        for (auto const op : {
+                GPUPrimitives::REDUCE_ADD, GPUPrimitives::REDUCE_MIN,
+                GPUPrimitives::REDUCE_MAX})
+        {
+            static char const *const names[] = {
+                "reduce_add", "reduce_min", "reduce_max"};
+            cases.push_back(PrimitiveCase{
+                names[op],
+                [&, op](){ primitives.reduce(input, output, count, op); },
+                [&, op](){
+                    GLuint expected = values[0];
+                    for (size_t i = 1; i < n; ++i)
+                    {
+                        expected = (
+                            op == GPUPrimitives::REDUCE_ADD?
+                                expected + values[i]
+                            : op == GPUPrimitives::REDUCE_MIN?
+                                std::min(expected, values[i])
+                            : std::max(expected, values[i]));
+                    }
+                    return read_buffer(output, 1)[0] == expected;
+                },
+                n * 4.0, nullptr});
+        }
+        size_t const kept_count =
+            n - std::count(flags.begin(), flags.end(), 0u);
+        cases.push_back(PrimitiveCase{
+            "compact",
+            [&](){
+                primitives.compact(input, flag_input, output, kept, count);
+            },
+            [&](){
+                if (read_buffer(kept, 1)[0] != kept_count)
+                {
+                    return false;
+                }
+                auto const gpu = read_buffer(output, kept_count);
+                size_t j = 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (flags[i] != 0 && gpu[j++] != values[i])
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            },
+            n * 8.0 + kept_count * 4.0, nullptr});
+        cases.push_back(PrimitiveCase{
+            "histogram256",
+            [&](){ primitives.histogram(input, output, count, 256, 8); },
+            [&](){
+                std::vector<GLuint> expected(256, 0);
+                for (GLuint const value : values)
+                {
+                    ++expected[(value >> 8) & 255];
+                }
+                return read_buffer(output, 256) == expected;
+            },
+            n * 4.0, nullptr});
+
+
+        // Radix sorts, under every configuration. Keys are random, and
+        // values are their original positions, so stability is checked too.
+        std::vector<GLuint> wide_keys(n * 2);
+        for (GLuint &word : wide_keys)
+        {
+            word = random();
+        }
+        bool const wide_fits = n * 8 <= (size_t)max_block;
+        Buffer const wide_input = make_buffer(
+            "BenchWideKeys", wide_fits? n * 2 : 1,
+            wide_fits? wide_keys : std::vector<GLuint>{});
+        Buffer const wide_output = make_buffer(
+            "BenchWideOutput", wide_fits? n * 2 : 1);
+        std::vector<GLuint> indices(n);
+        std::iota(indices.begin(), indices.end(), 0u);
+        Buffer const index_input = make_buffer("BenchIndices", n, indices);
+        Buffer const index_output = make_buffer("BenchIndexOutput", n);
+        std::vector<GLuint> sorted{values};
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<GLuint> order{indices};
+        std::stable_sort(
+            order.begin(), order.end(),
+            [&wide_keys](GLuint a, GLuint b){
+                uint64_t const ka =
+                    wide_keys[a * 2] | (uint64_t)wide_keys[a * 2 + 1] << 32;
+                uint64_t const kb =
+                    wide_keys[b * 2] | (uint64_t)wide_keys[b * 2 + 1] << 32;
+                return ka < kb;
+            });
+        for (auto &sorter : sorters)
+        {
+            GPURadixSort::Config const config = sorter.config();
+            std::string const suffix =
+                "_d" + std::to_string(config.digitBits)
+                + "_g" + std::to_string(config.groupSize);
+            cases.push_back(PrimitiveCase{
+                "sort32" + suffix,
+                [&](){ sorter.sort(output, count); },
+                [&](){ return read_buffer(output, n) == sorted; },
+                n * 8.0,
+                [&](){ copy_buffer(input, output, n * sizeof(GLuint)); }});
+            if (!wide_fits)
+            {
+                continue;
+            }
+            cases.push_back(PrimitiveCase{
+                "sort64_pairs" + suffix,
+                [&](){ sorter.sort64(wide_output, count, &index_output); },
+                [&](){
+                    auto const keys = read_buffer(wide_output, n * 2);
+                    if (read_buffer(index_output, n) != order)
+                    {
+                        return false;
+                    }
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        if (keys[i * 2] != wide_keys[order[i] * 2]
+                            || keys[i * 2 + 1] != wide_keys[order[i] * 2 + 1])
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                },
+                n * 24.0,
+                [&](){
+                    copy_buffer(wide_input, wide_output, n * 8);
+                    copy_buffer(index_input, index_output, n * 4);
+                }});
+        }
+
+        std::map<std::string, std::pair<std::string, double>> fastest{};
+        for (auto const &c : cases)
+        {
+            if (c.reset)
+            {
+                c.reset();
+            }
+            c.run();
+            bool const correct = c.check();
+            double const ms = time_gpu(c.run, reps, c.reset);
+            double const gbps = c.bytes / (ms / 1000.0) / 1.0e9;
+            out << c.name << "," << n << "," << ms << ","
+                << n / (ms / 1000.0) << "," << gbps << "," << copy_gbps
+                << "," << gbps / copy_gbps << "," << (correct? 1 : 0) << "\n";
+            if (!correct)
+            {
+                std::cerr << "WRONG RESULT: " << c.name << " of " << n
+                    << " elements\n";
+                ++failures;
+            }
+            // Track the best configuration of each sort.
+            size_t const tuned = c.name.find("_d");
+            if (tuned != std::string::npos)
+            {
+                auto &best = fastest[c.name.substr(0, tuned)];
+                if (best.first.empty() || ms < best.second)
+                {
+                    best = std::make_pair(c.name.substr(tuned + 1), ms);
+                }
+            }
+        }
+        std::clog << n << " elements: copy " << copy_gbps << " GB/s\n";
+        for (auto const &best : fastest)
+        {
+            std::clog << "  fastest " << best.first << ": "
+                << best.second.first << ", "
+                << n / (best.second.second / 1000.0) / 1.0e6 << " Mkeys/s\n";
+        }
+    }
+    return failures == 0? EXIT_SUCCESS : EXIT_FAILURE;
+}
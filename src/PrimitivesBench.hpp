@@ -0,0 +1,37 @@
+/**
+ * PrimitivesBench.hpp - Correctness and bandwidth of the GPU primitives.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PRIMITIVESBENCH_HPP
+#define _PRIMITIVESBENCH_HPP
+
+#include "Options.hpp"
+
+
+/**
+ * Check every GPUPrimitives operation, and GPURadixSort under each of its
+ * configurations, against a CPU version on random data, at sizes from 1K
+ * elements up to `options.benchMaxElements`. Each is timed in elements per
+ * second, and against a GPU buffer copy of the same data as a memcpy-speed
+ * baseline. Writes a CSV to `options.benchOutput` (or stdout), and returns
+ * EXIT_FAILURE if any result was wrong.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_primitives_benchmark(Options const &options);
+
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * ProbeBake.cpp - Baking cube map environment probes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ProbeBake.hpp"
+#include "App.hpp"
+#include "Batch.hpp"
+#include "ComputeRaytraceRenderer.hpp"
+#include "FrameReader.hpp"
+#include "ImageFile.hpp"
+#include "ImageWriter.hpp"
+#include "Scenes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+
+/** Most bytes of RGBA32F faces one dispatch bakes into, ie. 256 MiB. */
+static uint64_t const PROBE_BATCH_BYTES = 256ull << 20;
+
+
+std::vector<glm::vec3> load_probe_positions(std::string const &path)
+{
+    std::ifstream in{path.c_str()};
+    if (!in)
+    {
+        throw std::runtime_error{"failed to open probe file '" + path + "'"};
+    }
+    std::vector<glm::vec3> positions{};
+    std::string line{};
+    for (size_t number = 1; std::getline(in, line); ++number)
+    {
+        size_t const first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields{line};
+        glm::vec3 position{};
+        fields >> position.x >> position.y >> position.z;
+        if (!fields)
+        {
+            throw std::runtime_error{
+                path + ":" + std::to_string(number) + ": expected X Y Z"};
+        }
+        positions.push_back(position);
+    }
+    if (positions.empty())
+    {
+        throw std::runtime_error{"probe file '" + path + "' is empty"};
+    }
+    return positions;
+}
+
+
+int run_probe_bake(Options const &options)
+{
+    bool const writing = !options.probeOutput.empty();
+    ImageFormat const format = writing?
+        image_format_from_path(options.probeOutput) : IMAGE_PPM;
+    std::vector<glm::vec3> const positions = load_probe_positions(
+        options.probesPath);
+    GLuint const size = options.probeSize;
+
+    init_SDL();
+    App app{"compute probes", (int)size, (int)size, false};
+    app.setVSync(false);
+
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    ComputeRaytraceRenderer renderer{setup.scene, size, size};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+    // Large faces would make the cube map array too big for one dispatch
+    // long before maxProbes() is reached.
+    uint64_t const probe_bytes = 6ull * size * size * 4 * sizeof(GLfloat);
+    GLuint const batch = (GLuint)std::max<uint64_t>(
+        1, std::min<uint64_t>(
+            renderer.maxProbes(), PROBE_BATCH_BYTES / probe_bytes));
+
+    // To be written, each probe's faces are copied side by side into a
+    // strip, +X first, which is converted and read back like a batch frame
+    // while the next probe is copied.
+    Texture strip{GL_TEXTURE_2D, "ProbeStrip"};
+    ++gl_call_count;
+    glTexImage2D(
+        strip.type(), 0, GL_RGBA32F, 6 * size, size, 0, GL_RGBA, GL_FLOAT,
+        nullptr);
+    strip.unbind();
+    FrameReader reader{};
+    std::unique_ptr<ImageWriter> writer{};
+    if (writing)
+    {
+        writer.reset(new ImageWriter{options.writerThreads});
+    }
+    FrameReader::Frame done{};
+    auto const hand_off = [&](){
+        unsigned const tag = done.tag;
+        writer->write(
+            frame_path(options.probeOutput, tag), format, std::move(done));
+    };
+
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t first = 0; first < positions.size(); first += batch)
+    {
+        size_t const last = std::min<size_t>(
+            first + batch, positions.size());
+        renderer.bakeProbes(
+            {positions.begin() + first, positions.begin() + last}, size);
+        std::clog << "\rProbe " << last << "/" << positions.size()
+            << std::flush;
+        if (!writing)
+        {
+            continue;
+        }
+        for (size_t i = first; i < last; ++i)
+        {
+            for (GLint face = 0; face < 6; ++face)
+            {
+                ++gl_call_count;
+                glCopyImageSubData(
+                    renderer.getProbeResults().id(),
+                    GL_TEXTURE_CUBE_MAP_ARRAY, 0,
+                    0, 0, 6 * (GLint)(i - first) + face,
+                    strip.id(), GL_TEXTURE_2D, 0,
+                    face * (GLint)size, 0, 0,
+                    size, size, 1);
+            }
+            if (reader.full() && reader.collect(done, true))
+            {
+                hand_off();
+            }
+            reader.read(
+                strip, 6 * size, size, image_format_layout(format),
+                (unsigned)i);
+            while (reader.collect(done))
+            {
+                hand_off();
+            }
+        }
+    }
+    if (writer)
+    {
+        while (reader.collect(done, true))
+        {
+            hand_off();
+        }
+        writer->finish();
+    }
+    else
+    {
+        ++gl_call_count;
+        glFinish();
+    }
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::clog << "\n";
+
+    std::cout << positions.size() << " probes (6x" << size << "x" << size
+        << ") in " << seconds << " s: " << positions.size() / seconds
+        << " probes/s, up to " << batch << " per dispatch\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/**
+ * ProbeBake.hpp - Baking cube map environment probes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROBEBAKE_HPP
+#define _PROBEBAKE_HPP
+
+#include "glUtil.hpp"
+#include "Options.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Load probe positions. Probe files have one "X Y Z" position per line;
+ * blank lines and lines starting with '#' are ignored. Throws on I/O or
+ * syntax errors.
+ */
+std::vector<glm::vec3> load_probe_positions(std::string const &path);
+
+/**
+ * Bake a cube map at every probe position in a file, as many per dispatch
+ * as the GPU allows, and report probes per second. Each probe is
+ * optionally written out as a strip of its six faces.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_probe_bake(Options const &options);
+
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * Process.cpp - Child processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Process.hpp"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+
+void _process_reap(int *pid)
+{
+#ifndef _WIN32
+    if (*pid > 0)
+    {
+        kill(*pid, SIGTERM);
+        while (waitpid(*pid, nullptr, 0) == -1 && errno == EINTR)
+        {
+        }
+    }
+#endif
+    delete pid;
+}
+
+
+Process::Process()
+:   _pid{new int{-1}, _process_reap}
+{
+}
+
+Process Process::spawn(
+    std::string const &program, std::vector<std::string> const &args)
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Process::spawn - not supported on Windows"};
+#else
+    std::vector<char *> argv{};
+    argv.push_back(const_cast<char *>(program.c_str()));
+    for (auto const &arg : args)
+    {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    pid_t pid = -1;
+    int const err = posix_spawnp(
+        &pid, program.c_str(), nullptr, nullptr, argv.data(), environ);
+    if (err != 0)
+    {
+        throw std::runtime_error{
+            "posix_spawnp(" + program + ") - " + std::strerror(err)};
+    }
+    Process process{};
+    *process._pid = (int)pid;
+    return process;
+#endif
+}
+
+int Process::current()
+{
+#ifdef _WIN32
+    return -1;
+#else
+    return (int)getpid();
+#endif
+}
+
+int Process::pid() const
+{
+    return *_pid;
+}
+
+bool Process::running() const
+{
+#ifdef _WIN32
+    return false;
+#else
+    if (*_pid <= 0)
+    {
+        return false;
+    }
+    int status = 0;
+    pid_t const r = waitpid(*_pid, &status, WNOHANG);
+    if (r == *_pid)
+    {
+        // Reaped, so the pid can't be waited on again.
+        *_pid = -1;
+        return false;
+    }
+    return r == 0;
+#endif
+}
+
+int Process::wait()
+{
+#ifdef _WIN32
+    return -1;
+#else
+    if (*_pid <= 0)
+    {
+        return -1;
+    }
+    int status = 0;
+    while (waitpid(*_pid, &status, 0) == -1)
+    {
+        if (errno != EINTR)
+        {
+            *_pid = -1;
+            return -1;
+        }
+    }
+    *_pid = -1;
+    return WIFEXITED(status)? WEXITSTATUS(status) : -1;
+#endif
+}
+
+void Process::terminate() const
+{
+#ifndef _WIN32
+    if (*_pid > 0)
+    {
+        kill(*_pid, SIGTERM);
+    }
+#endif
+}
@@ -0,0 +1,70 @@
+/**
+ * Process.hpp - Child processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROCESS_HPP
+#define _PROCESS_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/** Deleter for Process objects. (For use with shared_ptr and co.) */
+void _process_reap(int *pid);
+
+
+/**
+ * Child process running a program. Only available on POSIX systems; on
+ * other platforms spawn() throws. A child still running when the last copy
+ * is destroyed is terminated and waited for.
+ */
+class Process
+{
+private:
+    std::shared_ptr<int> _pid;
+public:
+    /** No process. */
+    Process();
+
+    /**
+     * Start `program` (searched for on PATH if it has no slashes) with the
+     * given arguments, not including argv[0]. The child shares this
+     * process's working directory and standard streams.
+     */
+    static Process spawn(
+        std::string const &program, std::vector<std::string> const &args);
+
+    /** Get the id of the calling process, or -1 if unsupported. */
+    static int current();
+
+    /** Get the process id, or -1 if there's no process. */
+    int pid() const;
+    /** Check if the process hasn't exited yet. */
+    bool running() const;
+
+    /**
+     * Wait for the process to exit. Returns its exit status, or -1 if it
+     * was killed by a signal.
+     */
+    int wait();
+    /** Ask the process to stop. */
+    void terminate() const;
+};
+
+
+#endif
@@ -36,6 +36,7 @@ void _program_delete(GLuint *program)
 Program::Program(std::vector<Shader> shaders, std::string label)
 :   _id{new GLuint{glCreateProgram()}, _program_delete}
 {
+    gl_call_count += 3 + 2 * shaders.size();
     for (auto shader : shaders)
     {
         glAttachShader(*_id, shader.id());
@@ -64,6 +65,7 @@ Program::Program(std::vector<Shader> shaders, std::string label)
 
 void Program::use() const
 {
+    ++gl_call_count;
     glUseProgram(*_id);
 }
 
@@ -74,42 +76,70 @@ GLuint Program::id() const
 
 void Program::setUniform(std::string uniform, bool value) const
 {
+    ++gl_call_count;
     glUniform1i(_getUniformLocation(uniform), value);
 }
 
 void Program::setUniform(std::string uniform, GLfloat value) const
 {
+    ++gl_call_count;
     glUniform1f(_getUniformLocation(uniform), value);
 }
 
 void Program::setUniform(std::string uniform, GLint value) const
 {
+    ++gl_call_count;
     glUniform1i(_getUniformLocation(uniform), value);
 }
 
 void Program::setUniform(std::string uniform, GLuint value) const
 {
+    ++gl_call_count;
     glUniform1ui(_getUniformLocation(uniform), value);
 }
 
 void Program::setUniform(std::string uniform, glm::vec2 value) const
 {
+    ++gl_call_count;
     glUniform2fv(_getUniformLocation(uniform), 1, glm::value_ptr(value));
 }
 
 void Program::setUniform(std::string uniform, glm::vec3 value) const
 {
+    ++gl_call_count;
     glUniform3fv(_getUniformLocation(uniform), 1, glm::value_ptr(value));
 }
 
 void Program::setUniform(std::string uniform, glm::vec4 value) const
 {
+    ++gl_call_count;
     glUniform4fv(_getUniformLocation(uniform), 1, glm::value_ptr(value));
 }
 
+void Program::setUniform(std::string uniform, glm::ivec2 value) const
+{
+    ++gl_call_count;
+    glUniform2iv(_getUniformLocation(uniform), 1, glm::value_ptr(value));
+}
+
+void Program::setUniform(std::string uniform, std::vector<GLfloat> value) const
+{
+    ++gl_call_count;
+    glUniform1fv(
+        _getUniformLocation(uniform), (GLsizei)value.size(), value.data());
+}
+
+void Program::setUniform(std::string uniform, std::vector<GLuint> value) const
+{
+    ++gl_call_count;
+    glUniform1uiv(
+        _getUniformLocation(uniform), (GLsizei)value.size(), value.data());
+}
+
 
 GLint Program::_getUniformLocation(std::string uniform) const
 {
+    ++gl_call_count;
     auto location = glGetUniformLocation(*_id, uniform.c_str());
     if (location == -1)
     {
@@ -0,0 +1,366 @@
+/**
+ * Progressive.cpp - Progressive rendering with checkpoints.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Progressive.hpp"
+#include "App.hpp"
+#include "FrameReader.hpp"
+#include "ImageFile.hpp"
+#include "Scenes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+/** Image units used by accumulate.comp. (0 is the render result) */
+static GLint const SUM_UNIT = 2;
+static GLint const COUNT_UNIT = 3;
+
+/** Checkpoint file magic; the last character is the format version. */
+static char const CHECKPOINT_MAGIC[8] = {'R','T','C','K','P','T','0','1'};
+
+
+/* ===[ Accumulator ]=== */
+
+Accumulator::Accumulator(GLuint width, GLuint height)
+:   _accumulate{
+        {shader_from_file("shaders/accumulate.comp", GL_COMPUTE_SHADER)},
+        "Accumulate"}
+,   _sum{GL_TEXTURE_2D, "SampleSum"}
+,   _count{GL_TEXTURE_2D, "SampleCount"}
+,   _width{width}
+,   _height{height}
+{
+    // Integer textures can't be filtered, and the sums never are.
+    for (Texture *texture : {&_sum, &_count})
+    {
+        texture->bind();
+        texture->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        texture->setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        texture->unbind();
+    }
+    clear();
+}
+
+void Accumulator::clear()
+{
+    write(
+        std::vector<GLfloat>((size_t)_width * _height * 4, 0.0f),
+        std::vector<GLuint>((size_t)_width * _height, 0));
+}
+
+void Accumulator::add(ComputeRaytraceRenderer &renderer, GLuint samples)
+{
+    _accumulate.use();
+    gl_call_count += 3;
+    glBindImageTexture(
+        0, renderer.getResult().id(), 0, GL_FALSE, 0, GL_READ_WRITE,
+        GL_RGBA32F);
+    glBindImageTexture(
+        SUM_UNIT, _sum.id(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(
+        COUNT_UNIT, _count.id(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    _accumulate.setUniformS("result", 0);
+    _accumulate.setUniformS("sampleSum", SUM_UNIT);
+    _accumulate.setUniformS("sampleCount", COUNT_UNIT);
+    _accumulate.setUniformS("passSamples", samples);
+    ++gl_call_count;
+    glDispatchCompute((_width + 7) / 8, (_height + 7) / 8, 1);
+    glMemoryBarrier(
+        GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+void Accumulator::read(
+    std::vector<GLfloat> &sum, std::vector<GLuint> &count) const
+{
+    sum.resize((size_t)_width * _height * 4);
+    count.resize((size_t)_width * _height);
+    _sum.bind();
+    glGetTexImage(_sum.type(), 0, GL_RGBA, GL_FLOAT, sum.data());
+    _count.bind();
+    glGetTexImage(
+        _count.type(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, count.data());
+    _count.unbind();
+    gl_call_count += 2;
+}
+
+void Accumulator::write(
+    std::vector<GLfloat> const &sum, std::vector<GLuint> const &count)
+{
+    _sum.bind();
+    glTexImage2D(
+        _sum.type(), 0, GL_RGBA32F, _width, _height, 0, GL_RGBA, GL_FLOAT,
+        sum.data());
+    _count.bind();
+    glTexImage2D(
+        _count.type(), 0, GL_R32UI, _width, _height, 0, GL_RED_INTEGER,
+        GL_UNSIGNED_INT, count.data());
+    _count.unbind();
+    gl_call_count += 2;
+}
+
+
+/* ===[ Checkpoints ]=== */
+
+/** 64-bit FNV-1a, continuing from `hash`. */
+static uint64_t fnv1a(void const *data, size_t size, uint64_t hash)
+{
+    unsigned char const *const bytes = (unsigned char const *)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+static uint64_t const FNV_OFFSET = 0xCBF29CE484222325ull;
+
+/** Hash everything that affects a progressive render's pixels. */
+static uint64_t render_hash(
+    SceneSetup const &setup, unsigned width, unsigned height)
+{
+    uint64_t hash = FNV_OFFSET;
+    auto const &scene = setup.scene;
+    hash = fnv1a(
+        scene.materials.data(), scene.materials.size() * sizeof(Material),
+        hash);
+    hash = fnv1a(
+        scene.spheres.data(), scene.spheres.size() * sizeof(Sphere), hash);
+    hash = fnv1a(
+        scene.lights.data(), scene.lights.size() * sizeof(OmniLight), hash);
+    hash = fnv1a(&setup.camera, sizeof(setup.camera), hash);
+    hash = fnv1a(&setup.ambientColor, sizeof(setup.ambientColor), hash);
+    hash = fnv1a(&setup.blankColor, sizeof(setup.blankColor), hash);
+    hash = fnv1a(&width, sizeof(width), hash);
+    hash = fnv1a(&height, sizeof(height), hash);
+    return hash;
+}
+
+void save_checkpoint(std::string const &path, Checkpoint const &checkpoint)
+{
+    std::string const temporary = path + ".tmp";
+    {
+        std::ofstream out{temporary.c_str(), std::ios::binary};
+        if (!out)
+        {
+            throw std::runtime_error{"failed to open '" + temporary + "'"};
+        }
+        uint32_t const reserved = 0;
+        uint64_t check = FNV_OFFSET;
+        // Write a field, and add it to the integrity check.
+        auto const put = [&out, &check](void const *data, size_t size){
+            out.write((char const *)data, size);
+            check = fnv1a(data, size, check);
+        };
+        put(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        put(&checkpoint.hash, sizeof(checkpoint.hash));
+        put(&checkpoint.width, sizeof(checkpoint.width));
+        put(&checkpoint.height, sizeof(checkpoint.height));
+        put(&checkpoint.nextSample, sizeof(checkpoint.nextSample));
+        put(&reserved, sizeof(reserved));
+        put(checkpoint.sum.data(), checkpoint.sum.size() * sizeof(GLfloat));
+        put(checkpoint.count.data(),
+            checkpoint.count.size() * sizeof(GLuint));
+        out.write((char const *)&check, sizeof(check));
+        if (!out)
+        {
+            throw std::runtime_error{"failed to write '" + temporary + "'"};
+        }
+    }
+#ifdef _WIN32
+    // Windows won't rename over an existing file.
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        throw std::runtime_error{
+            "failed to rename '" + temporary + "' to '" + path + "'"};
+    }
+}
+
+bool load_checkpoint(std::string const &path, Checkpoint &checkpoint)
+{
+    std::ifstream in{path.c_str(), std::ios::binary};
+    if (!in)
+    {
+        return false;
+    }
+    uint64_t check = FNV_OFFSET;
+    auto const get = [&in, &check, &path](void *data, size_t size){
+        if (!in.read((char *)data, size))
+        {
+            throw std::runtime_error{"checkpoint '" + path + "' is truncated"};
+        }
+        check = fnv1a(data, size, check);
+    };
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    uint32_t reserved = 0;
+    get(magic, sizeof(magic));
+    if (std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error{
+            "'" + path + "' is not a checkpoint, or is from another version"};
+    }
+    get(&checkpoint.hash, sizeof(checkpoint.hash));
+    get(&checkpoint.width, sizeof(checkpoint.width));
+    get(&checkpoint.height, sizeof(checkpoint.height));
+    get(&checkpoint.nextSample, sizeof(checkpoint.nextSample));
+    get(&reserved, sizeof(reserved));
+    size_t const pixels = (size_t)checkpoint.width * checkpoint.height;
+    checkpoint.sum.resize(pixels * 4);
+    checkpoint.count.resize(pixels);
+    get(checkpoint.sum.data(), checkpoint.sum.size() * sizeof(GLfloat));
+    get(checkpoint.count.data(), checkpoint.count.size() * sizeof(GLuint));
+    uint64_t stored = 0;
+    if (!in.read((char *)&stored, sizeof(stored)) || stored != check)
+    {
+        throw std::runtime_error{"checkpoint '" + path + "' is corrupt"};
+    }
+    return true;
+}
+
+
+/* ===[ Progressive Rendering ]=== */
+
+int run_progressive(Options const &options)
+{
+    ImageFormat const format = image_format_from_path(
+        options.progressiveOutput);
+
+    init_SDL();
+    App app{
+        "compute progressive", (int)options.width, (int)options.height,
+        false};
+    app.setVSync(false);
+
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    ComputeRaytraceRenderer renderer{
+        setup.scene, options.width, options.height};
+    configure_renderer(renderer, setup);
+    Accumulator accumulator{options.width, options.height};
+
+    Checkpoint checkpoint{};
+    checkpoint.hash = render_hash(setup, options.width, options.height);
+    checkpoint.width = options.width;
+    checkpoint.height = options.height;
+    checkpoint.nextSample = 0;
+    if (options.resume)
+    {
+        Checkpoint saved{};
+        if (!load_checkpoint(options.checkpointPath, saved))
+        {
+            std::clog << "No checkpoint at " << options.checkpointPath
+                << ", starting from scratch\n";
+        }
+        else if (saved.hash != checkpoint.hash)
+        {
+            std::clog << "Checkpoint " << options.checkpointPath
+                << " is for a different scene, camera or size, starting"
+                " from scratch\n";
+        }
+        else
+        {
+            accumulator.write(saved.sum, saved.count);
+            checkpoint.nextSample = saved.nextSample;
+            std::clog << "Resuming from sample " << saved.nextSample << "\n";
+        }
+    }
+
+    // Checkpoints are read back on this thread, but written out on
+    // another, so disk speed never holds up rendering.
+    std::thread writer{};
+    auto const save = [&](){
+        accumulator.read(checkpoint.sum, checkpoint.count);
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+        writer = std::thread{
+            [&options](Checkpoint snapshot){
+                try
+                {
+                    save_checkpoint(options.checkpointPath, snapshot);
+                }
+                catch (std::exception const &e)
+                {
+                    std::cerr << "Checkpoint failed: " << e.what() << "\n";
+                }
+            },
+            checkpoint};
+    };
+
+    using Clock = std::chrono::steady_clock;
+    auto const start = Clock::now();
+    auto last_save = start;
+    GLuint const target = options.progressiveSamples;
+    GLuint const resumed = checkpoint.nextSample;
+    while (checkpoint.nextSample < target)
+    {
+        GLuint const pass = std::min(
+            options.samples, target - checkpoint.nextSample);
+        renderer.samplesPerPixel = pass;
+        renderer.firstSample = checkpoint.nextSample;
+        renderer.render();
+        accumulator.add(renderer, pass);
+        checkpoint.nextSample += pass;
+
+        auto const now = Clock::now();
+        if (std::chrono::duration<double>(now - last_save).count()
+            >= options.checkpointInterval)
+        {
+            save();
+            last_save = now;
+            std::clog << "\rSample " << checkpoint.nextSample << "/"
+                << target << " (checkpointed)" << std::flush;
+        }
+    }
+    if (checkpoint.nextSample != resumed)
+    {
+        save();
+    }
+    else
+    {
+        // Resuming a finished render just rewrites its image. Adding an
+        // empty pass turns the sums back into the average.
+        renderer.render();
+        accumulator.add(renderer, 0);
+    }
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+    double const seconds = std::chrono::duration<double>(
+        Clock::now() - start).count();
+    std::clog << "\n";
+
+    // The render result holds the converged average.
+    FrameReader reader{1};
+    FrameReader::Frame frame{};
+    reader.read(
+        renderer.getResult(), options.width, options.height,
+        image_format_layout(format), 0);
+    reader.collect(frame, true);
+    write_image(options.progressiveOutput, format, frame);
+    std::cout << "Wrote " << options.progressiveOutput << ": "
+        << checkpoint.nextSample - resumed << " samples per pixel in "
+        << seconds << " s\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/**
+ * Progressive.hpp - Progressive rendering with checkpoints.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROGRESSIVE_HPP
+#define _PROGRESSIVE_HPP
+
+#include "ComputeRaytraceRenderer.hpp"
+#include "Options.hpp"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Running per-pixel sums of a progressive render, kept on the GPU.
+ */
+class Accumulator
+{
+private:
+    Program const _accumulate;
+    Texture _sum;
+    Texture _count;
+    GLuint const _width, _height;
+
+public:
+    Accumulator(GLuint width, GLuint height);
+
+    /** Reset every pixel to no samples. */
+    void clear();
+
+    /**
+     * Add the renderer's latest result, which averaged `samples` rays per
+     * pixel, and replace it with the average of everything so far.
+     */
+    void add(ComputeRaytraceRenderer &renderer, GLuint samples);
+
+    /** Read the sums (RGBA) and counts back. NOTE: This stalls! */
+    void read(std::vector<GLfloat> &sum, std::vector<GLuint> &count) const;
+    /** Replace the sums and counts. */
+    void write(
+        std::vector<GLfloat> const &sum, std::vector<GLuint> const &count);
+};
+
+
+/**
+ * Accumulation state of a progressive render.
+ *  hash - Hash of everything that affects the image (scene, camera, size),
+ *         so a checkpoint is never resumed into a different render.
+ *  width, height - Image size.
+ *  nextSample - Index of the next sample in the renderer's low-discrepancy
+ *               sequence, ie. the sampler's state.
+ *  sum - Per-pixel RGBA sample sums.
+ *  count - Per-pixel sample counts.
+ */
+struct Checkpoint
+{
+    uint64_t hash;
+    uint32_t width, height;
+    uint32_t nextSample;
+    std::vector<GLfloat> sum;
+    std::vector<GLuint> count;
+};
+
+/**
+ * Write a checkpoint. It's written to a temporary file first and renamed
+ * into place, so a crash mid-write leaves the previous checkpoint intact.
+ */
+void save_checkpoint(std::string const &path, Checkpoint const &checkpoint);
+
+/**
+ * Load a checkpoint. Returns false if there's no such file, throws if it's
+ * corrupt.
+ */
+bool load_checkpoint(std::string const &path, Checkpoint &checkpoint);
+
+
+/**
+ * Render `options.progressiveSamples` samples per pixel in passes, saving
+ * checkpoints every `options.checkpointInterval` seconds, and optionally
+ * resuming from the last one.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_progressive(Options const &options);
+
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * Query.cpp - OpenGL query object.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "glUtil.hpp"
+
+#include <GL/glew.h>
+
+
+void _query_delete(GLuint *query)
+{
+    glDeleteQueries(1, query);
+    delete query;
+}
+
+
+Query::Query(GLenum target, std::string label)
+:   _id{new GLuint{0}, _query_delete}
+,   _target{target}
+{
+    gl_call_count += 2;
+    glCreateQueries(target, 1, _id.get());
+    if (!label.empty())
+    {
+        glObjectLabel(GL_QUERY, *_id, (GLsizei)label.size(), label.c_str());
+    }
+}
+
+GLuint Query::id() const
+{
+    return *_id;
+}
+
+void Query::begin() const
+{
+    ++gl_call_count;
+    glBeginQuery(_target, *_id);
+}
+
+void Query::end() const
+{
+    ++gl_call_count;
+    glEndQuery(_target);
+}
+
+void Query::timestamp() const
+{
+    ++gl_call_count;
+    glQueryCounter(*_id, GL_TIMESTAMP);
+}
+
+bool Query::available() const
+{
+    ++gl_call_count;
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(*_id, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+GLuint64 Query::result() const
+{
+    ++gl_call_count;
+    GLuint64 result = 0;
+    glGetQueryObjectui64v(*_id, GL_QUERY_RESULT, &result);
+    return result;
+}
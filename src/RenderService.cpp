@@ -0,0 +1,499 @@
+/**
+ * RenderService.cpp - Long-running render daemon.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "RenderService.hpp"
+#include "App.hpp"
+#include "Batch.hpp"
+#include "ComputeRaytraceRenderer.hpp"
+#include "FrameReader.hpp"
+#include "ImageFile.hpp"
+#include "Metrics.hpp"
+#include "Scenes.hpp"
+#include "ServiceProtocol.hpp"
+#include "Socket.hpp"
+#include "TileFarm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+/** Largest image width or height the service renders. */
+static uint32_t const SERVICE_MAX_SIZE = 4096;
+
+/** Most pixels rendered into one atlas. */
+static uint64_t const SERVICE_BATCH_PIXELS = 4096 * 4096;
+
+/** Seconds connection threads wait for data before checking for a stop. */
+static double const SERVICE_POLL_SECONDS = 0.1;
+
+
+/** Set by SIGINT and SIGTERM to stop the service. */
+static volatile std::sig_atomic_t service_stop = 0;
+
+static void service_signal(int)
+{
+    service_stop = 1;
+}
+
+
+/**
+ * A request waiting to be rendered.
+ *  client - Connection to answer on.
+ *  request - What was asked for.
+ *  queued - When it arrived.
+ */
+struct QueuedRequest
+{
+    Socket client;
+    ServiceRequest request;
+    std::chrono::steady_clock::time_point queued;
+};
+
+/** Requests passed from the connection threads to the render loop. */
+struct ServiceQueue
+{
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<QueuedRequest> requests;
+};
+
+
+/**
+ * A connection thread.
+ *  thread - Reads the client's requests.
+ *  done - Set once the client has gone, so the thread can be joined.
+ */
+struct ServiceConnection
+{
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+};
+
+
+/**
+ * Queue requests from a client until it disconnects or `stopping` is set,
+ * then set `done`.
+ */
+static void read_requests(
+    Socket client, ServiceQueue &queue, Gauge &depth,
+    std::atomic<bool> const &stopping,
+    std::shared_ptr<std::atomic<bool>> done)
+{
+    try
+    {
+        ServiceRequest request{};
+        while (!stopping)
+        {
+            if (!client.waitReadable(SERVICE_POLL_SECONDS))
+            {
+                continue;
+            }
+            if (!client.recvAll(&request, sizeof(request)))
+            {
+                break;
+            }
+            if (std::memcmp(request.magic, "RTRQ", 4) != 0)
+            {
+                std::clog << "Render service: bad request, dropping client\n";
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock{queue.lock};
+                queue.requests.push_back(QueuedRequest{
+                    client, request, std::chrono::steady_clock::now()});
+                depth.set((double)queue.requests.size());
+            }
+            queue.ready.notify_one();
+        }
+    }
+    catch (std::exception const &e)
+    {
+        std::clog << "Render service: " << e.what() << "\n";
+    }
+    *done = true;
+}
+
+/** Answer a request. Clients which have gone away are ignored. */
+static void respond(
+    QueuedRequest const &queued, uint32_t status, std::string const &body)
+{
+    ServiceResponse response{};
+    std::memcpy(response.magic, "RTRS", 4);
+    response.id = queued.request.id;
+    response.status = status;
+    response.bytes = (uint32_t)body.size();
+    try
+    {
+        queued.client.sendAll(&response, sizeof(response));
+        queued.client.sendAll(body);
+    }
+    catch (std::exception const &e)
+    {
+        std::clog << "Render service: " << e.what() << "\n";
+    }
+}
+
+/**
+ * Cut a job's rectangle (bottom left corner, then size) out of an atlas
+ * that was read back top row first.
+ */
+static FrameReader::Frame crop_frame(
+    FrameReader::Frame const &atlas, glm::ivec4 const &rect)
+{
+    FrameReader::Frame out{};
+    out.tag = atlas.tag;
+    out.width = rect.z;
+    out.height = rect.w;
+    out.layout = atlas.layout;
+    size_t const top = atlas.height - rect.y - rect.w;
+    size_t const w = rect.z;
+    if (atlas.layout == PIXELS_RGB8)
+    {
+        out.data.resize(w * rect.w * 3);
+        for (size_t y = 0; y < out.height; ++y)
+        {
+            std::memcpy(
+                &out.data[y * w * 3],
+                &atlas.data[((top + y) * atlas.width + rect.x) * 3], w * 3);
+        }
+    }
+    else
+    {
+        // Each row is B, G and R planes of halves.
+        out.data.resize(w * rect.w * 6);
+        for (size_t y = 0; y < out.height; ++y)
+        {
+            for (size_t p = 0; p < 3; ++p)
+            {
+                std::memcpy(
+                    &out.data[(y * 3 + p) * w * 2],
+                    &atlas.data[
+                        (((top + y) * 3 + p) * atlas.width + rect.x) * 2],
+                    w * 2);
+            }
+        }
+    }
+    return out;
+}
+
+
+int run_service(Options const &options)
+{
+    std::signal(SIGINT, service_signal);
+    std::signal(SIGTERM, service_signal);
+
+    init_SDL();
+    App app{"compute service", 64, 64, false};
+    app.setVSync(false);
+
+    /* ===[ Metrics ]=== */
+    auto &metrics = MetricsRegistry::global();
+    auto &depth = metrics.gauge(
+        "service_queue_depth", "Requests waiting to be rendered.");
+    auto &latency = metrics.histogram(
+        "service_latency_us", "Time from a request arriving to its answer.");
+    auto &answered = metrics.counter(
+        "service_requests_total", "Requests answered.");
+    auto &failed = metrics.counter(
+        "service_errors_total", "Requests answered with an error.");
+    auto &batch_size = metrics.histogram(
+        "service_batch_requests", "Requests rendered per dispatch.");
+    std::unique_ptr<MetricsExporter> exporter{};
+    if (!options.metricsFile.empty() || options.metricsPort != 0)
+    {
+        exporter.reset(new MetricsExporter{
+            metrics, options.metricsFile, options.metricsInterval,
+            options.metricsPort});
+    }
+    auto const answer = [&](
+        QueuedRequest const &queued, uint32_t status,
+        std::string const &body){
+        respond(queued, status, body);
+        answered.add();
+        if (status != 0)
+        {
+            failed.add();
+        }
+        latency.record((uint64_t)std::chrono::duration_cast<
+            std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - queued.queued).count());
+    };
+
+    /* ===[ Connections ]=== */
+    // The accept thread owns the connection threads, joining them as
+    // clients leave and all of them once the service stops.
+    Socket const listener = Socket::listenUnix(options.servePath);
+    ServiceQueue queue{};
+    std::atomic<bool> stopping{false};
+    std::thread acceptor{[&listener, &queue, &depth, &stopping](){
+        std::vector<ServiceConnection> connections{};
+        try
+        {
+            while (!stopping)
+            {
+                for (auto it = connections.begin(); it != connections.end();)
+                {
+                    if (*it->done)
+                    {
+                        it->thread.join();
+                        it = connections.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+                if (!listener.waitReadable(SERVICE_POLL_SECONDS))
+                {
+                    continue;
+                }
+                auto const done = std::make_shared<std::atomic<bool>>(false);
+                connections.push_back(ServiceConnection{
+                    std::thread{
+                        read_requests, listener.accept(), std::ref(queue),
+                        std::ref(depth), std::cref(stopping), done},
+                    done});
+            }
+        }
+        catch (std::exception const &e)
+        {
+            std::clog << "Render service: " << e.what() << "\n";
+        }
+        for (auto &connection : connections)
+        {
+            connection.thread.join();
+        }
+    }};
+    std::clog << "Serving renders on " << options.servePath << "\n";
+
+    /* ===[ Render Loop ]=== */
+    // Scenes stay resident, each with its own renderer and uploaded buffers.
+    std::map<std::string, SceneSetup> setups{};
+    std::map<std::string, std::unique_ptr<ComputeRaytraceRenderer>> renderers{};
+    FrameReader reader{1};
+    while (!service_stop)
+    {
+        {
+            std::unique_lock<std::mutex> lock{queue.lock};
+            if (!queue.ready.wait_for(
+                    lock, std::chrono::milliseconds{100},
+                    [&queue](){ return !queue.requests.empty(); }))
+            {
+                continue;
+            }
+        }
+        // Give requests sent together a moment to arrive, so they can share
+        // dispatches.
+        std::this_thread::sleep_for(
+            std::chrono::duration<double, std::milli>(options.serveWindow));
+        std::vector<QueuedRequest> batch{};
+        {
+            std::lock_guard<std::mutex> lock{queue.lock};
+            batch.assign(queue.requests.begin(), queue.requests.end());
+            queue.requests.clear();
+            depth.set(0.0);
+        }
+
+        // Group by scene and sample count, which are per-dispatch.
+        std::map<std::pair<std::string, uint32_t>, std::vector<size_t>>
+            groups{};
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            ServiceRequest const &r = batch[i].request;
+            if (r.width == 0 || r.height == 0
+                || r.width > SERVICE_MAX_SIZE || r.height > SERVICE_MAX_SIZE
+                || r.format > IMAGE_EXR)
+            {
+                answer(batch[i], 1, "bad size or format");
+                continue;
+            }
+            if (r.samples > options.serveMaxSamples)
+            {
+                answer(
+                    batch[i], 1,
+                    "too many samples, at most "
+                    + std::to_string(options.serveMaxSamples));
+                continue;
+            }
+            std::string const scene{
+                r.scene, strnlen(r.scene, sizeof(r.scene))};
+            groups[std::make_pair(scene, std::max(r.samples, 1u))]
+                .push_back(i);
+        }
+
+        for (auto const &group : groups)
+        {
+            std::string const &scene = group.first.first;
+            std::vector<size_t> const &members = group.second;
+            auto &renderer = renderers[scene];
+            try
+            {
+                if (!renderer)
+                {
+                    setups[scene] = builtin_scene(scene);
+                    renderer.reset(new ComputeRaytraceRenderer{
+                        setups[scene].scene, 16, 16});
+                    configure_renderer(*renderer, setups[scene]);
+                }
+            }
+            catch (std::exception const &e)
+            {
+                renderers.erase(scene);
+                for (size_t const i : members)
+                {
+                    answer(batch[i], 1, e.what());
+                }
+                continue;
+            }
+            renderer->samplesPerPixel = group.first.second;
+
+            // Split the group into atlases of bounded size.
+            size_t first = 0;
+            while (first < members.size())
+            {
+                std::vector<RenderJob> jobs{};
+                uint64_t pixels = 0;
+                size_t last = first;
+                for (; last < members.size()
+                        && jobs.size() < renderer->maxJobs(); ++last)
+                {
+                    ServiceRequest const &r = batch[members[last]].request;
+                    uint64_t const job_pixels = (uint64_t)r.width * r.height;
+                    if (!jobs.empty()
+                        && pixels + job_pixels > SERVICE_BATCH_PIXELS)
+                    {
+                        break;
+                    }
+                    pixels += job_pixels;
+                    jobs.push_back(RenderJob{
+                        r.sceneCamera?
+                            setups[scene].camera : unpack_camera(r.camera),
+                        r.width, r.height, 0, ~0u, 0, ~0u});
+                }
+                try
+                {
+                    std::vector<glm::ivec4> const rects =
+                        renderer->renderJobs(jobs);
+                    batch_size.record(jobs.size());
+
+                    // Read the atlas back once per pixel layout needed.
+                    glm::ivec2 const size = renderer->jobAtlasSize();
+                    std::map<PixelLayout, FrameReader::Frame> atlases{};
+                    for (size_t k = first; k < last; ++k)
+                    {
+                        PixelLayout const layout = image_format_layout(
+                            (ImageFormat)batch[members[k]].request.format);
+                        if (atlases.count(layout) == 0)
+                        {
+                            reader.read(
+                                renderer->getJobResults(), size.x, size.y,
+                                layout, 0);
+                            reader.collect(atlases[layout], true);
+                        }
+                    }
+                    for (size_t k = first; k < last; ++k)
+                    {
+                        QueuedRequest const &queued = batch[members[k]];
+                        ImageFormat const format =
+                            (ImageFormat)queued.request.format;
+                        answer(
+                            queued, 0,
+                            encode_image(format, crop_frame(
+                                atlases[image_format_layout(format)],
+                                rects[k - first])));
+                    }
+                }
+                catch (std::exception const &e)
+                {
+                    for (size_t k = first; k < last; ++k)
+                    {
+                        answer(batch[members[k]], 1, e.what());
+                    }
+                }
+                first = last;
+            }
+        }
+    }
+    stopping = true;
+    acceptor.join();
+    std::remove(options.servePath.c_str());
+    std::clog << "Render service stopped\n";
+    return EXIT_SUCCESS;
+}
+
+
+int run_service_client(Options const &options)
+{
+    std::string const scene = options.scenes.empty()?
+        "demo" : options.scenes.front();
+    std::string const path = frame_path(options.outputPattern, 0);
+    ServiceRequest request{};
+    std::memcpy(request.magic, "RTRQ", 4);
+    if (scene.size() >= sizeof(request.scene))
+    {
+        throw std::runtime_error{"scene name '" + scene + "' is too long"};
+    }
+    std::memcpy(request.scene, scene.data(), scene.size());
+    request.width = options.width;
+    request.height = options.height;
+    request.samples = options.samples;
+    request.format = image_format_from_path(path);
+    request.sceneCamera = 1;
+
+    Socket const socket = Socket::connectUnix(options.clientPath);
+    auto const start = std::chrono::steady_clock::now();
+    socket.sendAll(&request, sizeof(request));
+    ServiceResponse response{};
+    std::string body{};
+    if (!socket.recvAll(&response, sizeof(response))
+        || std::memcmp(response.magic, "RTRS", 4) != 0)
+    {
+        throw std::runtime_error{"render service closed the connection"};
+    }
+    body.resize(response.bytes);
+    if (!socket.recvAll(&body[0], body.size()))
+    {
+        throw std::runtime_error{"render service response cut short"};
+    }
+    if (response.status != 0)
+    {
+        throw std::runtime_error{"render service: " + body};
+    }
+    double const ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    std::ofstream out{path.c_str(), std::ios::binary};
+    out.write(body.data(), body.size());
+    if (!out)
+    {
+        throw std::runtime_error{"failed to write '" + path + "'"};
+    }
+    std::cout << "Wrote " << path << " in " << ms << " ms\n";
+    return EXIT_SUCCESS;
+}
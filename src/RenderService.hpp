@@ -0,0 +1,43 @@
+/**
+ * RenderService.hpp - Long-running render daemon.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RENDERSERVICE_HPP
+#define _RENDERSERVICE_HPP
+
+#include "Options.hpp"
+
+
+/**
+ * Serve render requests (see ServiceProtocol.hpp) on the Unix socket
+ * `options.servePath` until interrupted. Scenes are loaded on first use and
+ * kept resident. Requests queued within `options.serveWindow` ms of each
+ * other are grouped by scene and sample count, and each group is rendered
+ * with one dispatch per ComputeRaytraceRenderer::renderJobs() batch.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_service(Options const &options);
+
+/**
+ * Send one request to the service on `options.clientPath`, for the first
+ * scene at `options.width` x `options.height`, and write the image to
+ * `options.outputPattern`.
+ */
+int run_service_client(Options const &options);
+
+
+#endif
@@ -0,0 +1,217 @@
+/**
+ * SceneEditBench.cpp - Live scene editing benchmark.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SceneEditBench.hpp"
+#include "App.hpp"
+#include "Metrics.hpp"
+#include "Scenes.hpp"
+#include "SceneSnapshot.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+
+/** Spheres moved by each version. */
+static size_t const EDITS_PER_VERSION = 64;
+
+
+/**
+ * Bytes of the chunks of `next` that differ from `resident`, which
+ * updateScene() should upload: all of them if there's no resident version
+ * or the buffer grew.
+ */
+template<typename T>
+static size_t changed_bytes(
+    ChunkedArray<T> const &next, ChunkedArray<T> const *resident, bool grown,
+    size_t &chunks)
+{
+    size_t bytes = 0;
+    for (size_t c = 0; c < next.chunkCount(); ++c)
+    {
+        if (!grown && resident && c < resident->chunkCount()
+            && resident->chunk(c) == next.chunk(c))
+        {
+            continue;
+        }
+        bytes += next.chunk(c)->size() * sizeof(T);
+        ++chunks;
+    }
+    return bytes;
+}
+
+/** Make one version's edits. */
+static void edit_scene(
+    SceneSnapshot &scene, uint64_t version, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<GLfloat> offset{-0.05f, 0.05f};
+    {
+        // Nudge spheres clustered in a few chunks, as a moving object would.
+        ChunkedArray<Sphere>::Editor spheres{scene.spheres};
+        size_t const count = scene.spheres.size();
+        size_t const first = count == 0? 0 : rng() % count;
+        for (size_t k = 0; k < EDITS_PER_VERSION && count > 0; ++k)
+        {
+            size_t const i = (first + k * 7) % count;
+            Sphere sphere = scene.spheres[i];
+            for (auto &p : sphere.position)
+            {
+                p += offset(rng);
+            }
+            spheres.set(i, sphere);
+        }
+    }
+    if (version % 10 == 0 && scene.lights.size() > 0)
+    {
+        OmniLight light = scene.lights[version / 10 % scene.lights.size()];
+        light.color[0] = std::uniform_real_distribution<GLfloat>{
+            0.2f, 0.5f}(rng);
+        scene.lights.set(version / 10 % scene.lights.size(), light);
+    }
+    // Grow by a chunk now and then, and shrink a little less often, so
+    // buffers both regrow and get trimmed.
+    if (version % 25 == 0)
+    {
+        for (size_t k = 0; k < ChunkedArray<Sphere>::CHUNK; ++k)
+        {
+            Sphere sphere = scene.spheres[rng() % scene.spheres.size()];
+            sphere.position[1] += 1.0f;
+            scene.spheres.push_back(sphere);
+        }
+    }
+    else if (version % 40 == 0)
+    {
+        for (size_t k = 0; k < 100 && scene.spheres.size() > 1; ++k)
+        {
+            scene.spheres.pop_back();
+        }
+    }
+}
+
+
+int run_scene_edit_benchmark(Options const &options)
+{
+    uint64_t const versions = options.frames > 0? options.frames : 300;
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "large" : options.scenes.front());
+    if (setup.scene.spheres.empty())
+    {
+        throw std::runtime_error{"scene edit benchmark needs spheres"};
+    }
+
+    init_SDL();
+    App app{
+        "compute scene edits", (int)options.width, (int)options.height,
+        false};
+    ComputeRaytraceRenderer renderer{
+        setup.scene, options.width, options.height};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+    renderer.sceneStorage = options.sceneStorage;
+    Counter &upload_counter = MetricsRegistry::global().counter(
+        "render_upload_bytes_total", "Bytes uploaded to GPU buffers.");
+
+    SceneStore store{setup.scene};
+    std::atomic<bool> edited{false};
+    std::thread editor{[&](){
+        std::mt19937 rng{1};
+        for (uint64_t v = 0; v < versions; ++v)
+        {
+            store.update([&](SceneSnapshot &scene){
+                edit_scene(scene, scene.version + 1, rng);
+            });
+            // Roughly a frame's worth of editing between versions.
+            std::this_thread::sleep_for(std::chrono::milliseconds{2});
+        }
+        edited = true;
+    }};
+
+    uint64_t frames = 0;
+    uint64_t updates = 0;
+    uint64_t mismatches = 0;
+    size_t uploaded = 0;
+    size_t whole = 0;
+    auto const start = std::chrono::steady_clock::now();
+    // Frames are never presented, so nothing waits for VSync.
+    std::shared_ptr<SceneSnapshot const> resident{};
+    for (;;)
+    {
+        bool const last = edited;
+        auto const snapshot = store.latest();
+        if (snapshot != resident)
+        {
+            uint64_t const before = upload_counter.value();
+            SceneUpload const upload = renderer.updateScene(snapshot);
+            uint64_t const measured = upload_counter.value() - before;
+            size_t chunks = 0;
+            size_t expected =
+                changed_bytes(
+                    snapshot->spheres,
+                    resident? &resident->spheres : nullptr,
+                    upload.spheresGrown, chunks)
+                + changed_bytes(
+                    snapshot->materials,
+                    resident? &resident->materials : nullptr,
+                    upload.materialsGrown, chunks)
+                + changed_bytes(
+                    snapshot->lights,
+                    resident? &resident->lights : nullptr,
+                    upload.lightsGrown, chunks);
+            if (measured != expected || upload.bytes != expected
+                || upload.chunks != chunks)
+            {
+                ++mismatches;
+                std::cerr << "Version " << snapshot->version << ": uploaded "
+                    << measured << " bytes in " << upload.chunks
+                    << " chunks, expected " << expected << " bytes in "
+                    << chunks << "\n";
+            }
+            uploaded += measured;
+            whole += (
+                snapshot->spheres.size() * sizeof(Sphere)
+                + snapshot->materials.size() * sizeof(Material)
+                + snapshot->lights.size() * sizeof(OmniLight));
+            resident = snapshot;
+            ++updates;
+        }
+        renderer.render();
+        ++frames;
+        // Versions published before `edited` was read are all seen.
+        if (last && resident == store.latest())
+        {
+            break;
+        }
+    }
+    editor.join();
+    glFinish();
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << versions << " versions published, " << updates
+        << " rendered in " << frames << " frames (" << frames / seconds
+        << " fps)\n"
+        << uploaded << " bytes uploaded, "
+        << (whole == 0? 0.0 : 100.0 * uploaded / whole)
+        << "% of re-uploading every rendered version whole\n"
+        << mismatches << " updates uploaded other than the changed chunks\n";
+    return mismatches == 0? EXIT_SUCCESS : EXIT_FAILURE;
+}
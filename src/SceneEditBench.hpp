@@ -0,0 +1,39 @@
+/**
+ * SceneEditBench.hpp - Live scene editing benchmark.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCENEEDITBENCH_HPP
+#define _SCENEEDITBENCH_HPP
+
+#include "Options.hpp"
+
+
+/**
+ * Edit the first `options.scenes` (default "large") from another thread,
+ * publishing `options.frames` versions (default 300) to a SceneStore, while
+ * rendering whichever version is latest each frame. Edits move spheres,
+ * recolour lights, and add and remove spheres, so arrays share, copy,
+ * grow and shrink chunks. Checks that each update uploads exactly the bytes
+ * of the chunks that changed since the version before (or the whole array
+ * when its buffer grew), prints totals, and returns EXIT_FAILURE if any
+ * update didn't.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_scene_edit_benchmark(Options const &options);
+
+
+#endif
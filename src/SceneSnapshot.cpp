@@ -0,0 +1,78 @@
+/**
+ * SceneSnapshot.cpp - Immutable, versioned scenes sharing unchanged chunks.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SceneSnapshot.hpp"
+#include "ComputeRaytraceRenderer.hpp"
+
+#include <atomic>
+
+
+/* ===[ SceneSnapshot ]=== */
+
+SceneSnapshot::SceneSnapshot()
+:   version{0}
+,   materials{}
+,   spheres{}
+,   lights{}
+{
+}
+
+SceneSnapshot::SceneSnapshot(Scene const &scene)
+:   version{0}
+,   materials{scene.materials}
+,   spheres{scene.spheres}
+,   lights{scene.lights}
+{
+}
+
+Scene SceneSnapshot::toScene() const
+{
+    return Scene{
+        materials.toVector(), spheres.toVector(), lights.toVector()};
+}
+
+
+/* ===[ SceneStore ]=== */
+
+SceneStore::SceneStore(Scene const &scene)
+:   _latest{std::make_shared<SceneSnapshot const>(scene)}
+{
+}
+
+std::shared_ptr<SceneSnapshot const> SceneStore::latest() const
+{
+    return std::atomic_load(&_latest);
+}
+
+std::shared_ptr<SceneSnapshot const> SceneStore::update(
+    std::function<void(SceneSnapshot &)> const &edit)
+{
+    std::shared_ptr<SceneSnapshot const> base = latest();
+    for (;;)
+    {
+        auto const next = std::make_shared<SceneSnapshot>(*base);
+        edit(*next);
+        next->version = base->version + 1;
+        std::shared_ptr<SceneSnapshot const> published{next};
+        // On failure, base becomes the version that got in first.
+        if (std::atomic_compare_exchange_strong(&_latest, &base, published))
+        {
+            return published;
+        }
+    }
+}
@@ -0,0 +1,247 @@
+/**
+ * SceneSnapshot.hpp - Immutable, versioned scenes sharing unchanged chunks.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCENESNAPSHOT_HPP
+#define _SCENESNAPSHOT_HPP
+
+#include "ShaderStructs.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+struct Scene;
+
+
+/**
+ * An array stored as fixed-size chunks which are never modified once
+ * created. Copying one only copies the chunk pointers, and changing an
+ * element copies just its chunk, so versions of an array share every chunk
+ * they have in common and can be diffed by comparing chunk pointers.
+ * Copies can be read from any thread.
+ */
+template<typename T>
+class ChunkedArray
+{
+public:
+    /** Elements per chunk. Every chunk but the last is full. */
+    static size_t const CHUNK = 256;
+    typedef std::shared_ptr<std::vector<T> const> Chunk;
+
+private:
+    std::vector<Chunk> _chunks;
+    size_t _size;
+
+    /** Replace chunk `c` with a copy that can be changed. */
+    std::vector<T> &_copyChunk(size_t c)
+    {
+        auto const copy = std::make_shared<std::vector<T>>(*_chunks[c]);
+        _chunks[c] = copy;
+        return *copy;
+    }
+
+public:
+    ChunkedArray()
+    :   _chunks{}
+    ,   _size{0}
+    {
+    }
+
+    explicit ChunkedArray(std::vector<T> const &items)
+    :   _chunks{}
+    ,   _size{items.size()}
+    {
+        for (size_t i = 0; i < items.size(); i += CHUNK)
+        {
+            _chunks.push_back(std::make_shared<std::vector<T> const>(
+                items.begin() + i,
+                items.begin() + std::min(i + CHUNK, items.size())));
+        }
+    }
+
+    /** Number of elements. */
+    size_t size() const
+    {
+        return _size;
+    }
+    /** Number of chunks. */
+    size_t chunkCount() const
+    {
+        return _chunks.size();
+    }
+    /** Get chunk `c`, holding elements c * CHUNK onwards. */
+    Chunk const &chunk(size_t c) const
+    {
+        return _chunks.at(c);
+    }
+
+    /** Get element `i`. */
+    T const &operator[](size_t i) const
+    {
+        return (*_chunks[i / CHUNK])[i % CHUNK];
+    }
+
+    /**
+     * Changes elements of one array, copying each chunk at most once no
+     * matter how many of its elements change. The editor writes to its
+     * copies in place, so while it's in use the array must not be copied,
+     * or changed other than through it.
+     */
+    class Editor
+    {
+    private:
+        ChunkedArray &_array;
+        // This editor's copy of each chunk, or null if it has none yet.
+        std::vector<std::vector<T> *> _copies;
+    public:
+        explicit Editor(ChunkedArray &array)
+        :   _array(array)
+        ,   _copies(array.chunkCount(), nullptr)
+        {
+        }
+
+        /** Change element `i`. */
+        void set(size_t i, T const &value)
+        {
+            if (i >= _array._size)
+            {
+                throw std::out_of_range{
+                    "ChunkedArray::Editor::set - index out of range"};
+            }
+            size_t const c = i / CHUNK;
+            if (c >= _copies.size())
+            {
+                _copies.resize(_array.chunkCount(), nullptr);
+            }
+            if (!_copies[c])
+            {
+                _copies[c] = &_array._copyChunk(c);
+            }
+            (*_copies[c])[i % CHUNK] = value;
+        }
+    };
+
+    /**
+     * Change element `i`. Copies the chunk holding it, so use an Editor to
+     * change many elements.
+     */
+    void set(size_t i, T const &value)
+    {
+        if (i >= _size)
+        {
+            throw std::out_of_range{"ChunkedArray::set - index out of range"};
+        }
+        _copyChunk(i / CHUNK)[i % CHUNK] = value;
+    }
+    /** Append an element. Copies the last chunk, unless it's full. */
+    void push_back(T const &value)
+    {
+        if (_size % CHUNK == 0)
+        {
+            _chunks.push_back(
+                std::make_shared<std::vector<T> const>(1, value));
+        }
+        else
+        {
+            _copyChunk(_chunks.size() - 1).push_back(value);
+        }
+        ++_size;
+    }
+    /** Remove the last element. Copies the last chunk, unless it empties. */
+    void pop_back()
+    {
+        if (_size == 0)
+        {
+            throw std::out_of_range{"ChunkedArray::pop_back - empty array"};
+        }
+        if (_size % CHUNK == 1)
+        {
+            _chunks.pop_back();
+        }
+        else
+        {
+            _copyChunk(_chunks.size() - 1).pop_back();
+        }
+        --_size;
+    }
+
+    /** Copy the elements into one array. */
+    std::vector<T> toVector() const
+    {
+        std::vector<T> items{};
+        items.reserve(_size);
+        for (auto const &chunk : _chunks)
+        {
+            items.insert(items.end(), chunk->begin(), chunk->end());
+        }
+        return items;
+    }
+};
+
+
+/**
+ * One version of a scene. Edits are made to a copy, which only copies the
+ * chunks that change.
+ *  version - Increases with each version published to a SceneStore.
+ */
+struct SceneSnapshot
+{
+    uint64_t version;
+    ChunkedArray<Material> materials;
+    ChunkedArray<Sphere> spheres;
+    ChunkedArray<OmniLight> lights;
+
+    SceneSnapshot();
+    explicit SceneSnapshot(Scene const &scene);
+
+    /** Copy into a plain Scene. */
+    Scene toScene() const;
+};
+
+
+/**
+ * Holds the latest version of a scene, so editors can publish new versions
+ * while renderers take whichever is latest, without either waiting for the
+ * other. Snapshots stay valid as long as they're held.
+ */
+class SceneStore
+{
+private:
+    std::shared_ptr<SceneSnapshot const> _latest;
+public:
+    explicit SceneStore(Scene const &scene);
+
+    /** Get the latest version. */
+    std::shared_ptr<SceneSnapshot const> latest() const;
+
+    /**
+     * Publish a new version made by applying `edit` to a copy of the latest.
+     * If another version is published meanwhile, `edit` is applied again to
+     * that one, so edits never overwrite each other. Returns the version
+     * published.
+     */
+    std::shared_ptr<SceneSnapshot const> update(
+        std::function<void(SceneSnapshot &)> const &edit);
+};
+
+
+#endif
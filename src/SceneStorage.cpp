@@ -0,0 +1,98 @@
+/**
+ * SceneStorage.cpp - Storage backends for the scene arrays.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SceneStorage.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+
+static char const *const NAMES[] = {"ssbo", "ubo", "tbo", "auto"};
+
+
+bool operator==(SceneStorageConfig const &a, SceneStorageConfig const &b)
+{
+    return (
+        a.spheres == b.spheres && a.materials == b.materials
+        && a.lights == b.lights);
+}
+
+bool operator!=(SceneStorageConfig const &a, SceneStorageConfig const &b)
+{
+    return !(a == b);
+}
+
+SceneStorageConfig parse_scene_storage(std::string const &text)
+{
+    std::vector<SceneStorage> storages{};
+    size_t start = 0;
+    for (;;)
+    {
+        size_t const comma = text.find(',', start);
+        std::string const name = text.substr(
+            start, comma == std::string::npos? comma : comma - start);
+        bool found = false;
+        for (int i = STORAGE_SSBO; i <= STORAGE_AUTO; ++i)
+        {
+            if (name == NAMES[i])
+            {
+                storages.push_back((SceneStorage)i);
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            throw std::runtime_error{
+                "unknown scene storage '" + name
+                + "' (use ssbo, ubo, tbo or auto)"};
+        }
+        if (comma == std::string::npos)
+        {
+            break;
+        }
+        start = comma + 1;
+    }
+    if (storages.size() == 1)
+    {
+        return SceneStorageConfig{storages[0], storages[0], storages[0]};
+    }
+    if (storages.size() == 3)
+    {
+        return SceneStorageConfig{storages[0], storages[1], storages[2]};
+    }
+    throw std::runtime_error{
+        "scene storage '" + text
+        + "' needs one backend, or three for spheres, materials and lights"};
+}
+
+std::string scene_storage_name(SceneStorage storage)
+{
+    if (storage < STORAGE_SSBO || storage > STORAGE_AUTO)
+    {
+        throw std::runtime_error{"scene_storage_name - bad storage"};
+    }
+    return NAMES[storage];
+}
+
+std::string describe_scene_storage(SceneStorageConfig const &config)
+{
+    return (
+        "spheres " + scene_storage_name(config.spheres)
+        + ", materials " + scene_storage_name(config.materials)
+        + ", lights " + scene_storage_name(config.lights));
+}
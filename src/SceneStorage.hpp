@@ -0,0 +1,71 @@
+/**
+ * SceneStorage.hpp - Storage backends for the scene arrays.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCENESTORAGE_HPP
+#define _SCENESTORAGE_HPP
+
+#include <string>
+
+
+/**
+ * Where the compute shader reads a scene array from.
+ * NOTE: These must match the STORAGE_ defines in compute.comp.
+ */
+enum SceneStorage
+{
+    /** Shader storage buffer, of any size. */
+    STORAGE_SSBO = 0,
+    /** Uniform buffer, for arrays small enough to fit a uniform block. */
+    STORAGE_UBO = 1,
+    /** Buffer texture, read through the texture cache. */
+    STORAGE_TBO = 2,
+    /**
+     * Picked by the renderer: a uniform buffer if the array fits one, else
+     * a storage buffer, until ComputeRaytraceRenderer::tuneSceneStorage()
+     * times the choices.
+     */
+    STORAGE_AUTO = 3,
+};
+
+/** Storage backend of each scene array. */
+struct SceneStorageConfig
+{
+    SceneStorage spheres;
+    SceneStorage materials;
+    SceneStorage lights;
+};
+
+/** Check if two configurations pick the same backends. */
+bool operator==(SceneStorageConfig const &a, SceneStorageConfig const &b);
+bool operator!=(SceneStorageConfig const &a, SceneStorageConfig const &b);
+
+/**
+ * Parse a configuration: one of "ssbo", "ubo", "tbo" or "auto" for every
+ * array, or three separated by commas for spheres, materials and lights.
+ * Throws if it's malformed.
+ */
+SceneStorageConfig parse_scene_storage(std::string const &text);
+
+/** Name of a backend, as parse_scene_storage() takes it. */
+std::string scene_storage_name(SceneStorage storage);
+
+/** Describe a configuration, eg. "spheres ssbo, materials ubo, lights ubo". */
+std::string describe_scene_storage(SceneStorageConfig const &config);
+
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * Scenes.cpp - Built-in scenes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Scenes.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+
+/** Small deterministic RNG, so generated scenes are the same every run. */
+class SceneRNG
+{
+private:
+    uint32_t _state;
+public:
+    explicit SceneRNG(uint32_t seed)
+    :   _state{seed}
+    {
+    }
+
+    /** Uniform float in [lo, hi). */
+    GLfloat uniform(GLfloat lo, GLfloat hi)
+    {
+        // xorshift32
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return lo + (hi - lo) * (GLfloat)(_state >> 8) / (GLfloat)(1 << 24);
+    }
+};
+
+
+/** The original two-sphere demo scene. */
+static SceneSetup demo_scene()
+{
+    return SceneSetup{
+        {
+            {   // materials
+                {
+                    1.0f,
+                    1.0f,
+                    1.0f,
+                    15.0f,
+                    {1.0f, 1.0f, 1.0f}
+                },
+            },
+            {   // spheres
+                {
+                    {-0.4f, 0.0f, -2.0f},
+                    1.0f,
+                    0,
+                },
+                {
+                    {1.4f, 0.0f, -2.0f},
+                    0.25f,
+                    0,
+                },
+            },
+            {   // lights
+                {
+                    {0.0f, 1.0f, 0.0f},
+                    {0.9f, 1.0f, 0.9f},
+                },
+            },
+        },
+        {   // camera
+            {0.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, -1.0f},
+            {0.0f, 1.0f, 0.0f},
+            glm::radians(90.0f),
+        },
+        {0.0f, 0.05f, 0.1f},
+        {0.2f, 0.0f, 0.2f},
+    };
+}
+
+/** An 8x8 grid of spheres with a few materials and lights. */
+static SceneSetup grid_scene()
+{
+    SceneSetup setup{
+        {
+            {   // materials
+                {0.2f, 0.8f, 0.3f, 4.0f, {0.9f, 0.3f, 0.3f}},
+                {1.0f, 0.6f, 0.2f, 40.0f, {0.3f, 0.9f, 0.4f}},
+                {0.6f, 0.9f, 0.1f, 12.0f, {0.3f, 0.4f, 0.9f}},
+            },
+            {},
+            {   // lights
+                {{-4.0f, 4.0f, -2.0f}, {0.8f, 0.7f, 0.6f}},
+                {{4.0f, 3.0f, -6.0f}, {0.4f, 0.5f, 0.8f}},
+                {{0.0f, 6.0f, -12.0f}, {0.5f, 0.5f, 0.5f}},
+            },
+        },
+        {   // camera
+            {0.0f, 2.5f, 1.0f},
+            glm::normalize(glm::vec3{0.0f, -0.35f, -1.0f}),
+            {0.0f, 1.0f, 0.0f},
+            glm::radians(75.0f),
+        },
+        {0.05f, 0.05f, 0.08f},
+        {0.1f, 0.1f, 0.15f},
+    };
+    for (int z = 0; z < 8; ++z)
+    {
+        for (int x = 0; x < 8; ++x)
+        {
+            setup.scene.spheres.push_back({
+                {-3.5f + x, 0.0f, -2.0f - 1.2f * z},
+                0.4f,
+                (x + z) % 3});
+        }
+    }
+    return setup;
+}
+
+/** `count` randomly placed spheres. */
+static SceneSetup random_scene(size_t count, uint32_t seed)
+{
+    SceneRNG rng{seed};
+    SceneSetup setup{
+        {{}, {}, {}},
+        {   // camera
+            {0.0f, 0.0f, 4.0f},
+            {0.0f, 0.0f, -1.0f},
+            {0.0f, 1.0f, 0.0f},
+            glm::radians(70.0f),
+        },
+        {0.05f, 0.05f, 0.05f},
+        {0.0f, 0.0f, 0.0f},
+    };
+    for (int i = 0; i < 8; ++i)
+    {
+        setup.scene.materials.push_back({
+            rng.uniform(0.0f, 1.0f),
+            rng.uniform(0.3f, 1.0f),
+            rng.uniform(0.5f, 1.0f),
+            rng.uniform(2.0f, 60.0f),
+            {rng.uniform(0.2f, 1.0f), rng.uniform(0.2f, 1.0f),
+                rng.uniform(0.2f, 1.0f)}});
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        setup.scene.lights.push_back({
+            {rng.uniform(-6.0f, 6.0f), rng.uniform(2.0f, 6.0f),
+                rng.uniform(-6.0f, 2.0f)},
+            {rng.uniform(0.2f, 0.5f), rng.uniform(0.2f, 0.5f),
+                rng.uniform(0.2f, 0.5f)}});
+    }
+    // Shrink spheres as the count grows so the box doesn't fill up.
+    GLfloat const radius = 0.6f * std::cbrt(64.0f / (GLfloat)count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        setup.scene.spheres.push_back({
+            {rng.uniform(-4.0f, 4.0f), rng.uniform(-3.0f, 3.0f),
+                rng.uniform(-8.0f, 0.0f)},
+            rng.uniform(0.3f, 1.0f) * radius,
+            (GLint)(i % setup.scene.materials.size())});
+    }
+    return setup;
+}
+
+
+std::vector<std::string> builtin_scene_names()
+{
+    return {"demo", "grid", "random", "large"};
+}
+
+SceneSetup builtin_scene(std::string const &name)
+{
+    if (name == "demo")
+    {
+        return demo_scene();
+    }
+    else if (name == "grid")
+    {
+        return grid_scene();
+    }
+    else if (name == "random")
+    {
+        return random_scene(256, 1);
+    }
+    else if (name == "large")
+    {
+        return random_scene(4096, 2);
+    }
+    throw std::runtime_error{"no built-in scene named '" + name + "'"};
+}
+
+void configure_renderer(
+    ComputeRaytraceRenderer &renderer, SceneSetup const &setup)
+{
+    renderer.setCamera(setup.camera);
+    renderer.ambientColor = setup.ambientColor;
+    renderer.blankColor = setup.blankColor;
+}
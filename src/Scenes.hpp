@@ -0,0 +1,55 @@
+/**
+ * Scenes.hpp - Built-in scenes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCENES_HPP
+#define _SCENES_HPP
+
+#include "ComputeRaytraceRenderer.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * A Scene, plus everything else needed to render it.
+ *  scene - Scene data.
+ *  camera - Initial camera placement.
+ *  ambientColor - Renderer ambient light color.
+ *  blankColor - Renderer background color.
+ */
+struct SceneSetup
+{
+    Scene scene;
+    Camera camera;
+    glm::vec3 ambientColor;
+    glm::vec3 blankColor;
+};
+
+
+/** Get the names of the built-in scenes. */
+std::vector<std::string> builtin_scene_names();
+
+/** Get a built-in scene by name. Throws if there's no such scene. */
+SceneSetup builtin_scene(std::string const &name);
+
+/** Apply a SceneSetup's camera and colors to a renderer. */
+void configure_renderer(
+    ComputeRaytraceRenderer &renderer, SceneSetup const &setup);
+
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * ServiceProtocol.hpp - Wire format of render service requests.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SERVICEPROTOCOL_HPP
+#define _SERVICEPROTOCOL_HPP
+
+#include <cstdint>
+
+
+/**
+ * A render request, sent by a client. Everything is little-endian. Clients
+ * may send any number of requests without waiting for responses; each
+ * gets exactly one response, not necessarily in order.
+ *  magic - "RTRQ".
+ *  id - Chosen by the client, echoed in the response.
+ *  scene - Built-in scene name, NUL-padded.
+ *  width, height - Image size.
+ *  samples - Rays per pixel, at most the service's --serve-max-samples.
+ *  format - An ImageFormat: 0 for PPM, 1 for PNG, 2 for EXR.
+ *  sceneCamera - Non-zero to use the scene's own camera instead of
+ *                `camera`.
+ *  camera - Eye position, forward and up vectors, then the horizontal field
+ *           of view in radians.
+ */
+struct ServiceRequest
+{
+    char magic[4];
+    uint32_t id;
+    char scene[32];
+    uint32_t width, height;
+    uint32_t samples;
+    uint32_t format;
+    uint32_t sceneCamera;
+    float camera[10];
+};
+
+/**
+ * The response to a request, followed by `bytes` of image file in the
+ * requested format, or of error message if `status` is non-zero.
+ *  magic - "RTRS".
+ *  id - From the request.
+ *  status - 0 on success.
+ *  bytes - Size of what follows.
+ */
+struct ServiceResponse
+{
+    char magic[4];
+    uint32_t id;
+    uint32_t status;
+    uint32_t bytes;
+};
+
+
+#endif
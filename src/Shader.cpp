@@ -20,8 +20,11 @@
 
 #include <GL/glew.h>
 
+#include <fstream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 
 void _shader_delete(GLuint *shader)
@@ -34,6 +37,7 @@ void _shader_delete(GLuint *shader)
 Shader::Shader(GLenum type, std::string source, std::string label)
 :   _id{new GLuint{glCreateShader(type)}, _shader_delete}
 {
+    gl_call_count += 4;
     GLchar const *const src = source.c_str();
     glShaderSource(*_id, 1, &src, nullptr);
     glCompileShader(*_id);
@@ -58,3 +62,39 @@ GLuint Shader::id() const
 {
     return *_id;
 }
+
+
+Shader shader_from_file(
+    std::string path, GLenum type, std::vector<std::string> const &defines)
+{
+    std::ifstream shaderfile{path.c_str()};
+    if (!shaderfile)
+    {
+        throw std::runtime_error{"failed to open shader '" + path + "'"};
+    }
+    std::stringstream srcstream{};
+    srcstream << shaderfile.rdbuf();
+    shaderfile.close();
+    std::string source = srcstream.str();
+    if (!defines.empty())
+    {
+        // #version has to come first, so the defines go right after it.
+        std::string block{};
+        for (auto const &define : defines)
+        {
+            block += "#define " + define + "\n";
+        }
+        size_t const version = source.find("#version");
+        size_t const eol = (version == std::string::npos)?
+            std::string::npos : source.find('\n', version);
+        if (eol == std::string::npos)
+        {
+            source = block + source;
+        }
+        else
+        {
+            source.insert(eol + 1, block);
+        }
+    }
+    return Shader{type, source, path};
+}
@@ -69,5 +69,59 @@ struct OmniLight
     Color color;
 };
 
+/** Types of TraceEvent. */
+enum TraceEventType
+{
+    TRACE_RAY,          // a,b,c - Primary ray direction.
+    TRACE_SPHERE_TEST,  // a - Determinant. b,c - Intersection distances.
+    TRACE_HIT,          // a - Distance. b,c,d - Hit position.
+    TRACE_LIGHT,        // a - Diffuse dot. b - Specular dot. c - Luminance.
+    TRACE_RESULT,       // a,b,c,d - Final pixel color.
+};
+
+/**
+ * A step logged by the trace inspector kernel.
+ *  type - A TraceEventType.
+ *  object - Index of the sphere or light involved, or -1.
+ *  cost - Time spent so far. (GPU clocks or work units, see compute.comp)
+ *  data - Event-specific values.
+ */
+struct TraceEvent
+{
+    GLint type;
+    GLint object;
+    GLfloat cost;
+    GLfloat data[4];
+};
+
+/**
+ * A camera for MULTI_VIEW rendering. The w components are padding.
+ *  position - Eye position.
+ *  forward - Forward vector.
+ *  up - Up vector.
+ *  params - x is the field of view, in radians. y scales the side vector,
+ *           -1 mirrors the view horizontally.
+ */
+struct View
+{
+    GLfloat position[4];
+    GLfloat forward[4];
+    GLfloat up[4];
+    GLfloat params[4];
+};
+
+/**
+ * A small render for the JOB_BATCH kernel.
+ *  view - The job's camera.
+ *  rect - Bottom left corner of the job in the atlas, then its size.
+ *  scene - First sphere, sphere count, first light and light count.
+ */
+struct JobEntry
+{
+    View view;
+    GLint rect[4];
+    GLint scene[4];
+};
+
 
 #endif
@@ -0,0 +1,241 @@
+/**
+ * SharedFrameRing.cpp - Shared-memory frame output for other processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SharedFrameRing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+static char const RING_MAGIC[8] = {'R','T','F','R','A','M','E','S'};
+static uint32_t const RING_VERSION = 1;
+
+
+/** Round up to a multiple of 64, so slots don't share cache lines. */
+static size_t cache_align(size_t size)
+{
+    return (size + 63) / 64 * 64;
+}
+
+
+SharedFrameRing::SharedFrameRing(
+    std::string const &name, uint32_t slots, size_t slot_bytes)
+:   _name{name}
+,   _owner{true}
+,   _size{0}
+,   _memory{nullptr}
+{
+#ifdef _WIN32
+    throw std::runtime_error{"shared memory frame rings need POSIX"};
+#else
+    if (slots == 0)
+    {
+        throw std::runtime_error{"SharedFrameRing - need at least one slot"};
+    }
+    size_t const stride = cache_align(sizeof(SharedSlotHeader) + slot_bytes);
+    _size = cache_align(sizeof(SharedRingHeader)) + stride * slots;
+
+    // Replace any ring left behind by a crashed run.
+    shm_unlink(name.c_str());
+    int const fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        throw std::runtime_error{"shm_open - failed to create '" + name + "'"};
+    }
+    if (ftruncate(fd, (off_t)_size) != 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error{"ftruncate - failed to size '" + name + "'"};
+    }
+    _memory = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (_memory == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw std::runtime_error{"mmap - failed to map '" + name + "'"};
+    }
+
+    // New shared memory is zeroed, so the sequences and counts start at 0.
+    auto *const header = new (_memory) SharedRingHeader{};
+    std::memcpy(header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+    header->version = RING_VERSION;
+    header->slotCount = slots;
+    header->slotBytes = slot_bytes;
+    header->slotStride = stride;
+    for (uint32_t i = 0; i < slots; ++i)
+    {
+        new (_slot(i)) SharedSlotHeader{};
+    }
+    header->published.store(0, std::memory_order_release);
+#endif
+}
+
+SharedFrameRing::SharedFrameRing(std::string const &name)
+:   _name{name}
+,   _owner{false}
+,   _size{0}
+,   _memory{nullptr}
+{
+#ifdef _WIN32
+    throw std::runtime_error{"shared memory frame rings need POSIX"};
+#else
+    int const fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error{"shm_open - failed to open '" + name + "'"};
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0
+        || (size_t)info.st_size < sizeof(SharedRingHeader))
+    {
+        close(fd);
+        throw std::runtime_error{"'" + name + "' is not a frame ring"};
+    }
+    _size = (size_t)info.st_size;
+    _memory = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (_memory == MAP_FAILED)
+    {
+        _memory = nullptr;
+        throw std::runtime_error{"mmap - failed to map '" + name + "'"};
+    }
+    auto const *const header = (SharedRingHeader const *)_memory;
+    if (std::memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0
+        || header->version != RING_VERSION
+        || _size < (
+            cache_align(sizeof(SharedRingHeader))
+            + header->slotStride * header->slotCount))
+    {
+        munmap(_memory, _size);
+        _memory = nullptr;
+        throw std::runtime_error{
+            "'" + name + "' is not a compatible frame ring"};
+    }
+#endif
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+#ifndef _WIN32
+    if (_memory != nullptr)
+    {
+        munmap(_memory, _size);
+    }
+    if (_owner)
+    {
+        shm_unlink(_name.c_str());
+    }
+#endif
+}
+
+SharedSlotHeader *SharedFrameRing::_slot(uint64_t index) const
+{
+    auto const *const header = (SharedRingHeader const *)_memory;
+    return (SharedSlotHeader *)(
+        (char *)_memory + cache_align(sizeof(SharedRingHeader))
+        + header->slotStride * (index % header->slotCount));
+}
+
+uint64_t SharedFrameRing::published() const
+{
+    auto const *const header = (SharedRingHeader const *)_memory;
+    return header->published.load(std::memory_order_acquire);
+}
+
+void SharedFrameRing::publish(FrameReader::Frame const &frame)
+{
+    auto *const header = (SharedRingHeader *)_memory;
+    if (frame.data.size() > header->slotBytes)
+    {
+        throw std::runtime_error{
+            "SharedFrameRing::publish - frame is larger than a slot"};
+    }
+    uint64_t const index = header->published.load(std::memory_order_relaxed);
+    SharedSlotHeader *const slot = _slot(index);
+
+    // Odd sequence: readers of this slot will retry until it's even again.
+    uint64_t const sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frame = frame.tag;
+    slot->width = frame.width;
+    slot->height = frame.height;
+    slot->layout = frame.layout;
+    slot->bytes = (uint32_t)frame.data.size();
+    slot->timestamp = (uint64_t)std::chrono::duration_cast<
+        std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::memcpy((char *)(slot + 1), frame.data.data(), frame.data.size());
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header->published.store(index + 1, std::memory_order_release);
+}
+
+uint64_t SharedFrameRing::readLatest(
+    FrameReader::Frame &frame, uint64_t after, uint64_t *timestamp) const
+{
+    for (;;)
+    {
+        uint64_t const count = published();
+        if (count <= after)
+        {
+            return 0;
+        }
+        SharedSlotHeader const *const slot = _slot(count - 1);
+        uint64_t const before = slot->sequence.load(
+            std::memory_order_acquire);
+        if (before % 2 != 0)
+        {
+            // Mid-write; by the time it's done, it'll be a newer frame.
+            continue;
+        }
+        // The copy may race with the writer; the sequence check below
+        // throws away anything torn.
+        uint32_t const bytes = std::min<uint32_t>(
+            slot->bytes,
+            (uint32_t)((SharedRingHeader const *)_memory)->slotBytes);
+        frame.tag = (unsigned)slot->frame;
+        frame.width = slot->width;
+        frame.height = slot->height;
+        frame.layout = (PixelLayout)slot->layout;
+        uint64_t const stamp = slot->timestamp;
+        frame.data.resize(bytes);
+        std::memcpy(frame.data.data(), (char const *)(slot + 1), bytes);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == before)
+        {
+            if (timestamp != nullptr)
+            {
+                *timestamp = stamp;
+            }
+            return count;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * SharedFrameRing.hpp - Shared-memory frame output for other processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SHAREDFRAMERING_HPP
+#define _SHAREDFRAMERING_HPP
+
+#include "FrameReader.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+/**
+ * Header at the start of the shared memory.
+ *  magic - "RTFRAMES".
+ *  version - Layout version, currently 1.
+ *  slotCount - Number of frame slots.
+ *  slotBytes - Size of each slot's pixel data.
+ *  slotStride - Bytes from one slot header to the next.
+ *  published - Number of frames published so far. The newest is in slot
+ *              (published - 1) % slotCount.
+ */
+struct SharedRingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t slotCount;
+    uint64_t slotBytes;
+    uint64_t slotStride;
+    std::atomic<uint64_t> published;
+};
+
+/**
+ * Header of one frame slot, followed by its pixel data.
+ *  sequence - Seqlock: odd while the slot is being written.
+ *  frame - Frame number.
+ *  width, height - Image size.
+ *  layout - PixelLayout of the data.
+ *  bytes - Size of the data.
+ *  timestamp - Time the frame was published, in nanoseconds since the
+ *              steady clock's epoch.
+ */
+struct SharedSlotHeader
+{
+    std::atomic<uint64_t> sequence;
+    uint64_t frame;
+    uint32_t width, height;
+    uint32_t layout;
+    uint32_t bytes;
+    uint64_t timestamp;
+};
+
+
+/**
+ * A ring of frame slots in POSIX shared memory (/dev/shm). The renderer
+ * publishes frames into it and any number of other processes read them
+ * without locks, using each slot's sequence number as a seqlock: a reader
+ * copies a slot, and retries if the sequence was odd or changed while it
+ * copied. Readers never block the writer; a reader that falls a whole ring
+ * behind just skips frames.
+ *
+ * Only available on POSIX systems; elsewhere the constructors throw.
+ */
+class SharedFrameRing
+{
+private:
+    std::string const _name;
+    bool const _owner;
+    size_t _size;
+    void *_memory;
+
+    SharedSlotHeader *_slot(uint64_t index) const;
+public:
+    /**
+     * Create (or replace) a ring named `name`, eg. "/compute-frames".
+     * slots - Number of frame slots.
+     * slot_bytes - Largest frame that can be published.
+     */
+    SharedFrameRing(std::string const &name, uint32_t slots, size_t slot_bytes);
+    /** Open an existing ring for reading. */
+    explicit SharedFrameRing(std::string const &name);
+    /** Unmaps the ring, and removes it if this process created it. */
+    ~SharedFrameRing();
+
+    SharedFrameRing(SharedFrameRing const &) = delete;
+    SharedFrameRing &operator=(SharedFrameRing const &) = delete;
+
+    /** Number of frames published so far. */
+    uint64_t published() const;
+
+    /** Copy a frame into the next slot. Throws if it's too big. */
+    void publish(FrameReader::Frame const &frame);
+
+    /**
+     * Read the newest frame into `frame`, if it's newer than `after`
+     * published frames. Returns the frame's publish count (so pass it back
+     * as `after` next time), or 0 if there's nothing new.
+     */
+    uint64_t readLatest(
+        FrameReader::Frame &frame, uint64_t after=0,
+        uint64_t *timestamp=nullptr) const;
+};
+
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * Socket.cpp - Local stream sockets.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Socket.hpp"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+#ifndef _WIN32
+/** Throw a runtime_error describing errno. */
+static void throw_errno(std::string const &what)
+{
+    throw std::runtime_error{what + " - " + std::strerror(errno)};
+}
+#endif
+
+
+void _socket_close(int *fd)
+{
+#ifndef _WIN32
+    if (*fd >= 0)
+    {
+        close(*fd);
+    }
+#endif
+    delete fd;
+}
+
+
+Socket::Socket(int fd)
+:   _fd{new int{fd}, _socket_close}
+{
+}
+
+Socket Socket::listenTCP(unsigned short port)
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Socket::listenTCP - not supported on Windows"};
+#else
+    Socket sock{socket(AF_INET, SOCK_STREAM, 0)};
+    if (!sock.valid())
+    {
+        throw_errno("socket");
+    }
+    int const yes = 1;
+    setsockopt(sock.fd(), SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sock.fd(), (sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        throw_errno("bind(127.0.0.1:" + std::to_string(port) + ")");
+    }
+    if (listen(sock.fd(), 8) == -1)
+    {
+        throw_errno("listen");
+    }
+    return sock;
+#endif
+}
+
+#ifndef _WIN32
+/** Fill in a Unix domain socket address. */
+static sockaddr_un unix_address(std::string const &path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        throw std::runtime_error{"socket path too long: '" + path + "'"};
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+    return addr;
+}
+#endif
+
+Socket Socket::listenUnix(std::string const &path)
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Socket::listenUnix - not supported on Windows"};
+#else
+    Socket sock{socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (!sock.valid())
+    {
+        throw_errno("socket");
+    }
+    sockaddr_un const addr = unix_address(path);
+    // A stale socket file from an earlier run would make bind fail.
+    unlink(path.c_str());
+    if (bind(sock.fd(), (sockaddr const *)&addr, sizeof(addr)) == -1)
+    {
+        throw_errno("bind(" + path + ")");
+    }
+    if (listen(sock.fd(), 8) == -1)
+    {
+        throw_errno("listen");
+    }
+    return sock;
+#endif
+}
+
+Socket Socket::connectUnix(std::string const &path)
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Socket::connectUnix - not supported on Windows"};
+#else
+    Socket sock{socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (!sock.valid())
+    {
+        throw_errno("socket");
+    }
+    sockaddr_un const addr = unix_address(path);
+    if (connect(sock.fd(), (sockaddr const *)&addr, sizeof(addr)) == -1)
+    {
+        throw_errno("connect(" + path + ")");
+    }
+    return sock;
+#endif
+}
+
+int Socket::fd() const
+{
+    return *_fd;
+}
+
+bool Socket::valid() const
+{
+    return *_fd >= 0;
+}
+
+Socket Socket::accept() const
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Socket::accept - not supported on Windows"};
+#else
+    int const client = ::accept(*_fd, nullptr, nullptr);
+    if (client == -1)
+    {
+        throw_errno("accept");
+    }
+    return Socket{client};
+#endif
+}
+
+bool Socket::waitReadable(double timeout) const
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Socket::waitReadable - not supported on Windows"};
+#else
+    pollfd pfd{};
+    pfd.fd = *_fd;
+    pfd.events = POLLIN;
+    int const ms = timeout < 0.0? -1 : (int)(timeout * 1000.0);
+    int const r = poll(&pfd, 1, ms);
+    if (r == -1 && errno != EINTR)
+    {
+        throw_errno("poll");
+    }
+    return r > 0;
+#endif
+}
+
+void Socket::sendAll(void const *data, size_t size) const
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Socket::sendAll - not supported on Windows"};
+#else
+    auto bytes = (char const *)data;
+    while (size > 0)
+    {
+        ssize_t const n = send(*_fd, bytes, size, MSG_NOSIGNAL);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw_errno("send");
+        }
+        bytes += n;
+        size -= (size_t)n;
+    }
+#endif
+}
+
+void Socket::sendAll(std::string const &data) const
+{
+    sendAll(data.data(), data.size());
+}
+
+size_t Socket::recvSome(void *data, size_t size) const
+{
+#ifdef _WIN32
+    throw std::runtime_error{"Socket::recvSome - not supported on Windows"};
+#else
+    for (;;)
+    {
+        ssize_t const n = recv(*_fd, data, size, 0);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw_errno("recv");
+        }
+        return (size_t)n;
+    }
+#endif
+}
+
+bool Socket::recvAll(void *data, size_t size) const
+{
+    auto bytes = (char *)data;
+    while (size > 0)
+    {
+        size_t const n = recvSome(bytes, size);
+        if (n == 0)
+        {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+/**
+ * Socket.hpp - Local stream sockets.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOCKET_HPP
+#define _SOCKET_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+
+/** Deleter for Socket objects. (For use with shared_ptr and co.) */
+void _socket_close(int *fd);
+
+
+/**
+ * Stream socket file descriptor. Only available on POSIX systems; on other
+ * platforms the factory functions throw.
+ */
+class Socket
+{
+private:
+    std::shared_ptr<int> _fd;
+public:
+    /** Take ownership of an open file descriptor. */
+    explicit Socket(int fd=-1);
+
+    /** Listen for TCP connections on 127.0.0.1:port. */
+    static Socket listenTCP(unsigned short port);
+    /** Listen for connections on a Unix domain socket, replacing `path`. */
+    static Socket listenUnix(std::string const &path);
+    /** Connect to a Unix domain socket. */
+    static Socket connectUnix(std::string const &path);
+
+    /** Get the socket's file descriptor. */
+    int fd() const;
+    /** Check if the socket holds an open file descriptor. */
+    bool valid() const;
+
+    /** Accept a pending connection. */
+    Socket accept() const;
+    /**
+     * Wait up to `timeout` seconds for the socket to become readable. Returns
+     * true if it is readable. (A negative timeout waits forever)
+     */
+    bool waitReadable(double timeout) const;
+
+    /** Send the whole buffer, throwing on failure. */
+    void sendAll(void const *data, size_t size) const;
+    /** Send a string, throwing on failure. */
+    void sendAll(std::string const &data) const;
+    /** Receive up to `size` bytes. Returns 0 on EOF. */
+    size_t recvSome(void *data, size_t size) const;
+    /** Receive exactly `size` bytes. Returns false on EOF. */
+    bool recvAll(void *data, size_t size) const;
+};
+
+
+#endif
@@ -0,0 +1,446 @@
+/**
+ * SortLast.cpp - Depth-composited rendering of partitioned scenes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SortLast.hpp"
+#include "App.hpp"
+#include "Batch.hpp"
+#include "FarmProtocol.hpp"
+#include "ImageFile.hpp"
+#include "Scenes.hpp"
+#include "TileFarm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <thread>
+
+
+/** Seconds to wait for peers to start listening and connect. */
+static double const SORT_LAST_CONNECT_TIMEOUT = 30.0;
+
+
+std::vector<std::vector<Sphere>> partition_spheres(
+    std::vector<Sphere> const &spheres, unsigned parts)
+{
+    std::vector<std::vector<Sphere>> groups{spheres};
+    while (groups.size() < parts)
+    {
+        auto &group = *std::max_element(
+            groups.begin(), groups.end(),
+            [](std::vector<Sphere> const &a, std::vector<Sphere> const &b){
+                return a.size() < b.size();
+            });
+        // Widest axis of the sphere centers.
+        int axis = 0;
+        GLfloat widest = -1.0f;
+        for (int a = 0; a < 3; ++a)
+        {
+            auto const range = std::minmax_element(
+                group.begin(), group.end(),
+                [a](Sphere const &l, Sphere const &r){
+                    return l.position[a] < r.position[a];
+                });
+            GLfloat const width = group.empty()?
+                0.0f
+                : range.second->position[a] - range.first->position[a];
+            if (width > widest)
+            {
+                widest = width;
+                axis = a;
+            }
+        }
+        auto const middle = group.begin() + group.size() / 2;
+        std::nth_element(
+            group.begin(), middle, group.end(),
+            [axis](Sphere const &l, Sphere const &r){
+                return l.position[axis] < r.position[axis];
+            });
+        std::vector<Sphere> upper{middle, group.end()};
+        group.erase(middle, group.end());
+        groups.push_back(std::move(upper));
+    }
+    return groups;
+}
+
+
+int run_sort_last(Options const &options)
+{
+    unsigned const count = options.sortLastWorkers;
+    if ((count & (count - 1)) != 0)
+    {
+        throw std::runtime_error{
+            "--sort-last needs a power of two number of workers"};
+    }
+    // A pixel's colour averages every sample but its depth is only the
+    // nearest one, so keeping the nearer pixel is only exact for one.
+    if (options.samples != 1)
+    {
+        throw std::runtime_error{
+            "--sort-last composites one depth per pixel, so it needs"
+            " --samples 1"};
+    }
+    ImageFormat const format = image_format_from_path(
+        options.outputPattern);
+    if (image_format_layout(format) != PIXELS_RGB8)
+    {
+        throw std::runtime_error{
+            "--sort-last writes 8-bit images, use .ppm or .png"};
+    }
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    std::unique_ptr<CameraPath> path{};
+    unsigned frames = options.frames;
+    if (!options.cameraPath.empty())
+    {
+        path.reset(new CameraPath{options.cameraPath});
+        if (frames == 0)
+        {
+            frames = (unsigned)path->size();
+        }
+    }
+    frames = std::max(frames, 1u);
+
+    // Each worker only ever holds its own spheres. Materials and lights are
+    // small and every worker needs them all to shade.
+    std::string socket_path{};
+    std::vector<FarmWorker> workers = start_farm_workers(
+        options.program, {}, "--sort-last-worker", count, socket_path);
+    auto const groups = partition_spheres(setup.scene.spheres, count);
+    for (unsigned rank = 0; rank < count; ++rank)
+    {
+        FarmSceneHeader header{};
+        std::memcpy(header.magic, "RTFS", 4);
+        header.rank = rank;
+        header.workers = count;
+        header.width = options.width;
+        header.height = options.height;
+        header.samples = options.samples;
+        header.sphereCount = (uint32_t)groups[rank].size();
+        header.materialCount = (uint32_t)setup.scene.materials.size();
+        header.lightCount = (uint32_t)setup.scene.lights.size();
+        for (int c = 0; c < 3; ++c)
+        {
+            header.ambientColor[c] = setup.ambientColor[c];
+            header.blankColor[c] = setup.blankColor[c];
+        }
+        Socket const &socket = workers[rank].socket;
+        socket.sendAll(&header, sizeof(header));
+        socket.sendAll(
+            groups[rank].data(), groups[rank].size() * sizeof(Sphere));
+        socket.sendAll(
+            setup.scene.materials.data(),
+            setup.scene.materials.size() * sizeof(Material));
+        socket.sendAll(
+            setup.scene.lights.data(),
+            setup.scene.lights.size() * sizeof(OmniLight));
+    }
+
+    size_t const pixel_count = (size_t)options.width * options.height;
+    std::vector<GLfloat> image(pixel_count * 4);
+    auto const start = std::chrono::steady_clock::now();
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        FarmFrameRequest request{};
+        std::memcpy(request.magic, "RTFF", 4);
+        request.frame = frame;
+        Camera camera = setup.camera;
+        if (path)
+        {
+            camera = path->at(path->frameTime(frame, frames));
+        }
+        pack_camera(camera, request.camera);
+        for (auto const &worker : workers)
+        {
+            worker.socket.sendAll(&request, sizeof(request));
+        }
+
+        // After binary swap, each worker holds a finished part.
+        for (size_t w = 0; w < workers.size(); ++w)
+        {
+            FarmRegion region{};
+            Socket const &socket = workers[w].socket;
+            if (!socket.recvAll(&region, sizeof(region))
+                || std::memcmp(region.magic, "RTFC", 4) != 0
+                || region.frame != frame
+                || (size_t)region.begin + region.count > pixel_count
+                || !socket.recvAll(
+                    &image[(size_t)region.begin * 4],
+                    (size_t)region.count * 4 * sizeof(GLfloat)))
+            {
+                throw std::runtime_error{
+                    "sort-last worker " + std::to_string(w)
+                    + " failed or sent a bad region"};
+            }
+        }
+
+        // Rows come bottom first.
+        FrameReader::Frame out{};
+        out.tag = frame;
+        out.width = options.width;
+        out.height = options.height;
+        out.layout = PIXELS_RGB8;
+        out.data.resize(pixel_count * 3);
+        for (size_t y = 0; y < options.height; ++y)
+        {
+            GLfloat const *const row =
+                &image[(options.height - 1 - y) * options.width * 4];
+            for (size_t x = 0; x < options.width; ++x)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    out.data[(y * options.width + x) * 3 + c] =
+                        (unsigned char)(
+                            glm::clamp(row[x * 4 + c], 0.0f, 1.0f) * 255.0f
+                            + 0.5f);
+                }
+            }
+        }
+        write_image(
+            frame_path(options.outputPattern, frame), format, out);
+        std::clog << "\rFrame " << frame + 1 << "/" << frames << std::flush;
+    }
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::clog << "\n";
+
+    // Closing the connections tells the workers to exit.
+    for (auto &worker : workers)
+    {
+        worker.socket = Socket{};
+        worker.process.wait();
+    }
+    std::cout << frames << " frames with " << setup.scene.spheres.size()
+        << " spheres over " << count << " workers (at most "
+        << std::max_element(
+            groups.begin(), groups.end(),
+            [](std::vector<Sphere> const &a, std::vector<Sphere> const &b){
+                return a.size() < b.size();
+            })->size()
+        << " each) in " << seconds << " s: " << frames / seconds
+        << " fps\n";
+    return EXIT_SUCCESS;
+}
+
+
+/** Connect to a peer's socket, retrying until it's listening. */
+static Socket connect_peer(std::string const &path)
+{
+    auto const deadline = std::chrono::steady_clock::now()
+        + std::chrono::duration<double>(SORT_LAST_CONNECT_TIMEOUT);
+    for (;;)
+    {
+        try
+        {
+            return Socket::connectUnix(path);
+        }
+        catch (std::runtime_error const &)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                throw;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    }
+}
+
+
+int run_sort_last_worker(Options const &options)
+{
+    /* ===[ Scene ]=== */
+    Socket const coordinator = connect_farm_worker(
+        options.sortLastWorkerSocket);
+    FarmSceneHeader header{};
+    if (!coordinator.recvAll(&header, sizeof(header))
+        || std::memcmp(header.magic, "RTFS", 4) != 0
+        || header.workers == 0 || header.rank >= header.workers)
+    {
+        throw std::runtime_error{"sort-last worker - bad scene header"};
+    }
+    Scene scene{};
+    scene.spheres.resize(header.sphereCount);
+    scene.materials.resize(header.materialCount);
+    scene.lights.resize(header.lightCount);
+    if (!coordinator.recvAll(
+            scene.spheres.data(), scene.spheres.size() * sizeof(Sphere))
+        || !coordinator.recvAll(
+            scene.materials.data(),
+            scene.materials.size() * sizeof(Material))
+        || !coordinator.recvAll(
+            scene.lights.data(), scene.lights.size() * sizeof(OmniLight)))
+    {
+        throw std::runtime_error{"sort-last worker - scene cut short"};
+    }
+
+    /* ===[ Peers ]=== */
+    // In round r of binary swap, worker i exchanges with worker i ^ 2^r.
+    // Workers connect to lower-ranked partners and accept higher-ranked
+    // ones, which say who they are first.
+    uint32_t const rank = header.rank;
+    unsigned rounds = 0;
+    while ((1u << rounds) < header.workers)
+    {
+        ++rounds;
+    }
+    std::string const peer_path =
+        options.sortLastWorkerSocket + "." + std::to_string(rank);
+    Socket const listener = Socket::listenUnix(peer_path);
+    std::vector<Socket> peers(rounds);
+    unsigned accepts = 0;
+    for (unsigned r = 0; r < rounds; ++r)
+    {
+        uint32_t const partner = rank ^ (1u << r);
+        if (partner < rank)
+        {
+            peers[r] = connect_peer(
+                options.sortLastWorkerSocket + "."
+                + std::to_string(partner));
+            peers[r].sendAll(&rank, sizeof(rank));
+        }
+        else
+        {
+            ++accepts;
+        }
+    }
+    for (unsigned i = 0; i < accepts; ++i)
+    {
+        if (!listener.waitReadable(SORT_LAST_CONNECT_TIMEOUT))
+        {
+            throw std::runtime_error{"sort-last worker - peers missing"};
+        }
+        Socket const peer = listener.accept();
+        uint32_t partner = 0;
+        if (!peer.recvAll(&partner, sizeof(partner)))
+        {
+            throw std::runtime_error{"sort-last worker - bad peer"};
+        }
+        // The partner differs from this worker in just the round's bit.
+        uint32_t const bit = partner ^ rank;
+        if (partner >= header.workers || bit == 0 || (bit & (bit - 1)) != 0)
+        {
+            throw std::runtime_error{"sort-last worker - bad peer"};
+        }
+        unsigned r = 0;
+        while ((1u << r) != bit)
+        {
+            ++r;
+        }
+        peers[r] = peer;
+    }
+    std::remove(peer_path.c_str());
+
+    /* ===[ Renderer ]=== */
+    init_SDL();
+    App app{
+        "compute sort-last worker", (int)header.width, (int)header.height,
+        false};
+    app.setVSync(false);
+    ComputeRaytraceRenderer renderer{scene, header.width, header.height};
+    renderer.ambientColor = glm::vec3{
+        header.ambientColor[0], header.ambientColor[1],
+        header.ambientColor[2]};
+    renderer.blankColor = glm::vec3{
+        header.blankColor[0], header.blankColor[1], header.blankColor[2]};
+    if (header.samples != 1)
+    {
+        throw std::runtime_error{
+            "sort-last worker - depth compositing needs 1 sample per pixel"};
+    }
+    renderer.samplesPerPixel = header.samples;
+    renderer.depthInAlpha = true;
+
+    /* ===[ Frames ]=== */
+    FarmFrameRequest request{};
+    std::vector<GLfloat> incoming{};
+    while (coordinator.recvAll(&request, sizeof(request)))
+    {
+        if (std::memcmp(request.magic, "RTFF", 4) != 0)
+        {
+            throw std::runtime_error{"sort-last worker - bad frame request"};
+        }
+        renderer.setCamera(unpack_camera(request.camera));
+        renderer.render();
+        std::vector<GLfloat> pixels = renderer.readResult();
+
+        // Binary swap: each round, keep half of the current region, trade
+        // the other half with the partner, and composite what comes back.
+        size_t begin = 0;
+        size_t end = (size_t)header.width * header.height;
+        for (unsigned r = 0; r < rounds; ++r)
+        {
+            size_t const middle = (begin + end) / 2;
+            bool const upper = (rank & (1u << r)) != 0;
+            size_t const keep = upper? middle : begin;
+            size_t const keep_end = upper? end : middle;
+            size_t const give = upper? begin : middle;
+            size_t const give_end = upper? middle : end;
+
+            std::exception_ptr send_error{};
+            std::thread sender{[&](){
+                try
+                {
+                    peers[r].sendAll(
+                        &pixels[give * 4],
+                        (give_end - give) * 4 * sizeof(GLfloat));
+                }
+                catch (...)
+                {
+                    send_error = std::current_exception();
+                }
+            }};
+            incoming.resize((keep_end - keep) * 4);
+            bool const received = peers[r].recvAll(
+                incoming.data(), incoming.size() * sizeof(GLfloat));
+            sender.join();
+            if (send_error)
+            {
+                std::rethrow_exception(send_error);
+            }
+            if (!received)
+            {
+                throw std::runtime_error{"sort-last worker - peer left"};
+            }
+            // Nearest hit wins. Every worker draws the same background,
+            // which is never in front of anything.
+            for (size_t i = 0; i < keep_end - keep; ++i)
+            {
+                GLfloat *const mine = &pixels[(keep + i) * 4];
+                GLfloat const *const theirs = &incoming[i * 4];
+                if (theirs[3] < mine[3])
+                {
+                    std::copy(theirs, theirs + 4, mine);
+                }
+            }
+            begin = keep;
+            end = keep_end;
+        }
+
+        FarmRegion region{};
+        std::memcpy(region.magic, "RTFC", 4);
+        region.frame = request.frame;
+        region.begin = (uint32_t)begin;
+        region.count = (uint32_t)(end - begin);
+        coordinator.sendAll(&region, sizeof(region));
+        coordinator.sendAll(
+            &pixels[begin * 4], (end - begin) * 4 * sizeof(GLfloat));
+    }
+    return EXIT_SUCCESS;
+}
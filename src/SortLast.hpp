@@ -0,0 +1,52 @@
+/**
+ * SortLast.hpp - Depth-composited rendering of partitioned scenes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SORTLAST_HPP
+#define _SORTLAST_HPP
+
+#include "ShaderStructs.hpp"
+#include "Options.hpp"
+
+#include <vector>
+
+
+/**
+ * Split spheres into `parts` spatially compact groups, by repeatedly
+ * halving the largest group at the median of its widest axis.
+ */
+std::vector<std::vector<Sphere>> partition_spheres(
+    std::vector<Sphere> const &spheres, unsigned parts);
+
+/**
+ * Render `options.frames` frames with the scene's spheres partitioned
+ * between `options.sortLastWorkers` worker processes. Each worker renders
+ * its spheres to color and depth, then the workers depth-composite their
+ * images with binary swap, and send their finished parts back to be
+ * written as images named by `options.outputPattern`.
+ */
+int run_sort_last(Options const &options);
+
+/**
+ * Worker side of run_sort_last(), for the coordinator on the Unix socket
+ * `options.sortLastWorkerSocket`.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_sort_last_worker(Options const &options);
+
+
+#endif
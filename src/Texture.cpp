@@ -32,6 +32,7 @@ Texture::Texture(GLenum type, std::string label)
 :   _id{new GLuint{0}, _texture_delete}
 ,   _type{type}
 {
+    gl_call_count += 3;
     glGenTextures(1, _id.get());
     glBindTexture(type, *_id);
     if (!label.empty())
@@ -52,15 +53,18 @@ GLuint Texture::type() const
 
 void Texture::bind() const
 {
+    ++gl_call_count;
     glBindTexture(_type, *_id);
 }
 
 void Texture::unbind() const
 {
+    ++gl_call_count;
     glBindTexture(_type, 0);
 }
 
 void Texture::setParameter(GLenum pname, GLint param)
 {
+    ++gl_call_count;
     glTexParameteri(_type, pname, param);
 }
@@ -0,0 +1,355 @@
+/**
+ * TileFarm.cpp - Sort-first tiled rendering across worker processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TileFarm.hpp"
+#include "App.hpp"
+#include "Batch.hpp"
+#include "FarmProtocol.hpp"
+#include "FrameReader.hpp"
+#include "Scenes.hpp"
+#include "TiledRender.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+
+
+/** Tile requests kept queued at each worker, hiding the round trip. */
+static unsigned const FARM_DEPTH = 2;
+
+/** Seconds to wait for workers to start and connect. */
+static double const FARM_CONNECT_TIMEOUT = 30.0;
+
+
+std::vector<FarmWorker> start_farm_workers(
+    std::string const &program, std::vector<std::string> const &args,
+    std::string const &flag, unsigned count, std::string &socket_path)
+{
+    std::random_device random{};
+    socket_path = "/tmp/compute-farm-" + std::to_string(random()) + ".sock";
+    Socket const listener = Socket::listenUnix(socket_path);
+    std::vector<std::string> worker_args{args};
+    worker_args.push_back(flag);
+    worker_args.push_back(socket_path);
+    std::vector<Process> processes{};
+    for (unsigned i = 0; i < count; ++i)
+    {
+        processes.push_back(Process::spawn(program, worker_args));
+    }
+    // Workers can connect in any order, so pair each connection with its
+    // process by the pid it says hello with.
+    std::vector<FarmWorker> workers(count);
+    for (unsigned connected = 0; connected < count; ++connected)
+    {
+        Socket socket{};
+        FarmHello hello{};
+        if (listener.waitReadable(FARM_CONNECT_TIMEOUT))
+        {
+            socket = listener.accept();
+        }
+        if (!socket.valid()
+            || !socket.waitReadable(FARM_CONNECT_TIMEOUT)
+            || !socket.recvAll(&hello, sizeof(hello))
+            || std::memcmp(hello.magic, "RTFH", 4) != 0)
+        {
+            std::remove(socket_path.c_str());
+            throw std::runtime_error{"farm workers failed to connect"};
+        }
+        auto const it = std::find_if(
+            processes.begin(), processes.end(),
+            [&hello](Process const &p){
+                return p.pid() == (int)hello.pid;
+            });
+        size_t const i = it - processes.begin();
+        if (it == processes.end() || workers[i].socket.valid())
+        {
+            std::remove(socket_path.c_str());
+            throw std::runtime_error{
+                "farm worker with unknown pid " + std::to_string(hello.pid)
+                + " connected"};
+        }
+        workers[i].process = processes[i];
+        workers[i].socket = socket;
+        workers[i].tiles = 0;
+        workers[i].frames = 0;
+        workers[i].busy = 0.0;
+    }
+    std::remove(socket_path.c_str());
+    return workers;
+}
+
+Socket connect_farm_worker(std::string const &path)
+{
+    Socket socket = Socket::connectUnix(path);
+    FarmHello hello{};
+    std::memcpy(hello.magic, "RTFH", 4);
+    hello.pid = (uint32_t)Process::current();
+    socket.sendAll(&hello, sizeof(hello));
+    return socket;
+}
+
+void pack_camera(Camera const &camera, float fields[10])
+{
+    float const packed[10] = {
+        camera.position.x, camera.position.y, camera.position.z,
+        camera.forward.x, camera.forward.y, camera.forward.z,
+        camera.up.x, camera.up.y, camera.up.z,
+        camera.fov};
+    std::memcpy(fields, packed, sizeof(packed));
+}
+
+Camera unpack_camera(float const fields[10])
+{
+    return Camera{
+        glm::vec3{fields[0], fields[1], fields[2]},
+        glm::vec3{fields[3], fields[4], fields[5]},
+        glm::vec3{fields[6], fields[7], fields[8]},
+        fields[9]};
+}
+
+
+int run_farm(Options const &options)
+{
+    if (options.tiledWidth == 0)
+    {
+        throw std::runtime_error{"--farm needs an image size, see --tiled"};
+    }
+    GLuint const tile = options.tileSize;
+    std::string const scene = options.scenes.empty()?
+        "demo" : options.scenes.front();
+    // The coordinator only needs the scene's camera; it never renders.
+    SceneSetup const setup = builtin_scene(scene);
+    std::unique_ptr<CameraPath> path{};
+    unsigned frames = options.frames;
+    if (!options.cameraPath.empty())
+    {
+        path.reset(new CameraPath{options.cameraPath});
+        if (frames == 0)
+        {
+            frames = (unsigned)path->size();
+        }
+    }
+    frames = std::max(frames, 1u);
+
+    // Start the workers, which connect back to a private socket.
+    std::string socket_path{};
+    std::vector<FarmWorker> workers = start_farm_workers(
+        options.program,
+        {   "--scene", scene,
+            "--samples", std::to_string(options.samples),
+            "--tile-size", std::to_string(tile)},
+        "--farm-worker", options.farmWorkers, socket_path);
+
+    // Measured cost of each tile in the previous frame. Expensive tiles are
+    // handed out first, so the last tiles of a frame are the cheap ones and
+    // workers finish together.
+    uint64_t const across = (options.tiledWidth + tile - 1) / tile;
+    uint64_t const down = (options.tiledHeight + tile - 1) / tile;
+    std::vector<float> cost(across * down, 0.0f);
+    std::vector<uint32_t> order(cost.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    auto const start = std::chrono::steady_clock::now();
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        Camera camera = setup.camera;
+        if (path)
+        {
+            camera = path->at(path->frameTime(frame, frames));
+        }
+        std::string const output = frame_path(options.tiledOutput, frame);
+        TiledTiffWriter tiff{
+            output, options.tiledWidth, options.tiledHeight, tile};
+        std::stable_sort(
+            order.begin(), order.end(),
+            [&cost](uint32_t a, uint32_t b){ return cost[a] > cost[b]; });
+
+        // One thread per worker pulls tiles from the shared order.
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> finished{0};
+        std::mutex tiff_lock{};
+        std::vector<std::exception_ptr> errors(workers.size());
+        std::vector<std::thread> threads{};
+        for (size_t w = 0; w < workers.size(); ++w)
+        {
+            threads.emplace_back([&, w](){
+                FarmWorker &worker = workers[w];
+                try
+                {
+                    auto const send_next = [&](){
+                        size_t const k = next++;
+                        if (k >= order.size())
+                        {
+                            return false;
+                        }
+                        uint32_t const index = order[k];
+                        FarmTileRequest request{};
+                        std::memcpy(request.magic, "RTFT", 4);
+                        request.frame = frame;
+                        request.tile = index;
+                        // TIFF tiles count down from the top, the renderer
+                        // counts up from the bottom.
+                        request.x = (int32_t)(index % across * tile);
+                        request.y = (int32_t)options.tiledHeight
+                            - (int32_t)((index / across + 1) * tile);
+                        request.fullWidth = options.tiledWidth;
+                        request.fullHeight = options.tiledHeight;
+                        pack_camera(camera, request.camera);
+                        worker.socket.sendAll(&request, sizeof(request));
+                        return true;
+                    };
+                    unsigned pending = 0;
+                    while (pending < FARM_DEPTH && send_next())
+                    {
+                        ++pending;
+                    }
+                    std::vector<unsigned char> rgb{};
+                    for (; pending > 0; --pending)
+                    {
+                        FarmTileResult result{};
+                        if (!worker.socket.recvAll(&result, sizeof(result))
+                            || std::memcmp(result.magic, "RTFR", 4) != 0
+                            || result.tile >= cost.size()
+                            || result.bytes != tile * tile * 3)
+                        {
+                            throw std::runtime_error{
+                                "farm worker " + std::to_string(w)
+                                + " failed or sent a bad tile"};
+                        }
+                        rgb.resize(result.bytes);
+                        if (!worker.socket.recvAll(rgb.data(), rgb.size()))
+                        {
+                            throw std::runtime_error{
+                                "farm worker " + std::to_string(w)
+                                + " disconnected"};
+                        }
+                        cost[result.tile] = result.milliseconds;
+                        worker.tiles += 1;
+                        worker.busy += result.milliseconds;
+                        {
+                            std::lock_guard<std::mutex> lock{tiff_lock};
+                            tiff.writeTile(
+                                result.tile % across, result.tile / across,
+                                rgb);
+                        }
+                        ++finished;
+                        if (send_next())
+                        {
+                            ++pending;
+                        }
+                    }
+                }
+                catch (...)
+                {
+                    errors[w] = std::current_exception();
+                }
+            });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        for (auto const &error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+        tiff.finish();
+        std::clog << "\rFrame " << frame + 1 << "/" << frames << std::flush;
+    }
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::clog << "\n";
+
+    // Closing the connections tells the workers to exit.
+    for (auto &worker : workers)
+    {
+        worker.socket = Socket{};
+        worker.process.wait();
+    }
+
+    double const pixels =
+        (double)options.tiledWidth * options.tiledHeight * frames;
+    std::cout << frames << " frames of " << options.tiledWidth << "x"
+        << options.tiledHeight << " on " << workers.size() << " workers in "
+        << seconds << " s (" << pixels / seconds / 1.0e6 << " Mpixel/s)\n";
+    for (size_t w = 0; w < workers.size(); ++w)
+    {
+        std::cout << "  worker " << w << ": " << workers[w].tiles
+            << " tiles, busy " << workers[w].busy / 1000.0 << " s\n";
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int run_farm_worker(Options const &options)
+{
+    Socket const socket = connect_farm_worker(options.farmWorkerSocket);
+    GLuint const tile = options.tileSize;
+
+    init_SDL();
+    App app{"compute farm worker", (int)tile, (int)tile, false};
+    app.setVSync(false);
+
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    ComputeRaytraceRenderer renderer{setup.scene, tile, tile};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+
+    FrameReader reader{1};
+    FrameReader::Frame frame{};
+    FarmTileRequest request{};
+    while (socket.recvAll(&request, sizeof(request)))
+    {
+        if (std::memcmp(request.magic, "RTFT", 4) != 0)
+        {
+            throw std::runtime_error{"farm worker - bad tile request"};
+        }
+        auto const start = std::chrono::steady_clock::now();
+        renderer.setCamera(unpack_camera(request.camera));
+        renderer.tileOffset = glm::ivec2{request.x, request.y};
+        renderer.fullSize = glm::ivec2{
+            (int)request.fullWidth, (int)request.fullHeight};
+        renderer.render();
+        reader.read(
+            renderer.getResult(), tile, tile, PIXELS_RGB8, request.tile);
+        reader.collect(frame, true);
+
+        FarmTileResult result{};
+        std::memcpy(result.magic, "RTFR", 4);
+        result.frame = request.frame;
+        result.tile = request.tile;
+        result.milliseconds = std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        result.bytes = (uint32_t)frame.data.size();
+        socket.sendAll(&result, sizeof(result));
+        socket.sendAll(frame.data.data(), frame.data.size());
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/**
+ * TileFarm.hpp - Sort-first tiled rendering across worker processes.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TILEFARM_HPP
+#define _TILEFARM_HPP
+
+#include "ComputeRaytraceRenderer.hpp"
+#include "Options.hpp"
+#include "Process.hpp"
+#include "Socket.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * A worker process and its connection.
+ *  process - The worker.
+ *  socket - Connection to it.
+ *  tiles - Tiles it rendered in total, in a tile farm.
+ *  frames - Frames it rendered in total, in a frame pool.
+ *  busy - Milliseconds it reported spending on them.
+ */
+struct FarmWorker
+{
+    Process process;
+    Socket socket;
+    uint64_t tiles;
+    uint64_t frames;
+    double busy;
+};
+
+/**
+ * Start `count` worker processes running `program` with `args`, followed by
+ * `flag` and the path of a new private Unix socket they should connect to
+ * with connect_farm_worker(). Connections are paired with their processes
+ * by the pid in the worker's FarmHello, and the workers returned in the
+ * order they were started. Sets `socket_path`. Throws if any fail to
+ * connect in time.
+ */
+std::vector<FarmWorker> start_farm_workers(
+    std::string const &program, std::vector<std::string> const &args,
+    std::string const &flag, unsigned count, std::string &socket_path);
+
+/**
+ * Connect a worker to its coordinator's socket and send the FarmHello
+ * start_farm_workers() expects.
+ */
+Socket connect_farm_worker(std::string const &path);
+
+/** Pack a camera as sent in farm messages. */
+void pack_camera(Camera const &camera, float fields[10]);
+/** Unpack a camera sent in a farm message. */
+Camera unpack_camera(float const fields[10]);
+
+
+/**
+ * Render `options.frames` frames of a `options.tiledWidth` x
+ * `options.tiledHeight` image across `options.farmWorkers` worker
+ * processes, each with its own renderer and context. Tiles are handed out
+ * as workers finish them, costliest first by what they took last frame,
+ * and are streamed to a tiled TIFF per frame.
+ */
+int run_farm(Options const &options);
+
+/**
+ * Worker side of run_farm(): render tiles requested over the Unix socket
+ * `options.farmWorkerSocket` until it's closed.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_farm_worker(Options const &options);
+
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * TiledRender.cpp - Rendering images larger than a texture, tile by tile.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TiledRender.hpp"
+#include "App.hpp"
+#include "ComputeRaytraceRenderer.hpp"
+#include "FrameReader.hpp"
+#include "Scenes.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+
+/* ===[ TiledTiffWriter ]=== */
+
+/** TIFF field types. */
+enum TiffType : uint16_t
+{
+    TIFF_SHORT = 3,
+    TIFF_LONG = 4,
+    TIFF_LONG8 = 16,
+};
+
+/** Append little-endian integers to a byte string. */
+template<typename T>
+static void put_le(std::string &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out.push_back((char)((uint64_t)value >> (8 * i)));
+    }
+}
+
+/**
+ * Append a BigTIFF directory entry. `value` is the inline value, or the
+ * offset of the values if they don't fit in 8 bytes.
+ */
+static void put_entry(
+    std::string &out, uint16_t tag, TiffType type, uint64_t count,
+    uint64_t value)
+{
+    put_le(out, tag);
+    put_le(out, (uint16_t)type);
+    put_le(out, count);
+    put_le(out, value);
+}
+
+
+TiledTiffWriter::TiledTiffWriter(
+    std::string const &path, uint64_t width, uint64_t height, uint32_t tile)
+:   _file{path.c_str(), std::ios::binary}
+,   _path{path}
+,   _width{width}
+,   _height{height}
+,   _tile{tile}
+,   _across{(width + tile - 1) / tile}
+,   _down{(height + tile - 1) / tile}
+,   _offsets(_across * _down, 0)
+,   _finished{false}
+{
+    if (!_file)
+    {
+        throw std::runtime_error{"failed to open '" + path + "'"};
+    }
+    if (tile == 0 || tile % 16 != 0)
+    {
+        throw std::runtime_error{"TIFF tile size must be a multiple of 16"};
+    }
+    // Header; the directory offset is filled in by finish().
+    std::string header{"II"};
+    put_le(header, (uint16_t)43);
+    put_le(header, (uint16_t)8);
+    put_le(header, (uint16_t)0);
+    put_le(header, (uint64_t)0);
+    _file.write(header.data(), header.size());
+}
+
+TiledTiffWriter::~TiledTiffWriter()
+{
+    if (!_finished)
+    {
+        try
+        {
+            finish();
+        }
+        catch (std::exception const &)
+        {
+        }
+    }
+}
+
+uint64_t TiledTiffWriter::tilesAcross() const
+{
+    return _across;
+}
+
+uint64_t TiledTiffWriter::tilesDown() const
+{
+    return _down;
+}
+
+void TiledTiffWriter::writeTile(
+    uint64_t x, uint64_t y, std::vector<unsigned char> const &rgb)
+{
+    if (x >= _across || y >= _down)
+    {
+        throw std::runtime_error{"TiledTiffWriter::writeTile - bad tile"};
+    }
+    if (rgb.size() != (size_t)_tile * _tile * 3)
+    {
+        throw std::runtime_error{
+            "TiledTiffWriter::writeTile - wrong tile size"};
+    }
+    _offsets[y * _across + x] = (uint64_t)_file.tellp();
+    _file.write((char const *)rgb.data(), rgb.size());
+    if (!_file)
+    {
+        throw std::runtime_error{"failed to write '" + _path + "'"};
+    }
+}
+
+void TiledTiffWriter::finish()
+{
+    _finished = true;
+    for (auto offset : _offsets)
+    {
+        if (offset == 0)
+        {
+            throw std::runtime_error{
+                "TiledTiffWriter::finish - missing tiles in '" + _path
+                + "'"};
+        }
+    }
+    uint64_t const tiles = _offsets.size();
+    uint64_t const tile_bytes = (uint64_t)_tile * _tile * 3;
+
+    // Out-of-line tile offset and byte count arrays. A single tile fits
+    // inline.
+    std::string arrays{};
+    uint64_t offsets_at = _offsets[0];
+    uint64_t counts_at = tile_bytes;
+    if (tiles > 1)
+    {
+        offsets_at = (uint64_t)_file.tellp();
+        for (auto offset : _offsets)
+        {
+            put_le(arrays, offset);
+        }
+        counts_at = offsets_at + arrays.size();
+        for (uint64_t i = 0; i < tiles; ++i)
+        {
+            put_le(arrays, tile_bytes);
+        }
+    }
+    _file.write(arrays.data(), arrays.size());
+
+    // The directory, with entries in ascending tag order.
+    uint64_t const directory = (uint64_t)_file.tellp();
+    std::string ifd{};
+    put_le(ifd, (uint64_t)11);
+    put_entry(ifd, 256, TIFF_LONG, 1, _width); // ImageWidth
+    put_entry(ifd, 257, TIFF_LONG, 1, _height); // ImageLength
+    // BitsPerSample: three 8s, packed inline.
+    put_entry(ifd, 258, TIFF_SHORT, 3, 0x0000000800080008ull);
+    put_entry(ifd, 259, TIFF_SHORT, 1, 1); // Compression: none
+    put_entry(ifd, 262, TIFF_SHORT, 1, 2); // Photometric: RGB
+    put_entry(ifd, 277, TIFF_SHORT, 1, 3); // SamplesPerPixel
+    put_entry(ifd, 284, TIFF_SHORT, 1, 1); // PlanarConfiguration: chunky
+    put_entry(ifd, 322, TIFF_LONG, 1, _tile); // TileWidth
+    put_entry(ifd, 323, TIFF_LONG, 1, _tile); // TileLength
+    put_entry(ifd, 324, TIFF_LONG8, tiles, offsets_at); // TileOffsets
+    put_entry(ifd, 325, TIFF_LONG8, tiles, counts_at); // TileByteCounts
+    put_le(ifd, (uint64_t)0);
+    _file.write(ifd.data(), ifd.size());
+
+    // Point the header at the directory.
+    std::string offset{};
+    put_le(offset, directory);
+    _file.seekp(8);
+    _file.write(offset.data(), offset.size());
+    _file.close();
+    if (!_file)
+    {
+        throw std::runtime_error{"failed to write '" + _path + "'"};
+    }
+}
+
+
+/* ===[ Tiled Rendering ]=== */
+
+int run_tiled(Options const &options)
+{
+    GLuint const tile = options.tileSize;
+    TiledTiffWriter tiff{
+        options.tiledOutput, options.tiledWidth, options.tiledHeight, tile};
+
+    init_SDL();
+    App app{"compute tiled", (int)tile, (int)tile, false};
+    app.setVSync(false);
+
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
+    ComputeRaytraceRenderer renderer{setup.scene, tile, tile};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+    renderer.fullSize = glm::ivec2{
+        (int)options.tiledWidth, (int)options.tiledHeight};
+
+    // Tile N is read back while tile N+1 renders. Edge tiles are rendered
+    // whole; the extra pixels are stored as TIFF padding.
+    uint64_t const across = tiff.tilesAcross();
+    uint64_t const count = across * tiff.tilesDown();
+    FrameReader reader{};
+    FrameReader::Frame done{};
+    auto const hand_off = [&](){
+        tiff.writeTile(done.tag % across, done.tag / across, done.data);
+        if ((done.tag + 1) % 64 == 0 || done.tag + 1 == count)
+        {
+            std::clog << "\rTile " << done.tag + 1 << "/" << count
+                << std::flush;
+        }
+    };
+
+    auto const start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        // TIFF tiles count down from the top, the renderer counts up from
+        // the bottom.
+        uint64_t const x = i % across;
+        uint64_t const y = i / across;
+        renderer.tileOffset = glm::ivec2{
+            (int)(x * tile),
+            (int)options.tiledHeight - (int)((y + 1) * tile)};
+        renderer.render();
+        if (reader.full() && reader.collect(done, true))
+        {
+            hand_off();
+        }
+        reader.read(
+            renderer.getResult(), tile, tile, PIXELS_RGB8, (unsigned)i);
+        while (reader.collect(done))
+        {
+            hand_off();
+        }
+    }
+    while (reader.collect(done, true))
+    {
+        hand_off();
+    }
+    tiff.finish();
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::clog << "\n";
+
+    double const pixels = (double)options.tiledWidth * options.tiledHeight;
+    std::cout << "Wrote " << options.tiledOutput << ": "
+        << options.tiledWidth << "x" << options.tiledHeight << " in "
+        << count << " tiles, " << seconds << " s ("
+        << pixels / seconds / 1.0e6 << " Mpixel/s)\n";
+    return EXIT_SUCCESS;
+}
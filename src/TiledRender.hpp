@@ -0,0 +1,81 @@
+/**
+ * TiledRender.hpp - Rendering images larger than a texture, tile by tile.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TILEDRENDER_HPP
+#define _TILEDRENDER_HPP
+
+#include "Options.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+/**
+ * Writes a tiled, uncompressed 8-bit RGB BigTIFF one tile at a time. Tiles
+ * go straight to disk in any order, and only their offsets are kept in
+ * memory, so memory use doesn't depend on the image size.
+ */
+class TiledTiffWriter
+{
+private:
+    std::ofstream _file;
+    std::string const _path;
+    uint64_t const _width, _height;
+    uint32_t const _tile;
+    uint64_t const _across, _down;
+    std::vector<uint64_t> _offsets;
+    bool _finished;
+
+public:
+    /**
+     * width, height - Full image size.
+     * tile - Tile width and height. Must be a multiple of 16.
+     */
+    TiledTiffWriter(
+        std::string const &path, uint64_t width, uint64_t height,
+        uint32_t tile);
+    /** Finishes the file if finish() wasn't called. (Ignoring errors) */
+    ~TiledTiffWriter();
+
+    /** Number of tiles across and down. */
+    uint64_t tilesAcross() const;
+    uint64_t tilesDown() const;
+
+    /**
+     * Write tile (x, y), counting from the top left. `rgb` is a whole tile of
+     * 8-bit RGB, top row first, including any part past the image's edges.
+     */
+    void writeTile(
+        uint64_t x, uint64_t y, std::vector<unsigned char> const &rgb);
+
+    /** Write the directory. Throws if any tile is missing. */
+    void finish();
+};
+
+
+/**
+ * Render a `options.tiledWidth` x `options.tiledHeight` image in tiles,
+ * streaming them to a tiled TIFF.
+ * NOTE: SDL must not have been initialized yet.
+ */
+int run_tiled(Options const &options);
+
+
+#endif
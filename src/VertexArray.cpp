@@ -46,11 +46,13 @@ GLuint VertexArray::id() const
 
 void VertexArray::bind() const
 {
+    ++gl_call_count;
     glBindVertexArray(*_id);
 }
 
 void VertexArray::unbind() const
 {
+    ++gl_call_count;
     glBindVertexArray(0);
 }
 
@@ -58,6 +60,7 @@ void VertexArray::enableVertexAttribArray(
     GLuint index, GLint components, GLenum dataType, GLsizei stride,
     size_t offset, bool normalized) const
 {
+    gl_call_count += 2;
     glVertexAttribPointer(
         index, components, dataType, normalized? GL_TRUE : GL_FALSE, stride,
         (void *)offset);
@@ -0,0 +1,158 @@
+/**
+ * VideoStream.cpp - Raw Y4M video output.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "VideoStream.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#endif
+
+
+/** Open the output, treating "-" as stdout. */
+static std::FILE *open_stream(std::string const &path)
+{
+#ifndef _WIN32
+    // A consumer exiting early should be a write error, not a silent exit.
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    if (path == "-")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        return stdout;
+    }
+    std::FILE *const file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error{"failed to open '" + path + "'"};
+    }
+    return file;
+}
+
+
+VideoStream::VideoStream(
+    std::string const &path, unsigned width, unsigned height, unsigned fps,
+    size_t max_queued)
+:   _file{open_stream(path)}
+,   _close{path != "-"}
+,   _maxQueued{std::max<size_t>(max_queued, 1)}
+,   _frames{}
+,   _writing{false}
+,   _stop{false}
+,   _error{}
+,   _mutex{}
+,   _wake{}
+,   _done{}
+,   _thread{}
+{
+    // C420jpeg is the default 4:2:0 siting, with chroma centered between
+    // luma samples, which matches the 2x2 average done on the GPU.
+    std::fprintf(
+        _file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height,
+        fps);
+    _thread = std::thread{&VideoStream::_run, this};
+}
+
+VideoStream::~VideoStream()
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stop = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+    std::fflush(_file);
+    if (_close)
+    {
+        std::fclose(_file);
+    }
+}
+
+void VideoStream::_run()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    for (;;)
+    {
+        _wake.wait(lock, [this](){ return _stop || !_frames.empty(); });
+        if (_frames.empty())
+        {
+            return;
+        }
+        FrameReader::Frame frame = std::move(_frames.front());
+        _frames.pop_front();
+        _writing = true;
+        _done.notify_all();
+        lock.unlock();
+
+        bool const ok = (
+            std::fwrite("FRAME\n", 1, 6, _file) == 6
+            && (std::fwrite(frame.data.data(), 1, frame.data.size(), _file)
+                == frame.data.size()));
+
+        lock.lock();
+        _writing = false;
+        if (!ok && !_error)
+        {
+            _error = std::make_exception_ptr(std::runtime_error{
+                "failed to write video frame (did the reader exit?)"});
+            // Nothing more can be written.
+            _frames.clear();
+        }
+        _done.notify_all();
+    }
+}
+
+void VideoStream::_rethrow()
+{
+    if (_error)
+    {
+        std::exception_ptr const error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void VideoStream::write(FrameReader::Frame frame)
+{
+    if (frame.layout != PIXELS_YUV420)
+    {
+        throw std::runtime_error{"VideoStream::write - frame is not YUV420"};
+    }
+    std::unique_lock<std::mutex> lock{_mutex};
+    _done.wait(lock, [this](){
+        return _frames.size() < _maxQueued || _error;
+    });
+    _rethrow();
+    _frames.push_back(std::move(frame));
+    _wake.notify_one();
+}
+
+void VideoStream::finish()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    _done.wait(lock, [this](){ return _frames.empty() && !_writing; });
+    std::fflush(_file);
+    _rethrow();
+}
@@ -0,0 +1,85 @@
+/**
+ * VideoStream.hpp - Raw Y4M video output.
+ * Copyright (C) 2022 Trevor Last
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VIDEOSTREAM_HPP
+#define _VIDEOSTREAM_HPP
+
+#include "FrameReader.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+/**
+ * Streams YUV 4:2:0 frames as a Y4M (YUV4MPEG2) video to stdout, a file or
+ * a named pipe, for an external encoder to consume, eg.
+ *   compute --batch --stream - | ffmpeg -i - out.mp4
+ * Frames are written in order on a background thread. The queue is bounded,
+ * so a slow consumer slows rendering down instead of using up memory.
+ */
+class VideoStream
+{
+private:
+    std::FILE *const _file;
+    bool const _close;
+    size_t const _maxQueued;
+    std::deque<FrameReader::Frame> _frames;
+    bool _writing;
+    bool _stop;
+    std::exception_ptr _error;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::thread _thread;
+
+    void _run();
+    /** Rethrow an error from the writer thread. NOTE: Hold _mutex! */
+    void _rethrow();
+public:
+    /**
+     * path - Output path, or "-" for stdout.
+     * width, height - Frame size.
+     * fps - Frame rate written to the stream header.
+     * max_queued - Frames that can wait before write() blocks.
+     */
+    VideoStream(
+        std::string const &path, unsigned width, unsigned height,
+        unsigned fps, size_t max_queued=4);
+    /** Finishes writing queued frames. */
+    ~VideoStream();
+
+    VideoStream(VideoStream const &) = delete;
+    VideoStream &operator=(VideoStream const &) = delete;
+
+    /**
+     * Queue a frame, which must be in the PIXELS_YUV420 layout.
+     * Throws if an earlier write failed, eg. the reader went away.
+     */
+    void write(FrameReader::Frame frame);
+
+    /** Wait for every queued frame to be written. Throws on errors. */
+    void finish();
+};
+
+
+#endif
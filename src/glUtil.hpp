@@ -29,6 +29,14 @@
 #include <vector>
 
 
+/**
+ * Number of OpenGL calls made through these wrappers (plus a few counted
+ * call sites elsewhere, like dispatches and draws). Used to spot frames
+ * which do unexpected GL work.
+ */
+extern unsigned long gl_call_count;
+
+
 /* ===[ Deleters ]=== */
 /** Deleter for Shader objects. (For use with shared_ptr and co.) */
 void _shader_delete(GLuint *shader);
@@ -45,6 +53,12 @@ void _vertex_array_delete(GLuint *vertexarray);
 /** Deleter for Texture objects. (For use with shared_ptr and co.) */
 void _texture_delete(GLuint *texture);
 
+/** Deleter for Query objects. (For use with shared_ptr and co.) */
+void _query_delete(GLuint *query);
+
+/** Deleter for Fence objects. (For use with shared_ptr and co.) */
+void _fence_delete(GLsync *fence);
+
 
 
 /**
@@ -61,6 +75,15 @@ public:
     GLuint id() const;
 };
 
+/**
+ * Load a GLSL Shader from a file. Each of `defines` (eg. "NAME" or
+ * "NAME VALUE") is inserted as a #define after the #version line, so one
+ * source file can be compiled into several variants.
+ */
+Shader shader_from_file(
+    std::string path, GLenum type,
+    std::vector<std::string> const &defines={});
+
 /**
  * OpenGL program object.
  */
@@ -90,6 +113,12 @@ public:
     void setUniform(std::string uniform, glm::vec3 value) const;
     /** Set a vec4 uniform. */
     void setUniform(std::string uniform, glm::vec4 value) const;
+    /** Set an ivec2 uniform. */
+    void setUniform(std::string uniform, glm::ivec2 value) const;
+    /** Set a float array uniform. */
+    void setUniform(std::string uniform, std::vector<GLfloat> value) const;
+    /** Set an unsigned integer array uniform. */
+    void setUniform(std::string uniform, std::vector<GLuint> value) const;
     /**
      * Set a uniform, without throwing exceptions. Return an error message on
      * failure, otherwise an empty string.
@@ -135,6 +164,7 @@ public:
     template<typename T>
     void buffer(GLenum usage, std::vector<T> const &data)
     {
+        ++gl_call_count;
         glBufferData(target, data.size() * sizeof(T), data.data(), usage);
     }
     /** Update data in the buffer. NOTE: The Buffer must be bound first! */
@@ -143,6 +173,7 @@ public:
     {
         if (count == 0)
             count = data.size() - offset;
+        ++gl_call_count;
         glBufferSubData(
             target,
             offset * sizeof(T),
@@ -205,4 +236,49 @@ public:
     void setParameter(GLenum pname, GLint param);
 };
 
+/**
+ * OpenGL query object.
+ */
+class Query
+{
+private:
+    std::shared_ptr<GLuint> const _id;
+    GLenum const _target;
+public:
+    Query(GLenum target, std::string label="");
+
+    /** Get the query's id. */
+    GLuint id() const;
+
+    /** Begin the query. (Not for GL_TIMESTAMP queries) */
+    void begin() const;
+    /** End the query. (Not for GL_TIMESTAMP queries) */
+    void end() const;
+    /** Record the GPU time once all previous commands finish. */
+    void timestamp() const;
+
+    /** Check if the result is ready, without blocking. */
+    bool available() const;
+    /** Get the result, blocking until it is ready. */
+    GLuint64 result() const;
+};
+
+/**
+ * OpenGL fence sync object. Signaled once every command issued before it
+ * was created has finished.
+ */
+class Fence
+{
+private:
+    std::shared_ptr<GLsync> const _sync;
+public:
+    /** Insert a fence into the command stream. */
+    Fence();
+
+    /** Check if the fence has been signaled, without blocking. */
+    bool signaled() const;
+    /** Block until the fence is signaled. */
+    void wait() const;
+};
+
 #endif
@@ -18,234 +18,200 @@
 
 #include "glUtil.hpp"
 #include "ShaderStructs.hpp"
+#include "App.hpp"
+#include "Batch.hpp"
+#include "Benchmark.hpp"
+#include "DeltaStream.hpp"
 #include "ComputeRaytraceRenderer.hpp"
+#include "FlightRecorder.hpp"
+#include "FramePool.hpp"
+#include "JobBatch.hpp"
+#include "Metrics.hpp"
+#include "Options.hpp"
+#include "PerformanceHud.hpp"
+#include "PrimitivesBench.hpp"
+#include "ProbeBake.hpp"
+#include "Progressive.hpp"
+#include "RenderService.hpp"
+#include "SceneEditBench.hpp"
+#include "Scenes.hpp"
+#include "SortLast.hpp"
+#include "TileFarm.hpp"
+#include "TiledRender.hpp"
 
 #include <SDL.h>
 
-#include <functional>
-#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 
 
-/**
- * OpenGL initialization.
- * (Make sure to have an active OpenGL context before calling this!)
- */
-void init_OpenGL()
+/** printf into a std::string. */
+template<typename... Args>
+std::string format(char const *fmt, Args... args)
 {
-    // Init GLEW and check/print version.
-    GLenum error = glewInit();
-    if (error != GLEW_OK)
-    {
-        throw std::runtime_error{
-            "glewInit - " + std::string{(char *)glewGetErrorString(error)}};
-    }
-    if (glewIsSupported("GL_VERSION_4_3") == GL_FALSE)
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), fmt, args...);
+    return buf;
+}
+
+
+/** Print the steps logged by ComputeRaytraceRenderer::inspect(). */
+void print_trace(
+    GLuint x, GLuint y, std::vector<TraceEvent> const &events,
+    GLuint dropped, bool clock)
+{
+    static char const *const names[] = {
+        "ray", "sphere-test", "hit", "light", "result"};
+    std::cout << "=== Trace of pixel (" << x << ", " << y << "): "
+        << events.size() << " events";
+    if (dropped != 0)
     {
-        throw std::runtime_error{"GLEW: OpenGL Version 4.3 not supported"};
+        std::cout << " (" << dropped << " dropped)";
     }
-    std::cout << "GLEW Version " << glewGetString(GLEW_VERSION) << "\n";
-
-    // Print the received OpenGL version.
-    int major = 0,
-        minor = 0,
-        profile = 0;
-    SDL_GL_GetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, &major);
-    SDL_GL_GetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, &minor);
-    SDL_GL_GetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, &profile);
-    std::cout << "OpenGl Version " << major << "." << minor << " ";
-    switch (profile)
+    std::cout << ", cost in " << (clock? "GPU clocks" : "work units") << "\n";
+    for (auto const &e : events)
     {
-    case SDL_GL_CONTEXT_PROFILE_CORE:
-        std::cout << "core";
-        break;
-    case SDL_GL_CONTEXT_PROFILE_COMPATIBILITY:
-        std::cout << "compatibility";
-        break;
-    case SDL_GL_CONTEXT_PROFILE_ES:
-        std::cout << "ES";
-        break;
-    default:
-        std::cout << "Unrecognized Profile (" << profile << ")";
-        break;
+        char const *const name = (e.type >= 0 && e.type <= TRACE_RESULT)?
+            names[e.type] : "?";
+        std::cout << format(
+            "%10.0f  %-11s %5d  %10.4g %10.4g %10.4g %10.4g\n",
+            e.cost, name, e.object,
+            e.data[0], e.data[1], e.data[2], e.data[3]);
     }
-    std::cout << "\n";
 }
 
 
 /**
- * The application.
+ * Cameras for multi-view rendering: `count` copies of `center`, spaced
+ * `spacing` apart along its side vector, left to right.
  */
-class App
+std::vector<Camera> view_cameras(
+    Camera const &center, unsigned count, float spacing)
 {
-private:
-    std::unordered_map<
-        Uint32,
-        std::vector<std::function<void(SDL_Event)>>
-    > _event_callbacks;
-    SDL_Window *const _window;
-    SDL_GLContext const _context;
-public:
-    int window_width,
-        window_height;
-    bool running;
-
-    /** NOTE: SDL must be initialized before an App can be created! */
-    App(std::string title, int width, int height)
-    :   _event_callbacks{}
-    ,   _window{SDL_CreateWindow(
-            title.c_str(),
-            SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-            width, height,
-            SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE)}
-    ,   _context{SDL_GL_CreateContext(_window)}
-    ,   window_width{width}
-    ,   window_height{height}
-    ,   running{true}
+    glm::vec3 const side = glm::normalize(
+        glm::cross(center.up, center.forward));
+    std::vector<Camera> cameras(count, center);
+    for (unsigned i = 0; i < count; ++i)
     {
-        init_OpenGL();
+        cameras[i].position += side * (spacing * (i - (count - 1) / 2.0f));
     }
+    return cameras;
+}
+
 
-    ~App()
+/** Main program body. */
+int run(int argc, char *argv[])
+{
+    /* ===[ Initialization ]=== */
+    Options const options = parse_options(argc, argv);
+    if (options.help)
     {
-        SDL_GL_DeleteContext(_context);
-        SDL_DestroyWindow(_window);
+        std::cout << usage(argv[0]);
+        return EXIT_SUCCESS;
     }
-
-    /** Set up an event callback. */
-    void add_callback(
-        SDL_EventType event, std::function<void(SDL_Event)> callback)
+    if (options.benchmark)
     {
-        _event_callbacks.insert(
-            {event, std::vector<std::function<void(SDL_Event)>>{}});
-        _event_callbacks[event].push_back(callback);
+        return run_benchmark(options);
     }
-
-    /** Handle input events. */
-    void input()
+    if (options.benchPrimitives)
     {
-        SDL_Event event{};
-        while (SDL_PollEvent(&event))
-        {
-            // Built-in actions.
-            switch (event.type)
-            {
-            case SDL_QUIT:
-                running = false;
-                break;
-            case SDL_WINDOWEVENT:
-                if (event.window.event == SDL_WINDOWEVENT_RESIZED)
-                {
-                    // Viewport size and compute shader output texture depend
-                    // on window size, so if it changes they have to be updated.
-                    window_width = event.window.data1;
-                    window_height = event.window.data2;
-                    glViewport(0, 0, window_width, window_height);
-                }
-                break;
-            }
-
-            // Run user-added callbacks.
-            bool valid = true;
-            try
-            {
-                auto _ = _event_callbacks.at(event.type);
-            }
-            catch (std::out_of_range const &)
-            {
-                valid = false;
-            }
-            if (valid)
-            {
-                for (auto callback : _event_callbacks[event.type])
-                {
-                    callback(event);
-                }
-            }
-        }
+        return run_primitives_benchmark(options);
     }
-
-    /** Update the screen. */
-    void updateScreen() const
+    if (options.benchSceneEdits)
     {
-        SDL_GL_SwapWindow(_window);
+        return run_scene_edit_benchmark(options);
     }
-};
-
-
-/** SDL initialization. */
-void init_SDL()
-{
-    SDL_Init(SDL_INIT_VIDEO);
-    // Set OpenGL context version and profile (4.3 core).
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-    SDL_GL_SetAttribute(
-        SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    // Enable VSync. First try adaptive, if that's not available, use regular.
-    if (SDL_GL_SetSwapInterval(-1)  == -1)
+    if (!options.servePath.empty())
     {
-        SDL_GL_SetSwapInterval(1);
+        return run_service(options);
+    }
+    if (!options.clientPath.empty())
+    {
+        return run_service_client(options);
+    }
+    if (!options.farmWorkerSocket.empty())
+    {
+        return run_farm_worker(options);
+    }
+    if (!options.sortLastWorkerSocket.empty())
+    {
+        return run_sort_last_worker(options);
+    }
+    if (!options.framePoolWorkerSocket.empty())
+    {
+        return run_frame_pool_worker(options);
+    }
+    if (options.sortLastWorkers != 0)
+    {
+        return run_sort_last(options);
+    }
+    if (options.framePoolWorkers != 0)
+    {
+        return run_frame_pool(options);
+    }
+    if (options.batch)
+    {
+        return run_batch(options);
+    }
+    if (options.farmWorkers != 0)
+    {
+        return run_farm(options);
+    }
+    if (options.tiledWidth != 0)
+    {
+        return run_tiled(options);
+    }
+    if (options.progressiveSamples != 0)
+    {
+        return run_progressive(options);
+    }
+    if (!options.probesPath.empty())
+    {
+        return run_probe_bake(options);
+    }
+    if (!options.jobsPath.empty())
+    {
+        return run_job_batch(options);
     }
-}
-
-
-/** Main program body. */
-int run(int argc, char *argv[])
-{
-    /* ===[ Initialization ]=== */
     init_SDL();
-    App app{"compute", 640, 480};
+    App app{"compute", (int)options.width, (int)options.height};
     RenderResultDisplay result_display{};
+    PerformanceHud hud{};
 
     /* ===[ Scene Definition ]=== */
-    Scene const scene{
-        {   // materials
-            {
-                1.0f,
-                1.0f,
-                1.0f,
-                15.0f,
-                {1.0f, 1.0f, 1.0f}
-            },
-        },
-        {   // spheres
-            {
-                {-0.4f, 0.0f, -2.0f},
-                1.0f,
-                0,
-            },
-            {
-                {1.4f, 0.0f, -2.0f},
-                0.25f,
-                0,
-            },
-        },
-        {   // lights
-            {
-                {0.0f, 1.0f, 0.0f},
-                {0.9f, 1.0f, 0.9f},
-            },
-        },
-    };
+    SceneSetup const setup = builtin_scene(
+        options.scenes.empty()? "demo" : options.scenes.front());
 
     /* ===[ Create Renderer ]=== */
+    // With several views, the window is split into a grid of them, each
+    // rendered at the size of its cell.
+    GLuint const columns = (GLuint)std::ceil(std::sqrt((double)options.views));
+    GLuint const rows = (options.views + columns - 1) / columns;
     ComputeRaytraceRenderer renderer{
-        scene, (GLuint)app.window_width, (GLuint)app.window_height};
-    renderer.ambientColor = glm::vec3{0.0f, 0.05f, 0.1f};
-    renderer.blankColor = glm::vec3{0.2f, 0.0f, 0.2f};
-    renderer.eyePosition = glm::vec3{0.0f, 0.0f, 0.0f};
-    renderer.eyeForward = glm::vec3{0.0f, 0.0f, -1.0f};
-    renderer.eyeUp = glm::vec3{0.0f, 1.0f, 0.0f};
-    renderer.fov = glm::radians(90.0f);
+        setup.scene,
+        std::max<GLuint>(app.window_width / columns, 1),
+        std::max<GLuint>(app.window_height / rows, 1)};
+    configure_renderer(renderer, setup);
+    renderer.samplesPerPixel = options.samples;
+    renderer.temporalHints = options.temporalHints;
+    renderer.sceneStorage = options.sceneStorage;
+    if (renderer.sceneStorage != renderer.resolvedSceneStorage())
+    {
+        std::clog << "Scene storage: "
+            << describe_scene_storage(renderer.tuneSceneStorage()) << "\n";
+    }
     // Since we want the Renderer's output size to match the window's size, we
     // must resize it whenever the app's window size changes.
     app.add_callback(
         SDL_WINDOWEVENT,
-        [&renderer](SDL_Event event){
+        [&renderer, columns, rows](SDL_Event event){
             if (event.window.event == SDL_WINDOWEVENT_RESIZED)
             {
                 renderer.setRenderDimensions(
-                    event.window.data1, event.window.data2);
+                    std::max<GLuint>(event.window.data1 / columns, 1),
+                    std::max<GLuint>(event.window.data2 / rows, 1));
             }
         });
     // Keybind to toggle dithering with the spacebar.
@@ -258,17 +224,197 @@ int run(int argc, char *argv[])
             }
         }
     );
+    // Keybind to toggle the trace inspector with I. While it's on, clicking a
+    // pixel re-traces it with logging and prints what the ray did.
+    bool inspecting = false;
+    app.add_callback(
+        SDL_KEYDOWN,
+        [&inspecting](SDL_Event event){
+            if (event.key.keysym.sym == SDLK_i)
+            {
+                inspecting = !inspecting;
+                std::cout << "Trace inspector "
+                    << (inspecting? "on (click a pixel)" : "off") << "\n";
+            }
+        }
+    );
+    app.add_callback(
+        SDL_MOUSEBUTTONDOWN,
+        [&inspecting, &renderer, &options, columns](SDL_Event event){
+            if (inspecting && event.button.button == SDL_BUTTON_LEFT)
+            {
+                // SDL's origin is the top left, the render result's is the
+                // bottom left.
+                GLuint const cell_x = event.button.x / renderer.width();
+                GLuint const cell_y = event.button.y / renderer.height();
+                GLuint const view = cell_y * columns + cell_x;
+                if (view >= options.views)
+                {
+                    return;
+                }
+                GLuint const x = event.button.x % renderer.width();
+                GLuint const y = renderer.height() - 1
+                    - event.button.y % renderer.height();
+                // Trace with the clicked view's camera.
+                Camera const center = renderer.camera();
+                renderer.setCamera(view_cameras(
+                    center, options.views, options.viewSpacing)[view]);
+                GLuint dropped = 0;
+                auto const events = renderer.inspect(x, y, dropped);
+                renderer.setCamera(center);
+                print_trace(
+                    x, y, events, dropped, renderer.inspectorHasClock());
+            }
+        }
+    );
+    // Keybind to toggle the performance HUD with F1.
+    app.add_callback(
+        SDL_KEYDOWN,
+        [&hud](SDL_Event event){
+            if (event.key.keysym.sym == SDLK_F1)
+            {
+                hud.enabled = !hud.enabled;
+            }
+        }
+    );
+
+    /* ===[ Metrics ]=== */
+    auto &metrics = MetricsRegistry::global();
+    auto &frame_time = metrics.histogram(
+        "frame_time_us", "Wall-clock time between presented frames.");
+    auto &frames = metrics.counter("frames_total", "Frames presented.");
+    auto &resident = metrics.gauge(
+        "process_resident_bytes", "Resident memory of the process.");
+    auto &uploaded = metrics.counter("render_upload_bytes_total");
+    auto &gpu_memory = metrics.gauge("render_gpu_memory_bytes");
+    auto &hitches = metrics.counter(
+        "frame_hitches_total", "Frames over the hitch threshold.");
+    GPUTimer display_timer{"DisplayTimer"};
+    std::unique_ptr<MetricsExporter> exporter{};
+    if (!options.metricsFile.empty() || options.metricsPort != 0)
+    {
+        exporter.reset(new MetricsExporter{
+            metrics, options.metricsFile, options.metricsInterval,
+            options.metricsPort});
+    }
+
+    /* ===[ Remote Viewers ]=== */
+    std::unique_ptr<DeltaStreamer> delta{};
+    if (!options.deltaSocket.empty())
+    {
+        delta.reset(new DeltaStreamer{options.deltaSocket});
+    }
+
+    /* ===[ Flight Recorder ]=== */
+    FlightRecorder recorder{};
+    recorder.threshold = options.hitchThreshold;
+    recorder.window = options.hitchWindow;
+    recorder.directory = options.hitchDirectory;
+    app.recorder = &recorder;
 
     /* ===[ Main Loop ]=== */
+    auto last_frame = std::chrono::steady_clock::now();
+    // The hint hit rate stalls for rendering, so only check it now and then.
+    auto last_hint_check = last_frame;
+    double hint_hit_rate = 0.0;
     for (; app.running;)
     {
+        unsigned long const gl_calls = gl_call_count;
+
         // Handle user inputs.
-        app.input();
+        {
+            FlightRecorder::Zone zone{recorder, "input"};
+            app.input();
+        }
 
         // Render the scene.
-        renderer.render();
-        result_display.draw(renderer.getResult());
-        app.updateScreen();
+        {
+            FlightRecorder::Zone zone{recorder, "render"};
+            if (options.views > 1)
+            {
+                renderer.renderViews(view_cameras(
+                    renderer.camera(), options.views, options.viewSpacing));
+            }
+            else
+            {
+                renderer.render();
+            }
+        }
+        if (delta)
+        {
+            FlightRecorder::Zone zone{recorder, "delta"};
+            delta->submit(
+                renderer.getResult(), renderer.width(), renderer.height());
+            delta->pump();
+        }
+        {
+            FlightRecorder::Zone zone{recorder, "display"};
+            display_timer.begin();
+            if (options.views > 1)
+            {
+                result_display.drawViews(
+                    renderer.getViewResults(), columns, rows);
+            }
+            else
+            {
+                result_display.draw(renderer.getResult());
+            }
+            display_timer.end();
+            hud.draw(app.window_width, app.window_height);
+        }
+        {
+            FlightRecorder::Zone zone{recorder, "present"};
+            app.updateScreen();
+        }
+
+        // Update frame metrics.
+        auto const now = std::chrono::steady_clock::now();
+        auto const frame_us = std::chrono::duration_cast<
+            std::chrono::microseconds>(now - last_frame).count();
+        frame_time.record((uint64_t)frame_us);
+        last_frame = now;
+        hud.addFrame(frame_us / 1000.0);
+        double display_ms = 0.0;
+        display_timer.poll(display_ms);
+        if (options.temporalHints
+            && now - last_hint_check >= std::chrono::seconds{1})
+        {
+            hint_hit_rate = renderer.hintHitRate();
+            last_hint_check = now;
+        }
+        if (hud.enabled)
+        {
+            hud.setText({
+                format("FRAME %6.2f MS %6.1f FPS",
+                    frame_us / 1000.0, 1.0e6 / std::max<double>(frame_us, 1)),
+                format("P50 %6.2f  P99 %6.2f MS",
+                    frame_time.percentile(50.0) / 1000.0,
+                    frame_time.percentile(99.0) / 1000.0),
+                format("RAYTRACE %8.3f MS", renderer.dispatchTime()),
+                format("DISPLAY  %8.3f MS", display_ms),
+                format("HUD      %8.3f MS", hud.gpuTime()),
+                format("SIZE %dX%d", app.window_width, app.window_height),
+                format("UPLOADED %8.1f KB", uploaded.value() / 1024.0),
+                format("GPU MEM  %8.1f MB",
+                    gpu_memory.value() / (1024.0 * 1024.0)),
+                format("HINT HITS %5.1f %%", hint_hit_rate * 100.0),
+            });
+        }
+        frames.add();
+        resident.set((double)process_resident_bytes());
+
+        // GPU timings lag a few frames behind, since they're read without
+        // stalling.
+        recorder.gpuPass("raytrace", renderer.dispatchTime());
+        recorder.gpuPass("display", display_ms);
+        recorder.gpuPass("hud", hud.gpuTime());
+        recorder.counter("gl_calls", (int64_t)(gl_call_count - gl_calls));
+        std::string const dump = recorder.endFrame();
+        if (!dump.empty())
+        {
+            hitches.add();
+            std::cout << "Frame hitch, wrote " << dump << "\n";
+        }
     }
     return EXIT_SUCCESS;
 }